@@ -0,0 +1,123 @@
+// Benchmark consumer for the shared-memory frame bus published by
+// v4l2_sdl_video --publish. Reads frames in place from the ring and reports
+// the rate, the drops and the publish-to-read and capture-to-read latency
+// once a second. Run several at once to see the bus fan out.
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "frame_bus.h"
+#include "latency_stats.h"
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) { stopRequested = 1; }
+
+std::string fourccName(uint32_t fourcc) {
+    char name[5] = {static_cast<char>(fourcc & 0xff), static_cast<char>((fourcc >> 8) & 0xff),
+                    static_cast<char>((fourcc >> 16) & 0xff), static_cast<char>((fourcc >> 24) & 0xff), 0};
+    return name;
+}
+
+int main(int argc, char* argv[]) {
+    std::string busPath = "/tmp/v4l2-frame-bus";
+    double duration = 0.0;  // seconds; 0 = until SIGINT or the publisher stops
+    bool latest = false;    // jump to the newest frame instead of reading every one
+    bool touch = false;     // read every byte, as an analysis pass would
+    bool copy = false;      // copy each frame out first, to compare with reading in place
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--bus" && i + 1 < argc) {
+            busPath = argv[++i];
+        } else if (arg == "--duration" && i + 1 < argc) {
+            duration = std::atof(argv[++i]);
+        } else if (arg == "--latest") {
+            latest = true;
+        } else if (arg == "--touch") {
+            touch = true;
+        } else if (arg == "--copy") {
+            copy = true;
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+
+    framebus::Consumer bus(busPath);
+    const framebus::Format& format = bus.format();
+    printf("Consumer %u on %s: %s %ux%u, %u slots%s%s%s\n", bus.consumerIndex(), busPath.c_str(),
+           fourccName(format.fourcc).c_str(), format.width, format.height, bus.slots(), latest ? ", latest only" : "",
+           touch ? ", touching every byte" : "", copy ? ", copying out" : "");
+
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+
+    LatencyHistogram publishLatency;  // publisher's memcpy done -> frame read
+    LatencyHistogram captureLatency;  // V4L2 timestamp -> frame read
+    std::vector<uint8_t> scratch;
+    uint64_t checksum = 0;  // keeps --touch from being optimized away
+    uint64_t bytes = 0, reportedBytes = 0, reportedFrames = 0, torn = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto reportAt = start + std::chrono::seconds(1);
+    while (!stopRequested) {
+        framebus::BusFrame frame;
+        if (bus.next(frame, 100, latest)) {
+            int64_t readUs = framebus::nowUs();
+            const uint8_t* data = frame.data;
+            if (copy) {
+                scratch.resize(frame.bytes);
+                memcpy(scratch.data(), frame.data, frame.bytes);
+                data = scratch.data();
+            }
+            if (touch) {
+                uint64_t sum = 0;
+                for (size_t b = 0; b < frame.bytes; b++) sum += data[b];
+                checksum += sum;
+            }
+            // Reading in place races the publisher once the ring wraps
+            if (!copy && !bus.valid(frame)) {
+                bus.dropped(frame);
+                torn++;
+            } else {
+                publishLatency.add(readUs - frame.publishedUs);
+                captureLatency.add(readUs - frame.captureUs);
+                bytes += frame.bytes;
+            }
+        } else if (bus.closed()) {
+            printf("Publisher closed the bus\n");
+            break;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= reportAt) {
+            double seconds = std::chrono::duration<double>(now - reportAt).count() + 1.0;
+            printf("%.1f fps, %.1f MB/s, %llu dropped, %llu skipped, publish->read p50 %.2f ms p99 %.2f ms, "
+                   "capture->read p50 %.2f ms\n",
+                   (bus.stats.received - reportedFrames) / seconds, (bytes - reportedBytes) / seconds / 1e6,
+                   static_cast<unsigned long long>(bus.stats.dropped),
+                   static_cast<unsigned long long>(bus.stats.skipped), publishLatency.percentile(50) / 1e3,
+                   publishLatency.percentile(99) / 1e3, captureLatency.percentile(50) / 1e3);
+            reportedFrames = bus.stats.received;
+            reportedBytes = bytes;
+            reportAt = now + std::chrono::seconds(1);
+        }
+        if (duration > 0 && std::chrono::duration<double>(now - start).count() >= duration) break;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Consumer %u: %llu frames in %.1f s (%.1f fps, %.1f MB/s), %llu dropped (%llu torn), %llu skipped\n",
+           bus.consumerIndex(), static_cast<unsigned long long>(bus.stats.received), elapsed,
+           elapsed > 0 ? bus.stats.received / elapsed : 0.0, elapsed > 0 ? bytes / elapsed / 1e6 : 0.0,
+           static_cast<unsigned long long>(bus.stats.dropped), static_cast<unsigned long long>(torn),
+           static_cast<unsigned long long>(bus.stats.skipped));
+    printf("publish->read: p50 %.2f ms, p99 %.2f ms, max %.2f ms; capture->read: p50 %.2f ms, p99 %.2f ms\n",
+           publishLatency.percentile(50) / 1e3, publishLatency.percentile(99) / 1e3, publishLatency.max() / 1e3,
+           captureLatency.percentile(50) / 1e3, captureLatency.percentile(99) / 1e3);
+    if (touch) printf("checksum %llu\n", static_cast<unsigned long long>(checksum));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,351 @@
+#ifndef CAPTURE_LOOP_H
+#define CAPTURE_LOOP_H
+
+// Event-driven capture core for any number of sources.
+//
+// One thread waits in epoll_wait() on every source fd plus an eventfd. The
+// eventfd is signalled on release() and stop(), so returned buffers are
+// requeued and shutdown happens immediately instead of on the next poll
+// tick. Dequeued frames go to the render thread through a per-source SPSC
+// ring; the render thread hands them back with release().
+//
+// When a source's ring is full the DropPolicy decides what happens:
+//   DropNewest - the just-captured frame is requeued immediately and counted
+//                as dropped, so capture never waits on rendering.
+//   Block      - the frame is held back and the source is not read again
+//                until the render thread makes room. The driver then runs
+//                out of queued buffers and drops frames itself; those show
+//                up as sequence gaps. Other sources keep running.
+//
+// A source that delivers nothing for its timeout while it has buffers to
+// fill is reported as stalled (once per stall) and counted in its stats; it
+// recovers on the next frame. A consumer holding every buffer is not a stall.
+// A source whose dequeue fails hard (e.g. the camera was unplugged) is
+// dropped from the loop without affecting the others. A source that fails
+// with -ENODATA (a replayed file ran out) is dropped the same way but only
+// marked as ended.
+
+#include "capture_source.h"
+#include "spsc_ring.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+enum class DropPolicy {
+    DropNewest,
+    Block,
+};
+
+struct CaptureStats {
+    std::atomic<uint64_t> captured{0};       // frames dequeued from the source
+    std::atomic<uint64_t> rendered{0};       // frames the render thread consumed
+    std::atomic<uint64_t> dropped{0};        // frames dropped because the ring was full
+    std::atomic<uint64_t> skipped{0};        // frames passed over by acquireLatest() for a newer one
+    std::atomic<uint64_t> driverDropped{0};  // gaps in the source sequence numbers
+    std::atomic<uint64_t> timeouts{0};       // timeout periods without a frame
+    std::atomic<uint64_t> errors{0};         // failed dequeue/requeue calls
+    std::atomic<double> fps{0.0};            // capture rate over the last second
+    std::atomic<bool> ended{false};          // the source reached the end of its stream
+
+    void print(const char* label) const {
+        printf("%s: captured %llu, rendered %llu, dropped %llu, skipped %llu, driver dropped %llu, timeouts %llu, "
+               "errors %llu, %.1f fps\n",
+               label, static_cast<unsigned long long>(captured.load()),
+               static_cast<unsigned long long>(rendered.load()), static_cast<unsigned long long>(dropped.load()),
+               static_cast<unsigned long long>(skipped.load()),
+               static_cast<unsigned long long>(driverDropped.load()),
+               static_cast<unsigned long long>(timeouts.load()), static_cast<unsigned long long>(errors.load()),
+               fps.load());
+    }
+};
+
+class CaptureLoop {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    CaptureLoop() {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0) throw std::runtime_error("Failed to create capture loop");
+        struct epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = WAKE_TOKEN;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    }
+
+    ~CaptureLoop() {
+        stop();
+        close(wakeFd);
+        close(epollFd);
+    }
+
+    CaptureLoop(const CaptureLoop&) = delete;
+    CaptureLoop& operator=(const CaptureLoop&) = delete;
+
+    // Adds a source before start(); returns its index. By default the ring
+    // holds at most bufferCount - 1 frames so the source always keeps at
+    // least one buffer to fill; consumers that hold buffers after acquire()
+    // (e.g. while the GPU reads them) pass a smaller ring. timeoutMs <= 0
+    // disables stall detection.
+    size_t addSource(std::unique_ptr<CaptureSource> source, DropPolicy policy, size_t ringCapacity = 0,
+                     int timeoutMs = 1000) {
+        if (worker.joinable()) throw std::runtime_error("Capture sources must be added before start()");
+        uint32_t bufferCount = source->bufferCount();
+        if (ringCapacity == 0) ringCapacity = bufferCount > 1 ? bufferCount - 1 : 1;
+        sources.emplace_back(new Source(std::move(source), policy, ringCapacity, timeoutMs));
+        return sources.size() - 1;
+    }
+
+    void start() {
+        if (worker.joinable()) return;
+        running = true;
+        Clock::time_point now = Clock::now();
+        for (size_t i = 0; i < sources.size(); i++) {
+            Source& s = *sources[i];
+            s.queued = s.source->bufferCount();
+            s.deadline = now + std::chrono::milliseconds(s.timeoutMs);
+            s.rateStart = now;
+            updateInterest(i);
+        }
+        worker = std::thread(&CaptureLoop::run, this);
+    }
+
+    void stop() {
+        running = false;
+        wake();
+        if (worker.joinable()) worker.join();
+    }
+
+    size_t sourceCount() const { return sources.size(); }
+    const char* sourceName(size_t source) const { return sources[source]->source->name(); }
+    CaptureStats& stats(size_t source) { return sources[source]->stats; }
+
+    // Render thread: next captured frame from `source`, if any
+    bool acquire(size_t source, CapturedFrame& frame) { return sources[source]->frames.pop(frame); }
+
+    // Render thread: newest captured frame from `source`, handing every older
+    // pending frame straight back to be requeued (counted as skipped). This
+    // is the latest-frame-wins mode: the screen never shows a frame that
+    // has already been superseded, at the cost of uneven motion when the
+    // renderer falls behind.
+    bool acquireLatest(size_t source, CapturedFrame& frame) {
+        Source& s = *sources[source];
+        if (!s.frames.pop(frame)) return false;
+        CapturedFrame newer;
+        bool skipped = false;
+        while (s.frames.pop(newer)) {
+            s.stats.skipped++;
+            s.released.push(frame.index);
+            frame = newer;
+            skipped = true;
+        }
+        if (skipped) wake();
+        return true;
+    }
+
+    // Render thread: done with the buffer, give it back to the source
+    void release(size_t source, const CapturedFrame& frame) {
+        Source& s = *sources[source];
+        s.stats.rendered++;
+        s.released.push(frame.index);
+        wake();
+    }
+
+    size_t pending(size_t source) const { return sources[source]->frames.size(); }
+
+private:
+    static constexpr uint64_t WAKE_TOKEN = ~uint64_t(0);
+
+    struct Source {
+        Source(std::unique_ptr<CaptureSource> source, DropPolicy policy, size_t ringCapacity, int timeoutMs)
+            : source(std::move(source)), policy(policy), timeoutMs(timeoutMs), frames(ringCapacity),
+              released(this->source->bufferCount()) {}
+
+        std::unique_ptr<CaptureSource> source;
+        DropPolicy policy;
+        int timeoutMs;
+        SpscRing<CapturedFrame> frames;  // capture -> render
+        SpscRing<uint32_t> released;     // render -> capture
+        CaptureStats stats;
+
+        // Owned by the loop thread
+        uint32_t queued = 0;         // buffers currently with the source
+        bool watching = false;       // fd registered with epoll
+        bool failed = false;         // removed after a hard error
+        bool holding = false;        // Block policy: frame waiting for ring space
+        CapturedFrame held;
+        bool haveSequence = false;
+        uint32_t lastSequence = 0;
+        bool stalled = false;
+        Clock::time_point deadline;
+        Clock::time_point rateStart;
+        uint64_t rateFrames = 0;
+    };
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t ret = write(wakeFd, &one, sizeof(one));
+        (void)ret;
+    }
+
+    // Watch a source only while it has buffers to fill and nothing held back.
+    // V4L2 reports POLLERR when no buffer is queued, so an idle fd must not
+    // stay registered or the loop would spin.
+    void updateInterest(size_t index) {
+        Source& s = *sources[index];
+        bool want = !s.failed && !s.holding && s.queued > 0;
+        if (want == s.watching) return;
+        if (want) {
+            struct epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u64 = index;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, s.source->pollFd(), &ev);
+        } else {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, s.source->pollFd(), nullptr);
+        }
+        s.watching = want;
+    }
+
+    void fail(size_t index, int err) {
+        Source& s = *sources[index];
+        if (err == -ENODATA) {
+            std::cerr << s.source->name() << ": end of stream" << std::endl;
+            s.stats.ended = true;
+        } else {
+            s.stats.errors++;
+            // Transient: counted, but the source stays in the loop and is
+            // dequeued again on its next event
+            if (err == -EAGAIN || err == -EINTR) return;
+            std::cerr << s.source->name() << ": capture failed: " << strerror(-err) << std::endl;
+        }
+        s.failed = true;
+        updateInterest(index);
+    }
+
+    void requeueReleased(size_t index) {
+        Source& s = *sources[index];
+        const bool idle = s.queued == 0;
+        uint32_t bufferIndex;
+        while (s.released.pop(bufferIndex)) {
+            if (s.source->requeue(bufferIndex)) s.queued++;
+            else s.stats.errors++;
+        }
+        // The source had nothing to fill until now; its timeout starts here
+        if (idle && s.queued > 0) s.deadline = Clock::now() + std::chrono::milliseconds(s.timeoutMs);
+        if (s.holding && s.frames.push(s.held)) s.holding = false;
+        updateInterest(index);
+    }
+
+    void dequeueFrames(size_t index, Clock::time_point now) {
+        Source& s = *sources[index];
+        while (!s.failed && !s.holding && s.queued > 0) {
+            CapturedFrame frame;
+            int ret = s.source->dequeue(frame);
+            if (ret == 0) break;
+            if (ret < 0) {
+                fail(index, ret);
+                break;
+            }
+            s.queued--;
+            s.stats.captured++;
+            s.rateFrames++;
+            if (s.haveSequence && frame.sequence > s.lastSequence + 1) {
+                s.stats.driverDropped += frame.sequence - s.lastSequence - 1;
+            }
+            s.haveSequence = true;
+            s.lastSequence = frame.sequence;
+            s.deadline = now + std::chrono::milliseconds(s.timeoutMs);
+            if (s.stalled) {
+                std::cerr << s.source->name() << ": capture resumed" << std::endl;
+                s.stalled = false;
+            }
+
+            if (s.frames.push(frame)) continue;
+            if (s.policy == DropPolicy::Block) {
+                s.held = frame;
+                s.holding = true;
+            } else {
+                s.stats.dropped++;
+                if (s.source->requeue(frame.index)) s.queued++;
+                else s.stats.errors++;
+            }
+        }
+        updateInterest(index);
+    }
+
+    // Stall detection and frame rate; returns the epoll timeout in ms
+    int checkTimers(Clock::time_point now) {
+        int waitMs = 1000;  // refresh the fps figures at least once a second
+        for (auto& sp : sources) {
+            Source& s = *sp;
+            double rateSeconds = std::chrono::duration<double>(now - s.rateStart).count();
+            if (rateSeconds >= 1.0) {
+                s.stats.fps = s.rateFrames / rateSeconds;
+                s.rateFrames = 0;
+                s.rateStart = now;
+            }
+            if (s.timeoutMs <= 0 || s.failed) continue;
+            if (s.holding || s.queued == 0) {
+                // Waiting on the consumer, not the source
+                s.deadline = now + std::chrono::milliseconds(s.timeoutMs);
+            } else if (now >= s.deadline) {
+                s.stats.timeouts++;
+                if (!s.stalled) {
+                    std::cerr << s.source->name() << ": no frame for " << s.timeoutMs << " ms" << std::endl;
+                    s.stalled = true;
+                }
+                s.deadline = now + std::chrono::milliseconds(s.timeoutMs);
+            }
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(s.deadline - now).count() + 1;
+            waitMs = std::min<int>(waitMs, static_cast<int>(remaining));
+        }
+        return std::max(waitMs, 0);
+    }
+
+    void run() {
+        std::vector<struct epoll_event> events(sources.size() + 1);
+        while (running) {
+            int timeoutMs = checkTimers(Clock::now());
+            int n = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), timeoutMs);
+            if (n < 0 && errno != EINTR) {
+                std::cerr << "epoll_wait failed: " << strerror(errno) << std::endl;
+                break;
+            }
+
+            Clock::time_point now = Clock::now();
+            for (int i = 0; i < n; i++) {
+                if (events[i].data.u64 == WAKE_TOKEN) {
+                    uint64_t count;
+                    ssize_t ret = read(wakeFd, &count, sizeof(count));
+                    (void)ret;
+                    continue;
+                }
+                dequeueFrames(static_cast<size_t>(events[i].data.u64), now);
+            }
+            // Released buffers may arrive without a wakeup of their own
+            // (acquireLatest batches them), so always drain every source
+            for (size_t i = 0; i < sources.size(); i++) requeueReleased(i);
+        }
+    }
+
+    std::vector<std::unique_ptr<Source>> sources;
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> running{false};
+    std::thread worker;
+};
+
+#endif // CAPTURE_LOOP_H
@@ -0,0 +1,99 @@
+#ifndef CAPTURE_SOURCE_H
+#define CAPTURE_SOURCE_H
+
+// A frame producer the capture loop can wait on.
+//
+// A source exposes a pollable fd that becomes readable when a frame is ready,
+// a non-blocking dequeue() and a requeue() that hands a buffer back once the
+// consumer is done with it. V4l2Source wraps a streaming V4L2 device; other
+// sources (test fakes, file replay) only need an fd epoll can watch.
+
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <fcntl.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CapturedFrame {
+    uint32_t index = 0;       // buffer index within the source
+    uint32_t bytesused = 0;   // summed over the planes of a multi-planar buffer
+    uint32_t sequence = 0;    // source frame counter
+    struct timeval timestamp{};
+};
+
+class CaptureSource {
+public:
+    virtual ~CaptureSource() {}
+
+    virtual const char* name() const = 0;
+    virtual int pollFd() const = 0;
+    virtual uint32_t bufferCount() const = 0;
+
+    // 1 if a frame was dequeued, 0 if none is ready, -errno on failure
+    virtual int dequeue(CapturedFrame& frame) = 0;
+
+    // Gives buffer `index` back to the producer; false on failure
+    virtual bool requeue(uint32_t index) = 0;
+};
+
+// Streaming V4L2 capture device. All `bufferCount` buffers must already be
+// queued and the stream started. The fd stays owned by the caller but is
+// switched to non-blocking mode so a spurious wakeup can never stall DQBUF.
+// `bufferType` is V4L2_BUF_TYPE_VIDEO_CAPTURE or _CAPTURE_MPLANE.
+class V4l2Source : public CaptureSource {
+public:
+    V4l2Source(int fd, uint32_t memoryType, uint32_t bufferCount, const std::string& name = "v4l2",
+               uint32_t bufferType = V4L2_BUF_TYPE_VIDEO_CAPTURE)
+        : fd(fd), memoryType(memoryType), bufferType(bufferType), label(name), dequeued(bufferCount) {
+        if (bufferType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) planes.resize(bufferCount);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    const char* name() const override { return label.c_str(); }
+    int pollFd() const override { return fd; }
+    uint32_t bufferCount() const override { return static_cast<uint32_t>(dequeued.size()); }
+
+    int dequeue(CapturedFrame& frame) override {
+        struct v4l2_buffer buf{};
+        struct v4l2_plane bufPlanes[VIDEO_MAX_PLANES]{};
+        buf.type = bufferType;
+        buf.memory = memoryType;
+        if (!planes.empty()) {
+            buf.m.planes = bufPlanes;
+            buf.length = VIDEO_MAX_PLANES;
+        }
+        if (ioctl(fd, VIDIOC_DQBUF, &buf) < 0) return errno == EAGAIN ? 0 : -errno;
+        // Keep the dequeued state (userptr, length) for the requeue
+        dequeued[buf.index] = buf;
+        frame.index = buf.index;
+        frame.bytesused = buf.bytesused;
+        if (!planes.empty()) {
+            // The plane array has to outlive this call for the requeue
+            std::copy(bufPlanes, bufPlanes + buf.length, planes[buf.index].begin());
+            dequeued[buf.index].m.planes = planes[buf.index].data();
+            frame.bytesused = 0;
+            for (uint32_t p = 0; p < buf.length; p++) frame.bytesused += bufPlanes[p].bytesused;
+        }
+        frame.sequence = buf.sequence;
+        frame.timestamp = buf.timestamp;
+        return 1;
+    }
+
+    bool requeue(uint32_t index) override { return ioctl(fd, VIDIOC_QBUF, &dequeued[index]) == 0; }
+
+private:
+    int fd;
+    uint32_t memoryType;
+    uint32_t bufferType;
+    std::string label;
+    std::vector<struct v4l2_buffer> dequeued;  // last dequeued state per index
+    std::vector<std::array<struct v4l2_plane, VIDEO_MAX_PLANES>> planes;  // multi-planar only
+};
+
+#endif // CAPTURE_SOURCE_H
@@ -0,0 +1,56 @@
+#ifndef CAPTURE_THREAD_H
+#define CAPTURE_THREAD_H
+
+// Dedicated capture thread for a single device.
+//
+// Thin wrapper over CaptureLoop for viewers that only ever capture from one
+// device: the loop thread owns VIDIOC_DQBUF/VIDIOC_QBUF, dequeued buffers
+// reach the render thread through an SPSC ring and come back via release().
+// See capture_loop.h for the drop policies and stall handling.
+
+#include "capture_loop.h"
+
+class CaptureThread {
+public:
+    // `bufferCount` buffers must already be queued and the stream started.
+    // By default the ring holds at most bufferCount - 1 frames so the driver
+    // always keeps at least one buffer to fill; consumers that hold buffers
+    // after acquire() (e.g. while the GPU reads them) pass a smaller ring.
+    CaptureThread(int fd, uint32_t memoryType, uint32_t bufferCount, DropPolicy policy, size_t ringCapacity = 0,
+                  int timeoutMs = 1000)
+        : CaptureThread(std::unique_ptr<CaptureSource>(new V4l2Source(fd, memoryType, bufferCount)), policy,
+                        ringCapacity, timeoutMs) {}
+
+    // Captures from any source, e.g. a ReplaySource
+    CaptureThread(std::unique_ptr<CaptureSource> captureSource, DropPolicy policy, size_t ringCapacity = 0,
+                  int timeoutMs = 1000)
+        : source(loop.addSource(std::move(captureSource), policy, ringCapacity, timeoutMs)),
+          stats(loop.stats(source)) {
+        loop.start();
+    }
+
+    CaptureThread(const CaptureThread&) = delete;
+    CaptureThread& operator=(const CaptureThread&) = delete;
+
+    void stop() { loop.stop(); }
+
+    // Render thread: next captured frame, if any
+    bool acquire(CapturedFrame& frame) { return loop.acquire(source, frame); }
+
+    // Render thread: newest captured frame, requeueing older pending ones
+    bool acquireLatest(CapturedFrame& frame) { return loop.acquireLatest(source, frame); }
+
+    // Render thread: done with the buffer, give it back to the driver
+    void release(const CapturedFrame& frame) { loop.release(source, frame); }
+
+    size_t pending() const { return loop.pending(source); }
+
+private:
+    CaptureLoop loop;
+    size_t source;
+
+public:
+    CaptureStats& stats;
+};
+
+#endif // CAPTURE_THREAD_H
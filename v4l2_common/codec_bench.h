@@ -0,0 +1,125 @@
+#ifndef CODEC_BENCH_H
+#define CODEC_BENCH_H
+
+// Benchmark for lossless_codec.h. Frames come from a raw YUYV recording
+// (e.g. capture.yuv) when one is given, otherwise from a synthetic moving
+// scene with sensor-like noise. Every frame is round-tripped and compared
+// before timing. Reports the compression ratio, single-core encode/decode
+// speed as a multiple of real time at 30 fps, and pool throughput.
+
+#include "lossless_codec.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <random>
+#include <vector>
+
+namespace lossless {
+
+inline std::vector<std::vector<uint8_t>> loadBenchFrames(const char* rawPath, const FrameLayout& layout,
+                                                         size_t maxFrames) {
+    std::vector<std::vector<uint8_t>> frames;
+    size_t frameBytes = static_cast<size_t>(layout.bytesperline) * layout.height;
+    if (rawPath) {
+        FILE* f = fopen(rawPath, "rb");
+        if (f) {
+            std::vector<uint8_t> frame(frameBytes);
+            while (frames.size() < maxFrames && fread(frame.data(), 1, frameBytes, f) == frameBytes) {
+                frames.push_back(frame);
+            }
+            fclose(f);
+        }
+        if (frames.empty()) printf("No frames in %s, using a synthetic scene\n", rawPath);
+    }
+    if (!frames.empty()) return frames;
+
+    // Gradient background, a moving box and +-4 noise on every sample
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> noise(-4, 4);
+    for (size_t i = 0; i < maxFrames; i++) {
+        std::vector<uint8_t> frame(frameBytes);
+        uint32_t boxX = static_cast<uint32_t>(i * 8) % layout.width;
+        for (uint32_t y = 0; y < layout.height; y++) {
+            uint8_t* row = &frame[static_cast<size_t>(y) * layout.bytesperline];
+            for (uint32_t x = 0; x < layout.width; x += 2) {
+                bool inBox = x >= boxX && x < boxX + 96 && y >= 160 && y < 280;
+                int luma = inBox ? 200 : 40 + (x + y) / 8;
+                int u = inBox ? 90 : 128 + static_cast<int>(x / 20);
+                int v = inBox ? 160 : 128 - static_cast<int>(y / 16);
+                row[x * 2 + 0] = static_cast<uint8_t>(std::clamp(luma + noise(rng), 16, 235));
+                row[x * 2 + 1] = static_cast<uint8_t>(std::clamp(u + noise(rng) / 2, 16, 240));
+                row[x * 2 + 2] = static_cast<uint8_t>(std::clamp(luma + noise(rng), 16, 235));
+                row[x * 2 + 3] = static_cast<uint8_t>(std::clamp(v + noise(rng) / 2, 16, 240));
+            }
+        }
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+inline bool runCodecBenchmark(const char* rawPath, uint32_t width, uint32_t height) {
+    FrameLayout layout;
+    layout.fourcc = V4L2_PIX_FMT_YUYV;
+    layout.width = width;
+    layout.height = height;
+    layout.bytesperline = width * 2;
+    const size_t frameBytes = static_cast<size_t>(layout.bytesperline) * height;
+    std::vector<std::vector<uint8_t>> frames = loadBenchFrames(rawPath, layout, 120);
+    ThreadPool pool;
+    printf("Lossless codec: %zu frames of %ux%u YUYV, %zu pool threads\n", frames.size(), width, height, pool.size());
+
+    // Round trip every frame first
+    std::vector<std::vector<uint8_t>> encoded(frames.size());
+    std::vector<uint8_t> decoded(frameBytes);
+    size_t totalEncoded = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        encodeFrame(layout, frames[i].data(), encoded[i]);
+        totalEncoded += encoded[i].size();
+        if (!decodeFrame(layout, encoded[i].data(), encoded[i].size(), decoded.data()) ||
+            memcmp(decoded.data(), frames[i].data(), frameBytes) != 0) {
+            printf("Frame %zu does not round-trip\n", i);
+            return false;
+        }
+    }
+    double rawMB = static_cast<double>(frameBytes) * frames.size() / 1e6;
+    printf("ratio %.2fx (%.1f MB -> %.1f MB)\n", rawMB * 1e6 / totalEncoded, rawMB, totalEncoded / 1e6);
+
+    auto timeIt = [](auto fn) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto report = [&](const char* what, double seconds) {
+        double fps = frames.size() / seconds;
+        printf("%-22s %8.1f MB/s  %7.1f fps  %5.1fx real time @30fps\n", what, rawMB / seconds, fps, fps / 30.0);
+    };
+
+    std::vector<uint8_t> scratch;
+    report("encode, 1 core", timeIt([&]() {
+        for (const auto& frame : frames) encodeFrame(layout, frame.data(), scratch);
+    }));
+    report("decode, 1 core", timeIt([&]() {
+        for (const auto& payload : encoded) decodeFrame(layout, payload.data(), payload.size(), decoded.data());
+    }));
+    report("encode, pool (frames)", timeIt([&]() {
+        std::vector<std::future<void>> pending;
+        for (const auto& frame : frames) {
+            pending.push_back(pool.submit([&layout, &frame]() {
+                std::vector<uint8_t> out;
+                encodeFrame(layout, frame.data(), out);
+            }));
+        }
+        for (auto& f : pending) f.get();
+    }));
+    report("decode, pool (stripes)", timeIt([&]() {
+        for (const auto& payload : encoded) decodeFrame(layout, payload.data(), payload.size(), decoded.data(), &pool);
+    }));
+    return true;
+}
+
+} // namespace lossless
+
+#endif // CODEC_BENCH_H
@@ -0,0 +1,66 @@
+#ifndef CONVERT_BENCH_H
+#define CONVERT_BENCH_H
+
+// Microbenchmark for the pixel conversion kernels in pixel_convert.h.
+// Every kernel is first checked against the scalar reference, then timed
+// over a synthetic frame; throughput is reported as GB/s of source data.
+
+#include "pixel_convert.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace pixconv {
+
+inline bool benchKernel(const char* kernelName, const char* converterName, RowFn fn, RowFn reference,
+                        const std::vector<uint8_t>& src, size_t srcBpp, size_t width, size_t height,
+                        int iterations) {
+    size_t srcStride = width * srcBpp;
+    size_t dstStride = width * 4;
+    std::vector<uint8_t> expected(dstStride * height);
+    std::vector<uint8_t> actual(dstStride * height);
+
+    convertFrame(reference, src.data(), srcStride, expected.data(), dstStride, width, height);
+    convertFrame(fn, src.data(), srcStride, actual.data(), dstStride, width, height);
+    if (memcmp(expected.data(), actual.data(), expected.size()) != 0) {
+        printf("%-8s %-14s MISMATCH against scalar reference\n", converterName, kernelName);
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        convertFrame(fn, src.data(), srcStride, actual.data(), dstStride, width, height);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double gbps = static_cast<double>(srcStride * height) * iterations / seconds / 1e9;
+    printf("%-8s %-14s %7.2f GB/s  %7.3f ms/frame\n", converterName, kernelName, gbps,
+           seconds * 1000.0 / iterations);
+    return true;
+}
+
+// Returns false if any SIMD kernel disagrees with the scalar reference
+inline bool runConvertBenchmark(size_t width, size_t height, int iterations) {
+    std::vector<uint8_t> src(width * height * 3 + 64);
+    std::mt19937 rng(1234);
+    for (auto& b : src) b = static_cast<uint8_t>(rng());
+
+    printf("Converting %zux%zu, %d iterations\n", width, height, iterations);
+    // The scalar reference is the first entry
+    const std::vector<PixelConverter> converters = availablePixelConverters();
+    const PixelConverter& ref = converters.front();
+    bool ok = true;
+    for (const auto& conv : converters) {
+        ok &= benchKernel("rgb24->rgba", conv.name, conv.rgb24ToRgba, ref.rgb24ToRgba, src, 3, width, height, iterations);
+        ok &= benchKernel("bgr24->bgra", conv.name, conv.bgr24ToBgra, ref.bgr24ToBgra, src, 3, width, height, iterations);
+        ok &= benchKernel("yuyv->rgba", conv.name, conv.yuyvToRgba, ref.yuyvToRgba, src, 2, width & ~size_t(1), height, iterations);
+    }
+    printf("Selected converter: %s\n", bestPixelConverter().name);
+    return ok;
+}
+
+} // namespace pixconv
+
+#endif // CONVERT_BENCH_H
@@ -0,0 +1,305 @@
+#ifndef EVENT_RECORDER_H
+#define EVENT_RECORDER_H
+
+// Event recording: the last `preSeconds` of frames are kept in memory, and
+// trigger() writes them, plus every frame of the next `postSeconds`, to a
+// clip file of their own: capture-event-0000.yuv, capture-event-0001.yuv, ...
+//
+// The history lives in one slab allocated (and touched) up front, used as a
+// byte ring with a fixed table of frame entries, so holding a frame never
+// allocates. Frames age out by capture time, or earlier when the slab is
+// full. Frames that still have to be written to a clip are never evicted:
+// if the disk falls so far behind that they fill the slab, new frames are
+// dropped and counted instead. Memory use is the slab plus the table.
+//
+// A writer thread copies clip frames from the slab into a FrameWriter, so
+// neither write() nor trigger() touches the disk. A trigger during an event
+// extends it, and frames already written are never written twice.
+
+#include "frame_writer.h"
+
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct EventStats {
+    std::atomic<uint64_t> framesHeld{0};      // frames taken into the history
+    std::atomic<uint64_t> framesDropped{0};   // no room left beside frames still waiting for the disk
+    std::atomic<uint64_t> framesWritten{0};   // queued into a clip
+    std::atomic<uint64_t> triggers{0};
+    std::atomic<uint64_t> clips{0};           // clips finished
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> writeErrors{0};
+};
+
+class EventRecorder {
+public:
+    // Room in the entry table for frames down to this size (MJPEG), or for
+    // the 64 frames a tiny slab might hold
+    static constexpr size_t MIN_FRAME_BYTES = 16384;
+
+    EventRecorder(const std::string& stem, const std::string& extension, size_t slabBytes, double preSeconds,
+                  double postSeconds)
+        : stem(stem), extension(extension), slabBytes(slabBytes),
+          preUs(static_cast<int64_t>(preSeconds * 1e6)), postUs(static_cast<int64_t>(postSeconds * 1e6)),
+          slab(new uint8_t[slabBytes]), entries(std::max<size_t>(64, slabBytes / MIN_FRAME_BYTES)) {
+        // Fault every page in now rather than on the capture path
+        memset(slab.get(), 0, slabBytes);
+        flusher = std::thread(&EventRecorder::run, this);
+    }
+
+    ~EventRecorder() { close(); }
+
+    EventRecorder(const EventRecorder&) = delete;
+    EventRecorder& operator=(const EventRecorder&) = delete;
+
+    // Memory held for the whole run
+    size_t capacity() const { return slabBytes + entries.size() * sizeof(Entry); }
+
+    bool recording() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return clipOpen;
+    }
+
+    // Capture thread: adds a frame to the history (and to the clip during an
+    // event). False if it had to be dropped.
+    bool write(const void* data, size_t bytes, const struct timeval& timestamp) {
+        const int64_t us = static_cast<int64_t>(timestamp.tv_sec) * 1000000 + timestamp.tv_usec;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed || bytes == 0) return false;
+        if (eventActive) {
+            if (endPending) {
+                eventEndUs = us + postUs;
+                endPending = false;
+            } else if (us > eventEndUs) {
+                // The post-trigger window is over; this frame is not part of the clip
+                eventActive = false;
+                clipEnd = nextFrame;
+            }
+        }
+
+        // Frames still to be written stay put
+        const uint64_t pinnedFrom = clipOpen ? flushNext : nextFrame;
+        while (count > 0 && firstFrame < pinnedFrom && entry(firstFrame).us < us - preUs) evictOldest();
+        size_t offset;
+        while (count == entries.size() || !reserve(bytes, offset)) {
+            if (count == 0 || firstFrame >= pinnedFrom) {
+                stats.framesDropped++;
+                return false;
+            }
+            evictOldest();
+        }
+
+        // Copied under the lock; the writer thread holds it only to pick up
+        // or retire a frame, never while writing one
+        memcpy(slab.get() + offset, data, bytes);
+        Entry& e = entry(nextFrame);
+        e.offset = offset;
+        e.bytes = bytes;
+        e.us = us;
+        writePos = offset + bytes;
+        heldBytes += bytes;
+        nextFrame++;
+        count++;
+        stats.framesHeld++;
+        if (clipOpen) wake.notify_one();
+        return true;
+    }
+
+    // Any thread: starts writing the history and the next postSeconds to a
+    // new clip, or extends the current event
+    void trigger() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed) return;
+        stats.triggers++;
+        if (!clipOpen) {
+            clipOpen = true;
+            flushNext = std::max(firstFrame, flushedUpTo);
+            clipCount++;
+        }
+        eventActive = true;
+        clipEnd = UINT64_MAX;
+        endPending = count == 0;
+        eventEndUs = count == 0 ? 0 : entry(nextFrame - 1).us + postUs;
+        wake.notify_one();
+    }
+
+    // Ends an event early, finishes writing its clip and stops the writer thread
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed) return;
+            closed = true;
+            if (eventActive) {
+                eventActive = false;
+                clipEnd = nextFrame;
+            }
+            wake.notify_one();
+        }
+        if (flusher.joinable()) flusher.join();
+    }
+
+    void print(const char* label) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        const double heldSeconds = count ? (entry(nextFrame - 1).us - entry(firstFrame).us) / 1e6 : 0.0;
+        printf("%s: %.1f MB history (%.1f MB, %.1f s in use), %llu triggers, %llu clips, %llu frames written "
+               "(%.1f MB), %llu dropped, errors %llu\n",
+               label, capacity() / 1e6, heldBytes / 1e6, heldSeconds, static_cast<unsigned long long>(stats.triggers),
+               static_cast<unsigned long long>(stats.clips), static_cast<unsigned long long>(stats.framesWritten),
+               stats.bytesWritten / 1e6, static_cast<unsigned long long>(stats.framesDropped),
+               static_cast<unsigned long long>(stats.writeErrors));
+    }
+
+    EventStats stats;
+
+private:
+    struct Entry {
+        size_t offset = 0;
+        size_t bytes = 0;
+        int64_t us = 0;  // capture time
+    };
+
+    Entry& entry(uint64_t frame) { return entries[frame % entries.size()]; }
+    const Entry& entry(uint64_t frame) const { return entries[frame % entries.size()]; }
+
+    void evictOldest() {
+        heldBytes -= entry(firstFrame).bytes;
+        firstFrame++;
+        if (--count == 0) writePos = 0;
+    }
+
+    // Finds `bytes` of contiguous free slab after the newest frame,
+    // wrapping to the start when the end is too short. The newest frame
+    // never runs up to the oldest, so a full ring and an empty one differ.
+    bool reserve(size_t bytes, size_t& offset) const {
+        if (bytes > slabBytes) return false;
+        if (count == 0) {
+            offset = 0;
+            return true;
+        }
+        const size_t oldest = entry(firstFrame).offset;
+        if (writePos > oldest) {
+            if (writePos + bytes <= slabBytes) {
+                offset = writePos;
+                return true;
+            }
+            if (bytes < oldest) {
+                offset = 0;
+                return true;
+            }
+            return false;
+        }
+        if (writePos + bytes < oldest) {
+            offset = writePos;
+            return true;
+        }
+        return false;
+    }
+
+    std::string clipPath(size_t index) const {
+        char suffix[24];
+        snprintf(suffix, sizeof(suffix), "-event-%04zu", index);
+        return stem + suffix + extension;
+    }
+
+    // Writer thread: moves clip frames from the slab into the clip file
+    void run() {
+        std::unique_ptr<FrameWriter> writer;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this]() {
+                return closed || (clipOpen && (flushNext < std::min(nextFrame, clipEnd) || flushNext >= clipEnd));
+            });
+            if (!clipOpen) {
+                if (closed) break;
+                continue;
+            }
+            if (!writer) {
+                const std::string path = clipPath(clipCount - 1);
+                lock.unlock();
+                try {
+                    writer.reset(new FrameWriter(path));
+                    printf("Event: writing %s\n", path.c_str());
+                } catch (const std::exception& e) {
+                    fprintf(stderr, "Event recording failed: %s\n", e.what());
+                    stats.writeErrors++;
+                }
+                lock.lock();
+            }
+
+            if (flushNext < std::min(nextFrame, clipEnd)) {
+                // Pinned: write() never evicts frames from flushNext on
+                const Entry e = entry(flushNext);
+                lock.unlock();
+                if (writer) {
+                    // Waiting here only holds back this thread; the slab absorbs the backlog
+                    while (!writer->hasRoom(e.bytes)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    writer->write(slab.get() + e.offset, e.bytes);
+                    stats.framesWritten++;
+                }
+                lock.lock();
+                flushNext++;
+                flushedUpTo = flushNext;
+                continue;
+            }
+
+            // The event is over and every frame of it is queued
+            const uint64_t closedAt = clipEnd;
+            lock.unlock();
+            if (writer) {
+                writer->close();
+                stats.bytesWritten += writer->stats.bytesWritten;
+                stats.writeErrors += writer->stats.writeErrors;
+                writer.reset();
+            }
+            stats.clips++;
+            lock.lock();
+            // A trigger while the clip was closing starts the next one
+            if (eventActive || clipEnd != closedAt) {
+                clipCount++;
+            } else {
+                clipOpen = false;
+            }
+        }
+    }
+
+    std::string stem;
+    std::string extension;
+    size_t slabBytes;
+    int64_t preUs;
+    int64_t postUs;
+    std::unique_ptr<uint8_t[]> slab;
+    std::vector<Entry> entries;  // ring, indexed by frame number
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    uint64_t firstFrame = 0;    // oldest frame held
+    uint64_t nextFrame = 0;     // number of the next frame written
+    size_t count = 0;           // frames held
+    size_t writePos = 0;        // slab offset just past the newest frame
+    size_t heldBytes = 0;
+    bool clipOpen = false;      // a clip is being written
+    bool eventActive = false;   // still inside the post-trigger window
+    bool endPending = false;    // triggered before any frame: the window starts at the next one
+    int64_t eventEndUs = 0;
+    uint64_t flushNext = 0;     // next frame to write to the clip
+    uint64_t flushedUpTo = 0;   // frames below this are in a clip already
+    uint64_t clipEnd = UINT64_MAX;  // first frame after the clip
+    size_t clipCount = 0;
+    bool closed = false;
+    std::thread flusher;
+};
+
+#endif // EVENT_RECORDER_H
@@ -0,0 +1,376 @@
+#ifndef FORMAT_NEGOTIATION_H
+#define FORMAT_NEGOTIATION_H
+
+// Picks the capture format a viewer can show most cheaply.
+//
+// Every pixel format, frame size and frame interval the driver offers
+// (VIDIOC_ENUM_FMT, VIDIOC_ENUM_FRAMESIZES, VIDIOC_ENUM_FRAMEINTERVALS) is
+// matched against the render paths of the viewer. Formats of both the
+// single-planar and the multi-planar capture API are considered, but only
+// render paths that opt in see multi-planar ones. Candidates are ranked by,
+// in order:
+//   1. how far the frame size is from the requested one
+//   2. how far the frame rate falls short of the requested one (or of the
+//      fastest one offered at that size when no rate is requested)
+//   3. the cost per pixel of the render path for that pixel format
+//   4. the frame rate: the lowest that meets the request, else the highest
+// The winner is set with VIDIOC_S_FMT / VIDIOC_S_PARM. Whatever the driver
+// then reports is authoritative: callers size every buffer from the
+// returned v4l2_format (see frameFormat()), never from the request.
+
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace negotiation {
+
+struct Request {
+    uint32_t fourcc = 0;     // 0 = any format with a render path
+    uint32_t width = 640;    // 0 = the largest size offered
+    uint32_t height = 480;
+    double fps = 0.0;        // 0 = the fastest rate offered at the chosen size
+};
+
+// Capture APIs a render path can take frames from
+enum BufferTypes : uint32_t {
+    SINGLE_PLANAR = 1,  // V4L2_BUF_TYPE_VIDEO_CAPTURE
+    MULTI_PLANAR = 2,   // V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE
+    ANY_PLANAR = SINGLE_PLANAR | MULTI_PLANAR,
+};
+
+inline uint32_t bufferTypeBit(uint32_t bufferType) {
+    return bufferType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE ? MULTI_PLANAR : SINGLE_PLANAR;
+}
+
+// One way a viewer can show frames of a pixel format
+struct RenderPath {
+    uint32_t fourcc;
+    const char* name;
+    double costPerPixel;  // rough CPU and bus work; only the ordering matters
+    uint32_t tag;         // for the caller, e.g. which pipeline to build
+    uint32_t bufferTypes = SINGLE_PLANAR;  // multi-planar buffers need their own handling
+};
+
+struct Mode {
+    uint32_t bufferType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    uint32_t fourcc = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    struct v4l2_fract interval{0, 0};  // seconds per frame; 0/0 if the driver lists none
+
+    double fps() const { return interval.numerator ? static_cast<double>(interval.denominator) / interval.numerator : 0.0; }
+};
+
+struct Choice {
+    Mode mode;
+    RenderPath path;
+};
+
+inline bool renders(const RenderPath& path, const Mode& mode) {
+    return path.fourcc == mode.fourcc && (path.bufferTypes & bufferTypeBit(mode.bufferType));
+}
+
+// The negotiated format, whichever capture API it came from
+struct FrameFormat {
+    uint32_t bufferType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    uint32_t fourcc = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t memoryPlanes = 1;  // separately mapped planes per buffer: 2 for NV12M, 3 for YUV420M
+    uint32_t bytesperline[VIDEO_MAX_PLANES]{};  // per memory plane
+    uint32_t sizeimage[VIDEO_MAX_PLANES]{};
+    uint32_t colorspace = V4L2_COLORSPACE_DEFAULT;
+    uint32_t ycbcrEnc = V4L2_YCBCR_ENC_DEFAULT;
+    uint32_t quantization = V4L2_QUANTIZATION_DEFAULT;
+
+    bool multiplanar() const { return bufferType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE; }
+
+    // Where memory plane `plane` starts when all of them are stored back to back
+    size_t packedOffset(uint32_t plane) const {
+        size_t offset = 0;
+        for (uint32_t p = 0; p < plane; p++) offset += sizeimage[p];
+        return offset;
+    }
+
+    size_t frameBytes() const { return packedOffset(memoryPlanes); }
+};
+
+inline FrameFormat frameFormat(const struct v4l2_format& fmt) {
+    FrameFormat f;
+    f.bufferType = fmt.type;
+    if (fmt.type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        const struct v4l2_pix_format_mplane& mp = fmt.fmt.pix_mp;
+        f.fourcc = mp.pixelformat;
+        f.width = mp.width;
+        f.height = mp.height;
+        f.memoryPlanes = std::clamp<uint32_t>(mp.num_planes, 1, VIDEO_MAX_PLANES);
+        for (uint32_t p = 0; p < f.memoryPlanes; p++) {
+            f.bytesperline[p] = mp.plane_fmt[p].bytesperline;
+            f.sizeimage[p] = mp.plane_fmt[p].sizeimage;
+        }
+        f.colorspace = mp.colorspace;
+        f.ycbcrEnc = mp.ycbcr_enc;
+        f.quantization = mp.quantization;
+    } else {
+        f.fourcc = fmt.fmt.pix.pixelformat;
+        f.width = fmt.fmt.pix.width;
+        f.height = fmt.fmt.pix.height;
+        f.bytesperline[0] = fmt.fmt.pix.bytesperline;
+        f.sizeimage[0] = fmt.fmt.pix.sizeimage;
+        f.colorspace = fmt.fmt.pix.colorspace;
+        f.ycbcrEnc = fmt.fmt.pix.ycbcr_enc;
+        f.quantization = fmt.fmt.pix.quantization;
+    }
+    return f;
+}
+
+// One color plane of a planar YUV frame: the memory plane holding it, the
+// offset into that plane, and its pitch in bytes and size in samples (a
+// CbCr pair counts as one sample)
+struct ColorPlane {
+    uint32_t memoryPlane;
+    size_t offset;
+    uint32_t bytesperline;
+    uint32_t width;
+    uint32_t height;
+};
+
+// Y then CbCr (NV12) or Y, Cb, Cr (YUV420); empty for other formats
+inline std::vector<ColorPlane> colorPlanes(const FrameFormat& f) {
+    const uint32_t chromaWidth = (f.width + 1) / 2;
+    const uint32_t chromaHeight = (f.height + 1) / 2;
+    const uint32_t pitch = f.bytesperline[0];
+    const size_t luma = static_cast<size_t>(pitch) * f.height;
+    switch (f.fourcc) {
+    case V4L2_PIX_FMT_NV12:
+        return {{0, 0, pitch, f.width, f.height}, {0, luma, pitch, chromaWidth, chromaHeight}};
+    case V4L2_PIX_FMT_NV12M:
+        return {{0, 0, pitch, f.width, f.height}, {1, 0, f.bytesperline[1], chromaWidth, chromaHeight}};
+    case V4L2_PIX_FMT_YUV420: {
+        // Chroma rows are half the luma pitch
+        size_t chroma = static_cast<size_t>(pitch / 2) * chromaHeight;
+        return {{0, 0, pitch, f.width, f.height},
+                {0, luma, pitch / 2, chromaWidth, chromaHeight},
+                {0, luma + chroma, pitch / 2, chromaWidth, chromaHeight}};
+    }
+    case V4L2_PIX_FMT_YUV420M:
+        return {{0, 0, pitch, f.width, f.height},
+                {1, 0, f.bytesperline[1], chromaWidth, chromaHeight},
+                {2, 0, f.bytesperline[2], chromaWidth, chromaHeight}};
+    default:
+        return {};
+    }
+}
+
+inline std::string fourccName(uint32_t fourcc) {
+    std::string name;
+    for (int i = 0; i < 4; i++) name += static_cast<char>((fourcc >> (8 * i)) & 0xff);
+    return name;
+}
+
+// Requested value snapped onto a stepwise range; `want` 0 means the maximum
+inline uint32_t snapToStep(uint32_t want, uint32_t min, uint32_t max, uint32_t step) {
+    if (want == 0) want = max;
+    want = std::clamp(want, min, max);
+    if (step <= 1) return want;
+    return min + (want - min + step / 2) / step * step;
+}
+
+inline void enumerateIntervals(int fd, Mode mode, const Request& request, std::vector<Mode>& out) {
+    struct v4l2_frmivalenum ival{};
+    ival.pixel_format = mode.fourcc;
+    ival.width = mode.width;
+    ival.height = mode.height;
+    size_t before = out.size();
+    for (ival.index = 0; ioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &ival) == 0; ival.index++) {
+        if (ival.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
+            mode.interval = ival.discrete;
+            out.push_back(mode);
+            continue;
+        }
+        // Stepwise or continuous: the fastest rate, plus the requested one if it is in range
+        mode.interval = ival.stepwise.min;
+        out.push_back(mode);
+        if (request.fps > 0) {
+            struct v4l2_fract wanted{1000, static_cast<uint32_t>(std::lround(request.fps * 1000))};
+            double seconds = 1.0 / request.fps;
+            double fastest = static_cast<double>(ival.stepwise.min.numerator) / ival.stepwise.min.denominator;
+            double slowest = static_cast<double>(ival.stepwise.max.numerator) / ival.stepwise.max.denominator;
+            if (seconds >= fastest && seconds <= slowest) {
+                mode.interval = wanted;
+                out.push_back(mode);
+            }
+        }
+        break;
+    }
+    // Drivers that do not enumerate intervals keep their default rate
+    if (out.size() == before) {
+        mode.interval = {0, 0};
+        out.push_back(mode);
+    }
+}
+
+// Modes of one capture API whose pixel format has a render path
+inline void enumerateFormats(int fd, uint32_t bufferType, const std::vector<RenderPath>& paths,
+                             const Request& request, std::vector<Mode>& modes) {
+    struct v4l2_fmtdesc desc{};
+    desc.type = bufferType;
+    for (desc.index = 0; ioctl(fd, VIDIOC_ENUM_FMT, &desc) == 0; desc.index++) {
+        if (request.fourcc && desc.pixelformat != request.fourcc) continue;
+        Mode mode;
+        mode.bufferType = bufferType;
+        mode.fourcc = desc.pixelformat;
+        bool renderable = false;
+        for (const auto& path : paths) renderable |= renders(path, mode);
+        if (!renderable) continue;
+
+        struct v4l2_frmsizeenum size{};
+        size.pixel_format = desc.pixelformat;
+        size_t before = modes.size();
+        for (size.index = 0; ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &size) == 0; size.index++) {
+            if (size.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+                mode.width = size.discrete.width;
+                mode.height = size.discrete.height;
+                enumerateIntervals(fd, mode, request, modes);
+                continue;
+            }
+            mode.width = snapToStep(request.width, size.stepwise.min_width, size.stepwise.max_width,
+                                    size.stepwise.step_width);
+            mode.height = snapToStep(request.height, size.stepwise.min_height, size.stepwise.max_height,
+                                     size.stepwise.step_height);
+            enumerateIntervals(fd, mode, request, modes);
+            break;
+        }
+        // No size enumeration: offer the requested size and let S_FMT adjust it
+        if (modes.size() == before) {
+            mode.width = request.width ? request.width : 640;
+            mode.height = request.height ? request.height : 480;
+            mode.interval = {0, 0};
+            modes.push_back(mode);
+        }
+    }
+}
+
+// Every mode of the device whose pixel format has a render path. ENUM_FMT
+// simply fails for a capture API the device does not implement.
+inline std::vector<Mode> enumerateModes(int fd, const std::vector<RenderPath>& paths, const Request& request) {
+    std::vector<Mode> modes;
+    enumerateFormats(fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, paths, request, modes);
+    enumerateFormats(fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, paths, request, modes);
+    return modes;
+}
+
+// Best mode by the ranking described at the top; false if none is renderable
+inline bool choose(const std::vector<Mode>& modes, const std::vector<RenderPath>& paths, const Request& request,
+                   Choice& out) {
+    double largestArea = 0.0;
+    for (const auto& m : modes) largestArea = std::max(largestArea, static_cast<double>(m.width) * m.height);
+    auto fastestAt = [&modes](uint32_t width, uint32_t height) {
+        double fastest = 0.0;
+        for (const auto& m : modes) {
+            if (m.width == width && m.height == height) fastest = std::max(fastest, m.fps());
+        }
+        return fastest;
+    };
+
+    bool found = false;
+    std::tuple<double, double, double, double> best;
+    for (const auto& m : modes) {
+        double area = static_cast<double>(m.width) * m.height;
+        double sizePenalty;
+        if (request.width && request.height) {
+            double wanted = static_cast<double>(request.width) * request.height;
+            sizePenalty = std::fabs(area - wanted) / wanted;
+            // A size that needs no scaling beats one with the same area
+            if (m.width != request.width || m.height != request.height) sizePenalty += 1e-3;
+        } else {
+            sizePenalty = 1.0 - area / largestArea;
+        }
+
+        // Unknown rates count as meeting the request: the driver default is all we get
+        double fps = m.fps();
+        double target = request.fps > 0 ? request.fps : fastestAt(m.width, m.height);
+        double fpsShortfall = 0.0;
+        if (target > 0 && fps > 0 && fps < target * 0.95) fpsShortfall = (target - fps) / target;
+        double rateOrder = request.fps > 0 ? fps : -fps;
+
+        for (const auto& path : paths) {
+            if (!renders(path, m)) continue;
+            auto key = std::make_tuple(sizePenalty, fpsShortfall, path.costPerPixel, rateOrder);
+            if (!found || key < best) {
+                best = key;
+                out.mode = m;
+                out.path = path;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+// Applies `choice` and returns the format the driver settled on. Throws if
+// the driver swapped in another pixel format. `fps` receives the rate the
+// driver reports (0 if it cannot say).
+inline struct v4l2_format apply(int fd, const Choice& choice, double& fps) {
+    const Mode& mode = choice.mode;
+    struct v4l2_format fmt{};
+    fmt.type = mode.bufferType;
+    if (mode.bufferType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        // The driver fills in the plane count and the per-plane layout
+        fmt.fmt.pix_mp.width = mode.width;
+        fmt.fmt.pix_mp.height = mode.height;
+        fmt.fmt.pix_mp.pixelformat = mode.fourcc;
+        fmt.fmt.pix_mp.field = V4L2_FIELD_ANY;
+    } else {
+        fmt.fmt.pix.width = mode.width;
+        fmt.fmt.pix.height = mode.height;
+        fmt.fmt.pix.pixelformat = mode.fourcc;
+        fmt.fmt.pix.field = V4L2_FIELD_ANY;
+    }
+    if (ioctl(fd, VIDIOC_S_FMT, &fmt) < 0) throw std::runtime_error("VIDIOC_S_FMT failed");
+    if (frameFormat(fmt).fourcc != mode.fourcc) {
+        throw std::runtime_error("Driver refused pixel format " + fourccName(mode.fourcc));
+    }
+
+    fps = 0.0;
+    struct v4l2_streamparm parm{};
+    parm.type = mode.bufferType;
+    if (ioctl(fd, VIDIOC_G_PARM, &parm) < 0 || !(parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)) return fmt;
+    if (mode.interval.numerator) {
+        parm.parm.capture.timeperframe = mode.interval;
+        ioctl(fd, VIDIOC_S_PARM, &parm);
+    }
+    const struct v4l2_fract& t = parm.parm.capture.timeperframe;
+    if (t.numerator) fps = static_cast<double>(t.denominator) / t.numerator;
+    return fmt;
+}
+
+// enumerateModes + choose + apply, reporting the outcome on stdout
+inline struct v4l2_format negotiate(int fd, const std::vector<RenderPath>& paths, const Request& request,
+                                    const std::string& label, Choice& choice) {
+    std::vector<Mode> modes = enumerateModes(fd, paths, request);
+    if (!choose(modes, paths, request, choice)) {
+        throw std::runtime_error(label + ": no capture format with a render path" +
+                                 (request.fourcc ? " for " + fourccName(request.fourcc) : std::string()));
+    }
+    double fps = 0.0;
+    struct v4l2_format fmt = apply(fd, choice, fps);
+    FrameFormat frame = frameFormat(fmt);
+    printf("%s: %s %ux%u", label.c_str(), fourccName(frame.fourcc).c_str(), frame.width, frame.height);
+    if (frame.multiplanar()) printf(" (multi-planar, %u memory planes)", frame.memoryPlanes);
+    if (fps > 0) printf(" @ %.2f fps", fps);
+    printf(" via %s (%zu modes considered)\n", choice.path.name, modes.size());
+    return fmt;
+}
+
+} // namespace negotiation
+
+#endif // FORMAT_NEGOTIATION_H
@@ -0,0 +1,496 @@
+#ifndef FRAME_BUS_H
+#define FRAME_BUS_H
+
+// Shared-memory frame bus: one capturing process publishes, any number of
+// local processes read the same frames.
+//
+// The frames live in a memfd ring of `slots` slots. The publisher listens on
+// a Unix socket and hands every consumer that connects the memfd (over
+// SCM_RIGHTS) and a consumer index; consumers read frames straight out of
+// their read-only mapping, without a copy.
+//
+// The publisher never waits for anyone. Each slot is a seqlock: its counter
+// is odd while frame n is being written into it and 2n + 2 once it is
+// complete, so a consumer that falls a whole ring behind sees the counter
+// move on and counts the frame as dropped instead of reading a torn one.
+// Consumers block on a futex word in the shared header, which the publisher
+// only wakes when someone is actually waiting. Each consumer has its own read
+// cursor, mirrored into the header so the publisher can report its lag.
+//
+// Times are CLOCK_MONOTONIC microseconds, like the V4L2 capture timestamps.
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace framebus {
+
+const uint32_t MAGIC = 0x53554246;  // "FBUS"
+const uint32_t VERSION = 1;
+const uint32_t MAX_CONSUMERS = 16;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the bus header is shared between processes");
+
+inline int64_t nowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// What the frames are; consumers get it from the bus header
+struct Format {
+    uint32_t fourcc = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bytesperline = 0;
+};
+
+struct alignas(64) ConsumerSlot {
+    std::atomic<uint32_t> active{0};
+    std::atomic<uint64_t> cursor{0};   // next frame the consumer will read
+    std::atomic<uint64_t> dropped{0};  // overwritten before the consumer got to them
+};
+
+// Start of the memfd. The slots follow at dataOffset, slotStride apart.
+struct BusHeader {
+    uint32_t magic;
+    uint32_t version;
+    Format format;
+    uint32_t slotCount;
+    uint64_t slotBytes;   // payload capacity of a slot
+    uint64_t slotStride;  // slot header + payload, page aligned
+    uint64_t dataOffset;
+
+    alignas(64) std::atomic<uint64_t> published{0};  // frames published so far
+    std::atomic<uint32_t> futexWord{0};              // low 32 bits of published
+    std::atomic<uint32_t> waiters{0};                // consumers in FUTEX_WAIT
+    std::atomic<uint32_t> closed{0};                 // the publisher is gone
+    ConsumerSlot consumers[MAX_CONSUMERS];
+};
+
+struct alignas(64) SlotHeader {
+    std::atomic<uint64_t> seq{0};  // 2n + 1 while frame n is written, 2n + 2 once it is complete
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<int64_t> captureUs{0};
+    std::atomic<int64_t> publishedUs{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+inline long futex(std::atomic<uint32_t>* word, int op, uint32_t value, const struct timespec* timeout) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), op, value, timeout, nullptr, 0);
+}
+
+inline size_t pageAlign(size_t bytes) {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return (bytes + page - 1) / page * page;
+}
+
+inline sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw std::runtime_error("Frame bus socket path too long: " + path);
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+struct PublisherStats {
+    uint64_t published = 0;
+    uint64_t truncated = 0;  // frames larger than a slot, cut to fit
+    uint64_t consumersSeen = 0;
+    uint64_t consumersRefused = 0;  // all MAX_CONSUMERS slots taken
+    double seconds = 0.0;  // in publish()
+};
+
+class Publisher {
+public:
+    // `slotBytes` must hold the largest frame (the V4L2 sizeimage)
+    Publisher(const std::string& socketPath, const Format& format, size_t slotBytes, uint32_t slots = 8)
+        : socketPath(socketPath) {
+        slots = std::max<uint32_t>(slots, 2);
+        const size_t dataOffset = pageAlign(sizeof(BusHeader));
+        const size_t slotStride = pageAlign(sizeof(SlotHeader) + slotBytes);
+        mappedBytes = dataOffset + slotStride * slots;
+
+        memfd = memfd_create("v4l2-frame-bus", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (memfd < 0) throw std::runtime_error(std::string("memfd_create failed: ") + strerror(errno));
+        if (ftruncate(memfd, static_cast<off_t>(mappedBytes)) < 0) {
+            close(memfd);
+            throw std::runtime_error(std::string("Sizing the frame bus failed: ") + strerror(errno));
+        }
+        // Consumers can map the ring but never resize it under the publisher
+        fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+        void* mapped = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, memfd, 0);
+        if (mapped == MAP_FAILED) {
+            close(memfd);
+            throw std::runtime_error(std::string("Mapping the frame bus failed: ") + strerror(errno));
+        }
+        base = static_cast<uint8_t*>(mapped);
+
+        header = new (base) BusHeader();
+        header->format = format;
+        header->slotCount = slots;
+        header->slotBytes = slotBytes;
+        header->slotStride = slotStride;
+        header->dataOffset = dataOffset;
+        for (uint32_t i = 0; i < slots; i++) new (base + dataOffset + slotStride * i) SlotHeader();
+        header->version = VERSION;
+        header->magic = MAGIC;
+
+        listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sockaddr_un addr = socketAddress(socketPath);
+        unlink(socketPath.c_str());
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+            listen(listener, MAX_CONSUMERS) < 0) {
+            std::string error = strerror(errno);
+            if (listener >= 0) close(listener);
+            munmap(base, mappedBytes);
+            close(memfd);
+            throw std::runtime_error("Listening on " + socketPath + " failed: " + error);
+        }
+    }
+
+    ~Publisher() {
+        header->closed.store(1);
+        futex(&header->futexWord, FUTEX_WAKE, INT_MAX, nullptr);
+        for (const Client& client : clients) close(client.fd);
+        close(listener);
+        unlink(socketPath.c_str());
+        munmap(base, mappedBytes);
+        close(memfd);
+    }
+
+    Publisher(const Publisher&) = delete;
+    Publisher& operator=(const Publisher&) = delete;
+
+    const std::string& path() const { return socketPath; }
+    uint32_t slots() const { return header->slotCount; }
+    size_t consumers() const { return clients.size(); }
+
+    // Copies the frame into the next slot and wakes waiting consumers. New
+    // consumers are accepted and departed ones reaped every 100 ms from here,
+    // so the bus needs no thread of its own.
+    void publish(const void* data, size_t bytes, uint64_t sequence, const struct timeval& timestamp) {
+        auto start = nowUs();
+        if (start >= nextServiceUs) {
+            service();
+            nextServiceUs = start + 100000;
+        }
+
+        const uint64_t n = stats.published;
+        SlotHeader* slot = slotAt(n % header->slotCount);
+        slot->seq.store(2 * n + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        if (bytes > header->slotBytes) {
+            bytes = header->slotBytes;
+            stats.truncated++;
+        }
+        memcpy(reinterpret_cast<uint8_t*>(slot) + sizeof(SlotHeader), data, bytes);
+        slot->sequence.store(sequence, std::memory_order_relaxed);
+        slot->captureUs.store(static_cast<int64_t>(timestamp.tv_sec) * 1000000 + timestamp.tv_usec,
+                              std::memory_order_relaxed);
+        slot->publishedUs.store(nowUs(), std::memory_order_relaxed);
+        slot->bytes.store(bytes, std::memory_order_relaxed);
+        slot->seq.store(2 * n + 2, std::memory_order_release);
+
+        // A consumer registers as a waiter before re-checking `published`,
+        // so one of the two always sees the other
+        header->published.store(n + 1);
+        header->futexWord.store(static_cast<uint32_t>(n + 1));
+        if (header->waiters.load() > 0) futex(&header->futexWord, FUTEX_WAKE, INT_MAX, nullptr);
+        stats.published++;
+        stats.seconds += (nowUs() - start) * 1e-6;
+    }
+
+    void print(const char* label) const {
+        printf("%s: published %llu frames on %s (%u slots), %.3f ms per frame, %llu truncated, "
+               "%llu consumers (%llu refused)\n",
+               label, static_cast<unsigned long long>(stats.published), socketPath.c_str(), header->slotCount,
+               stats.published ? stats.seconds * 1e3 / stats.published : 0.0,
+               static_cast<unsigned long long>(stats.truncated), static_cast<unsigned long long>(stats.consumersSeen),
+               static_cast<unsigned long long>(stats.consumersRefused));
+        for (const Client& client : clients) {
+            const ConsumerSlot& consumer = header->consumers[client.index];
+            printf("%s: consumer %u is %llu frames behind, %llu dropped\n", label, client.index,
+                   static_cast<unsigned long long>(stats.published - std::min<uint64_t>(consumer.cursor, stats.published)),
+                   static_cast<unsigned long long>(consumer.dropped.load()));
+        }
+    }
+
+    PublisherStats stats;
+
+private:
+    struct Client {
+        int fd;
+        uint32_t index;
+    };
+
+    SlotHeader* slotAt(uint32_t index) const {
+        return reinterpret_cast<SlotHeader*>(base + header->dataOffset + header->slotStride * index);
+    }
+
+    void service() {
+        // Departed consumers: the socket reads as closed
+        for (size_t i = 0; i < clients.size();) {
+            pollfd pfd = {clients[i].fd, POLLIN, 0};
+            char byte;
+            if (poll(&pfd, 1, 0) > 0 && recv(clients[i].fd, &byte, 1, MSG_DONTWAIT) <= 0) {
+                header->consumers[clients[i].index].active.store(0);
+                close(clients[i].fd);
+                clients.erase(clients.begin() + i);
+            } else {
+                i++;
+            }
+        }
+
+        int fd;
+        while ((fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC)) >= 0) {
+            uint32_t index = 0;
+            while (index < MAX_CONSUMERS && header->consumers[index].active.load()) index++;
+            if (index == MAX_CONSUMERS || !sendBus(fd, index)) {
+                stats.consumersRefused++;
+                close(fd);
+                continue;
+            }
+            stats.consumersSeen++;
+            clients.push_back({fd, index});
+        }
+    }
+
+    // The consumer index travels as the payload, the memfd as SCM_RIGHTS
+    bool sendBus(int fd, uint32_t index) {
+        ConsumerSlot& consumer = header->consumers[index];
+        consumer.cursor.store(header->published.load());
+        consumer.dropped.store(0);
+        consumer.active.store(1);
+
+        iovec iov = {&index, sizeof(index)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+        msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+        if (sendmsg(fd, &msg, MSG_NOSIGNAL) != sizeof(index)) {
+            consumer.active.store(0);
+            return false;
+        }
+        return true;
+    }
+
+    std::string socketPath;
+    int memfd = -1;
+    int listener = -1;
+    uint8_t* base = nullptr;
+    size_t mappedBytes = 0;
+    BusHeader* header = nullptr;
+    std::vector<Client> clients;
+    int64_t nextServiceUs = 0;
+};
+
+// A frame as it sits in the ring. `data` stays readable while the consumer
+// is connected, but the publisher may overwrite it once the ring wraps:
+// check Consumer::valid() after using it.
+struct BusFrame {
+    const uint8_t* data = nullptr;
+    size_t bytes = 0;
+    uint64_t index = 0;     // bus frame number
+    uint64_t sequence = 0;  // V4L2 sequence
+    int64_t captureUs = 0;
+    int64_t publishedUs = 0;
+};
+
+struct ConsumerStats {
+    uint64_t received = 0;
+    uint64_t dropped = 0;  // overwritten before they were read
+    uint64_t skipped = 0;  // passed over for a newer frame (latest mode)
+};
+
+class Consumer {
+public:
+    // Connects to a publisher and maps its ring. Throws if there is none.
+    explicit Consumer(const std::string& socketPath) {
+        sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        sockaddr_un addr = socketAddress(socketPath);
+        if (sock < 0 || connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            std::string error = strerror(errno);
+            if (sock >= 0) close(sock);
+            throw std::runtime_error("Connecting to frame bus " + socketPath + " failed: " + error);
+        }
+
+        int memfd = -1;
+        iovec iov = {&index, sizeof(index)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+        msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) == sizeof(index)) {
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                memcpy(&memfd, CMSG_DATA(cmsg), sizeof(int));
+            }
+        }
+        if (memfd < 0) {
+            close(sock);
+            throw std::runtime_error("Frame bus " + socketPath + " refused the connection");
+        }
+
+        // The header (cursors, futex word) is written by both sides; the
+        // frames only by the publisher
+        struct stat st;
+        void* head = fstat(memfd, &st) == 0
+                         ? mmap(nullptr, pageAlign(sizeof(BusHeader)), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0)
+                         : MAP_FAILED;
+        if (head == MAP_FAILED) {
+            close(memfd);
+            close(sock);
+            throw std::runtime_error("Mapping frame bus " + socketPath + " failed");
+        }
+        header = static_cast<BusHeader*>(head);
+        if (header->magic != MAGIC || header->version != VERSION) {
+            munmap(head, pageAlign(sizeof(BusHeader)));
+            close(memfd);
+            close(sock);
+            throw std::runtime_error(socketPath + " is not a compatible frame bus");
+        }
+        dataBytes = static_cast<size_t>(st.st_size) - header->dataOffset;
+        void* data = mmap(nullptr, dataBytes, PROT_READ, MAP_SHARED | MAP_POPULATE, memfd, header->dataOffset);
+        close(memfd);
+        if (data == MAP_FAILED) {
+            munmap(head, pageAlign(sizeof(BusHeader)));
+            close(sock);
+            throw std::runtime_error("Mapping frame bus " + socketPath + " failed");
+        }
+        slotsBase = static_cast<const uint8_t*>(data);
+        cursor = header->consumers[index].cursor.load();
+    }
+
+    ~Consumer() {
+        munmap(const_cast<uint8_t*>(slotsBase), dataBytes);
+        munmap(header, pageAlign(sizeof(BusHeader)));
+        close(sock);
+    }
+
+    Consumer(const Consumer&) = delete;
+    Consumer& operator=(const Consumer&) = delete;
+
+    const Format& format() const { return header->format; }
+    uint32_t slots() const { return header->slotCount; }
+    uint32_t consumerIndex() const { return index; }
+    bool closed() const { return header->closed.load() != 0; }
+
+    // Waits up to `timeoutMs` for the frame after the last one read, or with
+    // `latest` for the newest one. A consumer that fell more than a ring
+    // behind resumes at the oldest frame still intact. False on timeout or
+    // once the publisher has gone.
+    bool next(BusFrame& frame, int timeoutMs, bool latest = false) {
+        const int64_t deadline = nowUs() + static_cast<int64_t>(timeoutMs) * 1000;
+        for (;;) {
+            const uint64_t published = header->published.load();
+            if (cursor < published) {
+                // The slot after the newest may be mid-write, so one fewer than a ring is safe
+                const uint64_t oldest = published > header->slotCount - 1 ? published - (header->slotCount - 1) : 0;
+                if (latest && published - 1 > cursor) {
+                    stats.skipped += published - 1 - cursor;
+                    cursor = published - 1;
+                } else if (cursor < oldest) {
+                    drop(oldest - cursor);
+                    cursor = oldest;
+                }
+                if (read(cursor, frame)) {
+                    cursor++;
+                    header->consumers[index].cursor.store(cursor, std::memory_order_relaxed);
+                    stats.received++;
+                    return true;
+                }
+                // Overwritten between the check and the read
+                drop(1);
+                cursor++;
+                continue;
+            }
+            if (closed()) return false;
+            const int64_t remaining = deadline - nowUs();
+            if (remaining <= 0) return false;
+
+            const uint32_t word = header->futexWord.load();
+            header->waiters.fetch_add(1);
+            if (header->published.load() == published && !closed()) {
+                struct timespec timeout = {static_cast<time_t>(remaining / 1000000),
+                                           static_cast<long>(remaining % 1000000) * 1000};
+                futex(&header->futexWord, FUTEX_WAIT, word, &timeout);
+            }
+            header->waiters.fetch_sub(1);
+        }
+    }
+
+    // True if the publisher has not started overwriting the frame's slot
+    bool valid(const BusFrame& frame) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slotAt(frame.index % header->slotCount)->seq.load(std::memory_order_relaxed) == 2 * frame.index + 2;
+    }
+
+    // Counts a frame found overwritten after valid() returned false
+    void dropped(const BusFrame&) { drop(1); }
+
+    ConsumerStats stats;
+
+private:
+    const SlotHeader* slotAt(uint32_t slot) const {
+        return reinterpret_cast<const SlotHeader*>(slotsBase + header->slotStride * slot);
+    }
+
+    bool read(uint64_t n, BusFrame& frame) const {
+        const SlotHeader* slot = slotAt(n % header->slotCount);
+        if (slot->seq.load(std::memory_order_acquire) != 2 * n + 2) return false;
+        frame.data = reinterpret_cast<const uint8_t*>(slot) + sizeof(SlotHeader);
+        frame.bytes = slot->bytes.load(std::memory_order_relaxed);
+        frame.index = n;
+        frame.sequence = slot->sequence.load(std::memory_order_relaxed);
+        frame.captureUs = slot->captureUs.load(std::memory_order_relaxed);
+        frame.publishedUs = slot->publishedUs.load(std::memory_order_relaxed);
+        return valid(frame);
+    }
+
+    void drop(uint64_t frames) {
+        stats.dropped += frames;
+        header->consumers[index].dropped.fetch_add(frames, std::memory_order_relaxed);
+    }
+
+    int sock = -1;
+    uint32_t index = 0;
+    BusHeader* header = nullptr;
+    const uint8_t* slotsBase = nullptr;
+    size_t dataBytes = 0;
+    uint64_t cursor = 0;
+};
+
+} // namespace framebus
+
+#endif // FRAME_BUS_H
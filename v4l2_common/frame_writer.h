@@ -0,0 +1,334 @@
+#ifndef FRAME_WRITER_H
+#define FRAME_WRITER_H
+
+// Asynchronous recorder for raw frames.
+//
+// The render thread copies each frame into a pool of large aligned chunks
+// and never touches the disk. A writer thread writes full chunks with
+// io_uring (several in flight at once), falling back to pwrite() when
+// io_uring is unavailable. The file is opened with O_DIRECT where the
+// filesystem allows it, which is why chunks are always written whole at
+// aligned offsets; the padded tail is truncated away on close().
+//
+// If no chunk is free, write() drops the frame and counts it instead of
+// blocking capture.
+
+#include "spsc_ring.h"
+#include "uring.h"
+
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct WriterStats {
+    std::atomic<uint64_t> framesQueued{0};    // frames copied into the write queue
+    std::atomic<uint64_t> framesDropped{0};   // frames dropped because the queue was full
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> writeErrors{0};
+    std::atomic<uint64_t> queueDepth{0};      // chunks waiting or being written
+    std::atomic<uint64_t> maxQueueDepth{0};
+    std::atomic<double> throughput{0.0};      // MB/s over the last second
+
+    void print(const char* label) const {
+        printf("%s: queued %llu, dropped %llu, wrote %.1f MB, errors %llu, max queue depth %llu, %.1f MB/s\n", label,
+               static_cast<unsigned long long>(framesQueued.load()),
+               static_cast<unsigned long long>(framesDropped.load()), bytesWritten.load() / 1e6,
+               static_cast<unsigned long long>(writeErrors.load()),
+               static_cast<unsigned long long>(maxQueueDepth.load()), throughput.load());
+    }
+};
+
+class FrameWriter {
+public:
+    // Alignment for O_DIRECT buffers, offsets and lengths
+    static constexpr size_t ALIGNMENT = 4096;
+
+    FrameWriter(const std::string& path, size_t chunkBytes = 4 << 20, size_t chunkCount = 8)
+        : chunkBytes((chunkBytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1)), chunks(chunkCount), filled(chunkCount),
+          freeChunks(chunkCount) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        directIo = fd >= 0;
+        if (fd < 0 && errno == EINVAL) fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::runtime_error("Failed to open " + path + ": " + strerror(errno));
+        // Blocking, so an io_uring read on it waits instead of failing with EAGAIN
+        wakeFd = eventfd(0, EFD_CLOEXEC);
+        if (wakeFd < 0) {
+            releaseSetup();
+            throw std::runtime_error("Failed to create writer eventfd");
+        }
+
+        for (auto& chunk : chunks) {
+            chunk.data = static_cast<uint8_t*>(aligned_alloc(ALIGNMENT, this->chunkBytes));
+            if (!chunk.data) {
+                releaseSetup();
+                throw std::runtime_error("Failed to allocate write chunk");
+            }
+            freeChunks.push(&chunk);
+        }
+        uringActive = uring.init(static_cast<unsigned>(chunkCount + 1));
+        worker = std::thread(&FrameWriter::run, this);
+    }
+
+    ~FrameWriter() {
+        close();
+        for (auto& chunk : chunks) free(chunk.data);
+        ::close(wakeFd);
+    }
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    bool usingIoUring() const { return uringActive; }
+    bool usingDirectIo() const { return directIo; }
+
+    // True if write() would take a frame of `bytes` right now
+    bool hasRoom(size_t bytes) const {
+        size_t room = current ? chunkBytes - current->used : 0;
+        return bytes <= room + freeChunks.size() * chunkBytes;
+    }
+
+    // Render thread: queues a copy of the frame. Returns false (and counts a
+    // drop) if the queue cannot take the whole frame right now.
+    bool write(const void* data, size_t bytes) {
+        if (closed) return false;
+        if (!hasRoom(bytes)) {
+            stats.framesDropped++;
+            return false;
+        }
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        while (bytes > 0) {
+            if (!current) {
+                freeChunks.pop(current);
+                current->used = 0;
+                current->written = 0;
+                current->offset = nextOffset;
+                nextOffset += chunkBytes;
+            }
+            size_t n = std::min(bytes, chunkBytes - current->used);
+            memcpy(current->data + current->used, src, n);
+            current->used += n;
+            src += n;
+            bytes -= n;
+            if (current->used == chunkBytes) queueCurrent();
+        }
+        stats.framesQueued++;
+        return true;
+    }
+
+    // Flushes everything queued, trims the file to its real size and stops
+    // the writer thread
+    void close() {
+        if (closed) return;
+        closed = true;
+        if (current) {
+            fileSize = current->offset + current->used;
+            // O_DIRECT writes whole aligned blocks; pad with zeros and truncate later
+            memset(current->data + current->used, 0, chunkBytes - current->used);
+            current->used = directIo ? (current->used + ALIGNMENT - 1) & ~(ALIGNMENT - 1) : current->used;
+            queueCurrent();
+        } else {
+            fileSize = nextOffset;
+        }
+        finishing = true;
+        wake();
+        if (worker.joinable()) worker.join();
+        if (ftruncate(fd, static_cast<off_t>(fileSize)) < 0) stats.writeErrors++;
+        ::close(fd);
+    }
+
+    WriterStats stats;
+
+private:
+    static constexpr uint64_t WAKE_TOKEN = ~uint64_t(0);
+
+    struct Chunk {
+        uint8_t* data = nullptr;
+        size_t used = 0;      // bytes to write
+        size_t written = 0;   // bytes already written
+        uint64_t offset = 0;  // file offset
+    };
+
+    // A throwing constructor never reaches the destructor
+    void releaseSetup() {
+        for (auto& chunk : chunks) free(chunk.data);
+        if (wakeFd >= 0) ::close(wakeFd);
+        ::close(fd);
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t ret = ::write(wakeFd, &one, sizeof(one));
+        (void)ret;
+    }
+
+    void queueCurrent() {
+        filled.push(current);
+        current = nullptr;
+        wake();
+    }
+
+    // Some filesystems accept O_DIRECT at open() but reject the writes
+    void disableDirectIo() {
+        if (!directIo) return;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+        directIo = false;
+    }
+
+    // Handles a finished write; returns true once the chunk is fully written
+    bool completeWrite(Chunk* chunk, int result) {
+        if (result == -EINVAL && directIo) {
+            disableDirectIo();
+            return false;
+        }
+        if (result == -EINTR || result == -EAGAIN) return false;
+        if (result <= 0) {
+            stats.writeErrors++;
+            if (!reportedError) {
+                std::cerr << "Recording write failed: " << strerror(-result) << std::endl;
+                reportedError = true;
+            }
+            return true;  // give up on this chunk
+        }
+        chunk->written += result;
+        stats.bytesWritten += result;
+        return chunk->written >= chunk->used;
+    }
+
+    void updateDepth(size_t inFlight) {
+        uint64_t depth = filled.size() + inFlight;
+        stats.queueDepth = depth;
+        if (depth > stats.maxQueueDepth) stats.maxQueueDepth = depth;
+    }
+
+    void updateThroughput() {
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - rateStart).count();
+        if (seconds < 1.0) return;
+        uint64_t bytes = stats.bytesWritten;
+        stats.throughput = (bytes - rateBytes) / seconds / 1e6;
+        rateBytes = bytes;
+        rateStart = now;
+    }
+
+    bool done(size_t inFlight) { return finishing && inFlight == 0 && filled.size() == 0; }
+
+    void run() {
+        if (uringActive) runUring();
+        else runPwrite();
+    }
+
+    void runUring() {
+        size_t inFlight = 0;
+        uint64_t wakeCount = 0;
+        bool wakePending = false;
+        bool wakeUnsupported = false;  // IORING_OP_READ needs Linux 5.6
+        std::vector<Chunk*> retry;
+        while (true) {
+            if (wakeUnsupported && inFlight == 0) break;
+            if (!wakePending && !wakeUnsupported) {
+                uring.prepRead(uring.getSqe(), wakeFd, &wakeCount, sizeof(wakeCount), 0, WAKE_TOKEN);
+                wakePending = true;
+            }
+            Chunk* chunk;
+            while (filled.pop(chunk)) retry.push_back(chunk);
+            for (Chunk* c : retry) {
+                uring.prepWrite(uring.getSqe(), fd, c->data + c->written, static_cast<unsigned>(c->used - c->written),
+                                c->offset + c->written, reinterpret_cast<uint64_t>(c));
+                inFlight++;
+            }
+            retry.clear();
+            updateDepth(inFlight);
+            if (done(inFlight)) break;
+
+            int ret = uring.submit(1);
+            if (ret < 0 && ret != -EINTR) {
+                std::cerr << "io_uring_enter failed: " << strerror(-ret) << std::endl;
+                break;
+            }
+
+            struct io_uring_cqe cqe;
+            while (uring.popCqe(cqe)) {
+                if (cqe.user_data == WAKE_TOKEN) {
+                    wakePending = false;
+                    if (cqe.res < 0 && cqe.res != -EINTR && cqe.res != -EAGAIN) wakeUnsupported = true;
+                    continue;
+                }
+                Chunk* c = reinterpret_cast<Chunk*>(cqe.user_data);
+                inFlight--;
+                if (completeWrite(c, cqe.res)) freeChunks.push(c);
+                else retry.push_back(c);
+            }
+            updateThroughput();
+        }
+        // Anything left (only after an io_uring failure) goes out the slow way
+        for (Chunk* c : retry) writeBlocking(c);
+        runPwrite();
+    }
+
+    void writeBlocking(Chunk* chunk) {
+        while (true) {
+            ssize_t n = pwrite(fd, chunk->data + chunk->written, chunk->used - chunk->written,
+                               static_cast<off_t>(chunk->offset + chunk->written));
+            if (completeWrite(chunk, n < 0 ? -errno : static_cast<int>(n))) break;
+        }
+        freeChunks.push(chunk);
+    }
+
+    void runPwrite() {
+        while (true) {
+            Chunk* chunk;
+            while (filled.pop(chunk)) {
+                updateDepth(1);
+                writeBlocking(chunk);
+                updateThroughput();
+            }
+            updateDepth(0);
+            if (done(0)) break;
+            struct pollfd pfd{};
+            pfd.fd = wakeFd;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, 100) > 0) {
+                uint64_t count;
+                ssize_t ret = read(wakeFd, &count, sizeof(count));
+                (void)ret;
+            }
+            updateThroughput();
+        }
+    }
+
+    size_t chunkBytes;
+    std::vector<Chunk> chunks;
+    SpscRing<Chunk*> filled;      // render -> writer
+    SpscRing<Chunk*> freeChunks;  // writer -> render
+    Chunk* current = nullptr;     // chunk the render thread is filling
+    uint64_t nextOffset = 0;
+    uint64_t fileSize = 0;
+    bool closed = false;
+
+    int fd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> directIo{false};
+    std::atomic<bool> finishing{false};
+    bool uringActive = false;
+    bool reportedError = false;
+    Uring uring;
+    std::chrono::steady_clock::time_point rateStart = std::chrono::steady_clock::now();
+    uint64_t rateBytes = 0;
+    std::thread worker;
+};
+
+#endif // FRAME_WRITER_H
@@ -0,0 +1,149 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+// Capture-to-screen latency per pipeline stage.
+//
+// Every sample is the time from the V4L2 buffer timestamp (taken by the
+// driver when the frame was captured) to the moment a stage finished with
+// that frame, so the last stage of a viewer is its glass-to-glass latency
+// minus the sensor exposure and the display scan-out. V4L2 timestamps are
+// CLOCK_MONOTONIC, and so are the stage times taken here.
+//
+// Histograms use 100 us buckets up to one second. Each stage keeps a total
+// over the whole run and a window that is emptied every time it is written
+// to the CSV file, so the CSV shows latency over time.
+
+#include <sys/time.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class LatencyHistogram {
+public:
+    static constexpr int64_t BUCKET_US = 100;
+    static constexpr size_t BUCKETS = 10000;  // one second; slower frames land in the last bucket
+
+    void add(int64_t us) {
+        size_t bucket = std::min<size_t>(static_cast<size_t>(us / BUCKET_US), BUCKETS - 1);
+        counts[bucket]++;
+        samples++;
+        maxUs = std::max(maxUs, us);
+    }
+
+    void reset() {
+        std::fill(counts.begin(), counts.end(), 0);
+        samples = 0;
+        maxUs = 0;
+    }
+
+    uint64_t count() const { return samples; }
+    int64_t max() const { return maxUs; }
+
+    // Upper edge of the bucket holding the p-th percentile (0 < p <= 100)
+    int64_t percentile(double p) const {
+        if (samples == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(samples * p / 100.0 + 0.5);
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) return std::min<int64_t>((static_cast<int64_t>(i) + 1) * BUCKET_US, maxUs);
+        }
+        return maxUs;
+    }
+
+private:
+    std::vector<uint64_t> counts = std::vector<uint64_t>(BUCKETS);
+    uint64_t samples = 0;
+    int64_t maxUs = 0;
+};
+
+// CSV file shared by every tracker of a viewer
+class LatencyCsv {
+public:
+    explicit LatencyCsv(const std::string& path) {
+        file = fopen(path.c_str(), "w");
+        if (!file) throw std::runtime_error("Failed to open " + path);
+        fprintf(file, "elapsed_s,source,stage,window,count,p50_ms,p99_ms,max_ms\n");
+    }
+
+    ~LatencyCsv() { fclose(file); }
+
+    LatencyCsv(const LatencyCsv&) = delete;
+    LatencyCsv& operator=(const LatencyCsv&) = delete;
+
+    void write(double elapsed, const std::string& source, const std::string& stage, const char* window,
+               const LatencyHistogram& h) {
+        fprintf(file, "%.3f,%s,%s,%s,%llu,%.2f,%.2f,%.2f\n", elapsed, source.c_str(), stage.c_str(), window,
+                static_cast<unsigned long long>(h.count()), h.percentile(50) / 1000.0, h.percentile(99) / 1000.0,
+                h.max() / 1000.0);
+        fflush(file);
+    }
+
+private:
+    FILE* file = nullptr;
+};
+
+// Render thread only
+class LatencyTracker {
+public:
+    LatencyTracker(const std::string& source, const std::vector<std::string>& stageNames)
+        : source(source), names(stageNames), total(stageNames.size()), window(stageNames.size()) {}
+
+    static int64_t nowUs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    static int64_t toUs(const struct timeval& tv) { return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec; }
+
+    // Stage `stage` finished with the frame captured at `captureUs`
+    void record(size_t stage, int64_t captureUs, int64_t atUs = nowUs()) {
+        int64_t us = atUs - captureUs;
+        // Not a monotonic timestamp (or none at all); would only skew the figures
+        if (captureUs <= 0 || us < 0 || us > 10000000) {
+            invalid++;
+            return;
+        }
+        total[stage].add(us);
+        window[stage].add(us);
+    }
+
+    // Appends the current window of every stage and starts a new one
+    void writeWindow(LatencyCsv& csv, double elapsed) {
+        for (size_t i = 0; i < names.size(); i++) {
+            csv.write(elapsed, source, names[i], "window", window[i]);
+            window[i].reset();
+        }
+    }
+
+    void writeTotals(LatencyCsv& csv, double elapsed) const {
+        for (size_t i = 0; i < names.size(); i++) csv.write(elapsed, source, names[i], "total", total[i]);
+    }
+
+    void print() const {
+        printf("%s latency since capture:\n", source.c_str());
+        for (size_t i = 0; i < names.size(); i++) {
+            const LatencyHistogram& h = total[i];
+            printf("  %-12s p50 %7.2f ms  p99 %7.2f ms  max %7.2f ms  (%llu frames)\n", names[i].c_str(),
+                   h.percentile(50) / 1000.0, h.percentile(99) / 1000.0, h.max() / 1000.0,
+                   static_cast<unsigned long long>(h.count()));
+        }
+        if (invalid) printf("  %llu samples without a usable timestamp\n", static_cast<unsigned long long>(invalid));
+    }
+
+private:
+    std::string source;
+    std::vector<std::string> names;
+    std::vector<LatencyHistogram> total;
+    std::vector<LatencyHistogram> window;
+    uint64_t invalid = 0;
+};
+
+#endif // LATENCY_STATS_H
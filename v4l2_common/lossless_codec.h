@@ -0,0 +1,345 @@
+#ifndef LOSSLESS_CODEC_H
+#define LOSSLESS_CODEC_H
+
+// Fast lossless compression for raw captured frames.
+//
+// Each frame is cut into stripes of STRIPE_ROWS rows that are coded
+// independently, so decode can run one stripe per thread. Within a stripe
+// every byte is predicted from its neighbours of the same component:
+// the first row uses the left neighbour (plain delta), later rows the
+// LOCO-I median predictor over left, up and up-left. The residuals are then
+// Huffman coded with a per-stripe table whose codes are at most
+// MAX_CODE_BITS long so the decoder needs a single table lookup per byte.
+// A stripe that does not shrink is stored raw.
+//
+// Frame payload:
+//   uint32 stripeCount, uint32 stripeBytes[stripeCount], stripes...
+// Huffman stripe:
+//   uint8 mode (1), uint8 codeLengths[128] (two 4-bit lengths per byte),
+//   LSB-first bitstream, 8 zero bytes of padding
+// Raw stripe:
+//   uint8 mode (0), rows of unpadded pixel data
+
+#include "thread_pool.h"
+
+#include <linux/videodev2.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+namespace lossless {
+
+const uint32_t STRIPE_ROWS = 32;
+const int MAX_CODE_BITS = 11;
+
+struct FrameLayout {
+    uint32_t fourcc = V4L2_PIX_FMT_YUYV;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bytesperline = 0;  // source/destination row stride
+
+    uint32_t rowBytes() const {
+        switch (fourcc) {
+        case V4L2_PIX_FMT_YUYV: return width * 2;
+        case V4L2_PIX_FMT_RGB24:
+        case V4L2_PIX_FMT_BGR24: return width * 3;
+        default: return width;
+        }
+    }
+    uint32_t stripeCount() const { return (height + STRIPE_ROWS - 1) / STRIPE_ROWS; }
+};
+
+// Byte distance to the previous sample of the same component, by position
+// within a repeating group of `period` bytes
+struct ComponentLayout {
+    uint32_t period;
+    uint32_t distance[4];
+};
+
+inline ComponentLayout componentLayout(uint32_t fourcc) {
+    switch (fourcc) {
+    case V4L2_PIX_FMT_YUYV: return {4, {2, 4, 2, 4}};  // Y U Y V
+    case V4L2_PIX_FMT_RGB24:
+    case V4L2_PIX_FMT_BGR24: return {1, {3, 3, 3, 3}};
+    default: return {1, {1, 1, 1, 1}};
+    }
+}
+
+// LOCO-I median edge detector: median of a, b and a + b - c
+inline uint8_t medianPredict(int a, int b, int c) {
+    int lo = std::min(a, b), hi = std::max(a, b);
+    return static_cast<uint8_t>(std::clamp(a + b - c, lo, hi));
+}
+
+// Residuals of one row; `up` is nullptr for the first row of a stripe. The
+// first group of bytes has no left neighbour and is handled separately so
+// the main loop is branch-free apart from the median itself.
+inline void predictRow(const ComponentLayout& comp, const uint8_t* row, const uint8_t* up, uint8_t* residual,
+                       uint32_t bytes) {
+    uint32_t head = std::min<uint32_t>(4, bytes);
+    for (uint32_t x = 0; x < head; x++) {
+        uint32_t d = comp.distance[x % comp.period];
+        uint8_t pred = x >= d ? (up ? medianPredict(row[x - d], up[x], up[x - d]) : row[x - d]) : (up ? up[x] : 0);
+        residual[x] = static_cast<uint8_t>(row[x] - pred);
+    }
+    uint32_t phase = head % comp.period;
+    if (!up) {
+        for (uint32_t x = head; x < bytes; x++) {
+            uint32_t d = comp.distance[phase];
+            residual[x] = static_cast<uint8_t>(row[x] - row[x - d]);
+            if (++phase == comp.period) phase = 0;
+        }
+        return;
+    }
+    for (uint32_t x = head; x < bytes; x++) {
+        uint32_t d = comp.distance[phase];
+        residual[x] = static_cast<uint8_t>(row[x] - medianPredict(row[x - d], up[x], up[x - d]));
+        if (++phase == comp.period) phase = 0;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Huffman tables
+// ---------------------------------------------------------------------------
+
+inline void buildCodeLengths(const uint32_t counts[256], uint8_t lengths[256]) {
+    std::vector<uint32_t> freq(counts, counts + 256);
+    while (true) {
+        // Standard Huffman over the used symbols
+        struct Node { uint64_t weight; int left, right; };
+        std::vector<Node> nodes;
+        typedef std::pair<uint64_t, int> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        for (int s = 0; s < 256; s++) {
+            if (freq[s]) {
+                nodes.push_back({freq[s], -1, s});
+                heap.push({freq[s], static_cast<int>(nodes.size()) - 1});
+            }
+        }
+        memset(lengths, 0, 256);
+        if (nodes.empty()) return;
+        if (nodes.size() == 1) {
+            lengths[nodes[0].right] = 1;
+            return;
+        }
+        while (heap.size() > 1) {
+            Entry a = heap.top(); heap.pop();
+            Entry b = heap.top(); heap.pop();
+            nodes.push_back({a.first + b.first, a.second, b.second});
+            heap.push({a.first + b.first, static_cast<int>(nodes.size()) - 1});
+        }
+
+        int maxLength = 0;
+        std::vector<std::pair<int, int>> stack = {{heap.top().second, 0}};
+        while (!stack.empty()) {
+            auto [node, depth] = stack.back();
+            stack.pop_back();
+            if (nodes[node].left < 0) {
+                lengths[nodes[node].right] = static_cast<uint8_t>(depth);
+                maxLength = std::max(maxLength, depth);
+            } else {
+                stack.push_back({nodes[node].left, depth + 1});
+                stack.push_back({nodes[node].right, depth + 1});
+            }
+        }
+        if (maxLength <= MAX_CODE_BITS) return;
+        // Flatten the distribution until the tree is shallow enough
+        for (auto& f : freq) {
+            if (f) f = (f + 1) / 2;
+        }
+    }
+}
+
+// Canonical codes, bit-reversed for an LSB-first stream
+inline void buildCodes(const uint8_t lengths[256], uint16_t codes[256]) {
+    uint32_t code = 0;
+    for (int len = 1; len <= MAX_CODE_BITS; len++) {
+        for (int s = 0; s < 256; s++) {
+            if (lengths[s] != len) continue;
+            uint32_t reversed = 0;
+            for (int b = 0; b < len; b++) reversed |= ((code >> b) & 1) << (len - 1 - b);
+            codes[s] = static_cast<uint16_t>(reversed);
+            code++;
+        }
+        code <<= 1;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Stripe coding
+// ---------------------------------------------------------------------------
+
+enum StripeMode : uint8_t {
+    STRIPE_RAW = 0,
+    STRIPE_HUFFMAN = 1,
+};
+
+inline void encodeStripe(const FrameLayout& layout, const uint8_t* src, uint32_t firstRow, uint32_t rows,
+                         std::vector<uint8_t>& out) {
+    const ComponentLayout comp = componentLayout(layout.fourcc);
+    const uint32_t rowBytes = layout.rowBytes();
+    std::vector<uint8_t> residuals(static_cast<size_t>(rowBytes) * rows);
+    uint32_t counts[256] = {};
+    for (uint32_t y = 0; y < rows; y++) {
+        const uint8_t* row = src + static_cast<size_t>(firstRow + y) * layout.bytesperline;
+        const uint8_t* up = y ? row - layout.bytesperline : nullptr;
+        uint8_t* res = &residuals[static_cast<size_t>(y) * rowBytes];
+        predictRow(comp, row, up, res, rowBytes);
+        for (uint32_t x = 0; x < rowBytes; x++) counts[res[x]]++;
+    }
+
+    uint8_t lengths[256];
+    uint16_t codes[256] = {};
+    buildCodeLengths(counts, lengths);
+    buildCodes(lengths, codes);
+    uint64_t totalBits = 0;
+    for (int s = 0; s < 256; s++) totalBits += static_cast<uint64_t>(counts[s]) * lengths[s];
+
+    size_t start = out.size();
+    if (1 + 128 + (totalBits + 7) / 8 + 8 >= residuals.size() + 1) {
+        out.push_back(STRIPE_RAW);
+        for (uint32_t y = 0; y < rows; y++) {
+            const uint8_t* row = src + static_cast<size_t>(firstRow + y) * layout.bytesperline;
+            out.insert(out.end(), row, row + rowBytes);
+        }
+        return;
+    }
+
+    out.resize(start + 1 + 128 + (totalBits + 7) / 8 + 8, 0);
+    uint8_t* p = &out[start];
+    *p++ = STRIPE_HUFFMAN;
+    for (int s = 0; s < 256; s += 2) *p++ = static_cast<uint8_t>(lengths[s] | (lengths[s + 1] << 4));
+
+    uint64_t acc = 0;
+    int bits = 0;
+    for (uint8_t r : residuals) {
+        acc |= static_cast<uint64_t>(codes[r]) << bits;
+        bits += lengths[r];
+        if (bits >= 32) {
+            uint32_t word = static_cast<uint32_t>(acc);
+            memcpy(p, &word, 4);  // little-endian hosts only, like the capture path
+            p += 4;
+            acc >>= 32;
+            bits -= 32;
+        }
+    }
+    while (bits > 0) {
+        *p++ = static_cast<uint8_t>(acc);
+        acc >>= 8;
+        bits -= 8;
+    }
+}
+
+inline bool decodeStripe(const FrameLayout& layout, const uint8_t* data, size_t size, uint32_t firstRow,
+                         uint32_t rows, uint8_t* dst) {
+    const uint32_t rowBytes = layout.rowBytes();
+    if (size < 1) return false;
+    if (data[0] == STRIPE_RAW) {
+        if (size < 1 + static_cast<size_t>(rowBytes) * rows) return false;
+        for (uint32_t y = 0; y < rows; y++) {
+            memcpy(dst + static_cast<size_t>(firstRow + y) * layout.bytesperline, data + 1 + static_cast<size_t>(y) * rowBytes,
+                   rowBytes);
+        }
+        return true;
+    }
+    if (data[0] != STRIPE_HUFFMAN || size < 1 + 128 + 8) return false;
+
+    uint8_t lengths[256];
+    for (int s = 0; s < 256; s += 2) {
+        lengths[s] = data[1 + s / 2] & 15;
+        lengths[s + 1] = data[1 + s / 2] >> 4;
+    }
+    uint16_t codes[256] = {};
+    buildCodes(lengths, codes);
+    // One entry per MAX_CODE_BITS-bit window: symbol in the low byte, length above
+    std::vector<uint16_t> table(1 << MAX_CODE_BITS, 0);
+    for (int s = 0; s < 256; s++) {
+        if (!lengths[s]) continue;
+        for (uint32_t fill = codes[s]; fill < table.size(); fill += 1u << lengths[s]) {
+            table[fill] = static_cast<uint16_t>(s | (lengths[s] << 8));
+        }
+    }
+
+    const ComponentLayout comp = componentLayout(layout.fourcc);
+    const uint8_t* stream = data + 1 + 128;
+    const size_t streamBytes = size - 1 - 128;
+    const uint64_t streamBits = (streamBytes - 8) * 8;
+    uint64_t pos = 0;
+    for (uint32_t y = 0; y < rows; y++) {
+        uint8_t* row = dst + static_cast<size_t>(firstRow + y) * layout.bytesperline;
+        const uint8_t* up = y ? row - layout.bytesperline : nullptr;
+        uint32_t phase = 0;
+        for (uint32_t x = 0; x < rowBytes; x++) {
+            if (pos > streamBits) return false;
+            uint64_t window;
+            memcpy(&window, stream + (pos >> 3), 8);
+            uint16_t entry = table[(window >> (pos & 7)) & ((1u << MAX_CODE_BITS) - 1)];
+            if (!(entry >> 8)) return false;
+            pos += entry >> 8;
+
+            uint32_t d = comp.distance[phase];
+            if (++phase == comp.period) phase = 0;
+            uint8_t pred;
+            if (x >= d) pred = up ? medianPredict(row[x - d], up[x], up[x - d]) : row[x - d];
+            else pred = up ? up[x] : 0;
+            row[x] = static_cast<uint8_t>(pred + (entry & 0xff));
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Frames
+// ---------------------------------------------------------------------------
+
+// Compresses one frame on the calling thread; returns the payload size
+inline size_t encodeFrame(const FrameLayout& layout, const uint8_t* src, std::vector<uint8_t>& out) {
+    const uint32_t stripes = layout.stripeCount();
+    out.clear();
+    out.resize(4 + 4 * static_cast<size_t>(stripes));
+    memcpy(&out[0], &stripes, 4);
+    for (uint32_t i = 0; i < stripes; i++) {
+        size_t before = out.size();
+        uint32_t firstRow = i * STRIPE_ROWS;
+        encodeStripe(layout, src, firstRow, std::min(STRIPE_ROWS, layout.height - firstRow), out);
+        uint32_t stripeBytes = static_cast<uint32_t>(out.size() - before);
+        memcpy(&out[4 + 4 * i], &stripeBytes, 4);
+    }
+    return out.size();
+}
+
+// Decodes a frame into `dst` (layout.bytesperline * height bytes). Stripes
+// are spread over `pool` when given. Returns false on a corrupt payload.
+inline bool decodeFrame(const FrameLayout& layout, const uint8_t* data, size_t size, uint8_t* dst,
+                        ThreadPool* pool = nullptr) {
+    uint32_t stripes;
+    if (size < 4) return false;
+    memcpy(&stripes, data, 4);
+    if (stripes != layout.stripeCount() || size < 4 + 4 * static_cast<size_t>(stripes)) return false;
+
+    std::vector<size_t> offsets(stripes + 1);
+    offsets[0] = 4 + 4 * static_cast<size_t>(stripes);
+    for (uint32_t i = 0; i < stripes; i++) {
+        uint32_t stripeBytes;
+        memcpy(&stripeBytes, data + 4 + 4 * i, 4);
+        offsets[i + 1] = offsets[i] + stripeBytes;
+    }
+    if (offsets[stripes] > size) return false;
+
+    std::vector<char> ok(stripes, 0);
+    auto decodeOne = [&](size_t i) {
+        uint32_t firstRow = static_cast<uint32_t>(i) * STRIPE_ROWS;
+        ok[i] = decodeStripe(layout, data + offsets[i], offsets[i + 1] - offsets[i], firstRow,
+                             std::min(STRIPE_ROWS, layout.height - firstRow), dst);
+    };
+    if (pool) pool->parallelFor(stripes, decodeOne);
+    else for (uint32_t i = 0; i < stripes; i++) decodeOne(i);
+    return std::all_of(ok.begin(), ok.end(), [](char v) { return v != 0; });
+}
+
+} // namespace lossless
+
+#endif // LOSSLESS_CODEC_H
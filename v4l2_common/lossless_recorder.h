@@ -0,0 +1,157 @@
+#ifndef LOSSLESS_RECORDER_H
+#define LOSSLESS_RECORDER_H
+
+// Records frames into an indexed container (video_container.h), compressed
+// with lossless_codec.h on a shared thread pool.
+//
+// write() copies the frame and returns at once. Each frame is compressed by
+// one pool thread, so several frames (and several cameras) compress in
+// parallel. Finished frames are put back in capture order before they are
+// handed to a FrameWriter. If too many frames are still being compressed,
+// write() drops the frame and counts it instead of blocking capture.
+
+#include "frame_writer.h"
+#include "lossless_codec.h"
+#include "thread_pool.h"
+#include "video_container.h"
+
+#include <sys/time.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class LosslessRecorder {
+public:
+    LosslessRecorder(const std::string& path, const lossless::FrameLayout& layout, ThreadPool& pool,
+                     size_t maxPending = 8)
+        : layout(layout), pool(pool), maxPending(maxPending), writer(path) {
+        container::ContainerHeader header;
+        header.fourcc = layout.fourcc;
+        header.width = layout.width;
+        header.height = layout.height;
+        header.bytesperline = layout.rowBytes();  // decoded frames are stored unpadded
+        header.codec = container::CODEC_LOSSLESS;
+        writer.write(&header, sizeof(header));
+        fileOffset = sizeof(header);
+    }
+
+    ~LosslessRecorder() { close(); }
+
+    LosslessRecorder(const LosslessRecorder&) = delete;
+    LosslessRecorder& operator=(const LosslessRecorder&) = delete;
+
+    // Render thread: queues the frame for compression. Returns false (and
+    // counts a drop) if the pool is too far behind.
+    bool write(const void* data, size_t bytes, uint32_t sequence, const struct timeval& timestamp) {
+        if (closed || bytes < static_cast<size_t>(layout.bytesperline) * (layout.height - 1) + layout.rowBytes()) {
+            return false;
+        }
+        if (pending >= maxPending) {
+            stats.framesDropped++;
+            return false;
+        }
+        pending++;
+        auto job = std::make_shared<Job>();
+        job->ticket = nextTicket++;
+        job->record.sequence = sequence;
+        job->record.timestampUs = static_cast<int64_t>(timestamp.tv_sec) * 1000000 + timestamp.tv_usec;
+        job->raw.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + bytes);
+        pool.submit([this, job]() {
+            lossless::encodeFrame(layout, job->raw.data(), job->payload);
+            job->raw.clear();
+            job->raw.shrink_to_fit();
+            finish(job);
+        });
+        return true;
+    }
+
+    // Waits for every queued frame, then writes the index and closes the file
+    void close() {
+        if (closed) return;
+        closed = true;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            drained.wait(lock, [this]() { return pending == 0; });
+        }
+        container::ContainerFooter footer;
+        footer.indexOffset = fileOffset;
+        footer.frameCount = static_cast<uint32_t>(index.size());
+        if (!index.empty()) writer.write(index.data(), index.size() * sizeof(container::IndexEntry));
+        writer.write(&footer, sizeof(footer));
+        writer.close();
+    }
+
+    size_t framesRecorded() const { return index.size(); }
+    uint64_t compressedBytes() const { return fileOffset; }
+
+    // Counters of the underlying file writer plus frames dropped here
+    WriterStats& writerStats() { return writer.stats; }
+
+    struct Stats {
+        std::atomic<uint64_t> framesDropped{0};   // dropped before compression
+        std::atomic<uint64_t> rawBytes{0};        // input bytes of recorded frames
+    } stats;
+
+private:
+    struct Job {
+        uint64_t ticket = 0;
+        container::RecordHeader record;
+        std::vector<uint8_t> raw;
+        std::vector<uint8_t> payload;
+    };
+
+    // Pool thread: writes every frame that is next in capture order
+    void finish(const std::shared_ptr<Job>& job) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done[job->ticket] = job;
+        while (!done.empty() && done.begin()->first == nextToWrite) {
+            std::shared_ptr<Job> next = done.begin()->second;
+            done.erase(done.begin());
+            nextToWrite++;
+            writeRecord(*next);
+            pending--;
+        }
+        if (pending == 0) drained.notify_all();
+    }
+
+    void writeRecord(Job& job) {
+        job.record.payloadBytes = static_cast<uint32_t>(job.payload.size());
+        // One contiguous write so a drop never leaves half a record behind
+        std::vector<uint8_t> bytes(sizeof(job.record) + job.payload.size());
+        memcpy(bytes.data(), &job.record, sizeof(job.record));
+        memcpy(bytes.data() + sizeof(job.record), job.payload.data(), job.payload.size());
+        if (!writer.write(bytes.data(), bytes.size())) return;
+
+        container::IndexEntry e;
+        e.offset = fileOffset + sizeof(job.record);
+        e.payloadBytes = job.record.payloadBytes;
+        e.sequence = job.record.sequence;
+        e.timestampUs = job.record.timestampUs;
+        index.push_back(e);
+        fileOffset += bytes.size();
+        stats.rawBytes += static_cast<uint64_t>(layout.rowBytes()) * layout.height;
+    }
+
+    lossless::FrameLayout layout;
+    ThreadPool& pool;
+    size_t maxPending;
+    FrameWriter writer;
+    bool closed = false;
+
+    std::atomic<size_t> pending{0};
+    uint64_t nextTicket = 0;  // render thread only
+
+    std::mutex mutex;  // guards everything below and the writer after construction
+    std::condition_variable drained;
+    std::map<uint64_t, std::shared_ptr<Job>> done;
+    uint64_t nextToWrite = 0;
+    std::vector<container::IndexEntry> index;
+    uint64_t fileOffset = 0;
+};
+
+#endif // LOSSLESS_RECORDER_H
@@ -0,0 +1,214 @@
+#ifndef MJPEG_DECODER_H
+#define MJPEG_DECODER_H
+
+// Parallel MJPEG decode for captured frames.
+//
+// submit() copies a compressed frame and decodes it on a ThreadPool with
+// stb_image, so up to `depth` frames decode at once. next() returns decoded
+// RGBA frames strictly in sequence order: a frame that finishes early waits
+// until every earlier frame is done (or failed). submit() refuses frames
+// once `depth` are in flight so a slow decoder drops frames instead of
+// queueing latency.
+//
+// Many UVC cameras send MJPEG without Huffman tables (the format assumes the
+// standard ones), which stb_image rejects, so missing tables are inserted
+// before decoding.
+//
+// The including program must define STB_IMAGE_IMPLEMENTATION in exactly
+// one translation unit.
+
+#include "thread_pool.h"
+
+#include <stb_image.h>
+
+#include <sys/time.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct StbiFree {
+    void operator()(uint8_t* pixels) const { stbi_image_free(pixels); }
+};
+
+struct DecodedFrame {
+    uint32_t sequence = 0;
+    struct timeval timestamp{};  // capture time of the compressed frame
+    int width = 0;
+    int height = 0;
+    std::unique_ptr<uint8_t, StbiFree> rgba;  // width * height * 4 bytes
+};
+
+struct MjpegStats {
+    std::atomic<uint64_t> decoded{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> dropped{0};        // refused because the pipeline was full
+    std::atomic<uint64_t> decodeMicros{0};   // total decode time across workers
+
+    void print(const char* label) const {
+        uint64_t n = decoded.load();
+        printf("%s: decoded %llu, errors %llu, dropped %llu, %.2f ms per frame per worker\n", label,
+               static_cast<unsigned long long>(n), static_cast<unsigned long long>(errors.load()),
+               static_cast<unsigned long long>(dropped.load()), n ? decodeMicros.load() / 1000.0 / n : 0.0);
+    }
+};
+
+// Standard Huffman tables from ITU T.81 Annex K.3 as a DHT segment
+const uint8_t STANDARD_DHT[] = {
+    0xff, 0xc4, 0x01, 0xa2,
+    // DC luminance
+    0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+    // DC chrominance
+    0x01, 0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+    // AC luminance
+    0x10, 0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7d,
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+    // AC chrominance
+    0x11, 0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77,
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+// Copies a JPEG, inserting the standard Huffman tables before the first
+// frame header if the stream has no DHT segment of its own
+inline void copyWithHuffmanTables(const uint8_t* jpeg, size_t bytes, std::vector<uint8_t>& out) {
+    size_t insertAt = 0;
+    bool hasDht = false;
+    // Walk the marker segments up to start of scan
+    size_t pos = 2;
+    while (pos + 4 <= bytes && jpeg[pos] == 0xff) {
+        uint8_t marker = jpeg[pos + 1];
+        if (marker == 0xc4) hasDht = true;
+        if ((marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) && !insertAt) {
+            insertAt = pos;
+        }
+        if (marker == 0xda) break;
+        pos += 2 + ((jpeg[pos + 2] << 8) | jpeg[pos + 3]);
+    }
+    if (hasDht || !insertAt) {
+        out.assign(jpeg, jpeg + bytes);
+        return;
+    }
+    out.clear();
+    out.reserve(bytes + sizeof(STANDARD_DHT));
+    out.insert(out.end(), jpeg, jpeg + insertAt);
+    out.insert(out.end(), STANDARD_DHT, STANDARD_DHT + sizeof(STANDARD_DHT));
+    out.insert(out.end(), jpeg + insertAt, jpeg + bytes);
+}
+
+class MjpegDecoder {
+public:
+    MjpegDecoder(ThreadPool& pool, size_t depth) : pool(pool), depth(depth ? depth : 1) {}
+
+    ~MjpegDecoder() {
+        // Tasks reference this object; wait for them before going away
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]() { return inFlight == 0; });
+    }
+
+    MjpegDecoder(const MjpegDecoder&) = delete;
+    MjpegDecoder& operator=(const MjpegDecoder&) = delete;
+
+    // Queues a compressed frame. Returns false (and counts a drop) if
+    // `depth` frames are already decoding or waiting to be taken.
+    bool submit(const void* jpeg, size_t bytes, uint32_t sequence, const struct timeval& timestamp) {
+        auto job = std::make_shared<Job>();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (slots.size() >= depth) {
+                stats.dropped++;
+                return false;
+            }
+            slots[sequence] = job;
+            inFlight++;
+        }
+        copyWithHuffmanTables(static_cast<const uint8_t*>(jpeg), bytes, job->jpeg);
+        job->frame.sequence = sequence;
+        job->frame.timestamp = timestamp;
+        pool.submit([this, job]() { decode(*job); });
+        return true;
+    }
+
+    // Next decoded frame in sequence order, if the oldest one is done.
+    // Frames that failed to decode are skipped.
+    bool next(DecodedFrame& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!slots.empty()) {
+            std::shared_ptr<Job> job = slots.begin()->second;
+            if (!job->done) return false;
+            slots.erase(slots.begin());
+            if (!job->frame.rgba) continue;
+            out = std::move(job->frame);
+            return true;
+        }
+        return false;
+    }
+
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return slots.size();
+    }
+
+    MjpegStats stats;
+
+private:
+    struct Job {
+        std::vector<uint8_t> jpeg;
+        DecodedFrame frame;
+        bool done = false;  // guarded by the decoder mutex
+    };
+
+    void decode(Job& job) {
+        auto start = std::chrono::steady_clock::now();
+        int channels = 0;
+        uint8_t* pixels = stbi_load_from_memory(job.jpeg.data(), static_cast<int>(job.jpeg.size()), &job.frame.width,
+                                                &job.frame.height, &channels, 4);
+        stats.decodeMicros += std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::steady_clock::now() - start).count();
+        if (pixels) stats.decoded++;
+        else stats.errors++;
+        job.jpeg.clear();
+        job.jpeg.shrink_to_fit();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        job.frame.rgba.reset(pixels);
+        job.done = true;
+        if (--inFlight == 0) idle.notify_all();
+    }
+
+    ThreadPool& pool;
+    size_t depth;
+    mutable std::mutex mutex;
+    std::condition_variable idle;
+    std::map<uint32_t, std::shared_ptr<Job>> slots;  // by sequence, decoding or ready
+    size_t inFlight = 0;
+};
+
+#endif // MJPEG_DECODER_H
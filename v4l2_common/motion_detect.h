@@ -0,0 +1,250 @@
+#ifndef MOTION_DETECT_H
+#define MOTION_DETECT_H
+
+// Tile-based change detection between consecutive frames.
+//
+// A frame is split into square tiles (64x64 pixels by default) and each
+// tile's sum of absolute differences against a reference copy is compared
+// with `threshold` times its byte count, i.e. a mean per-byte difference.
+// The SAD of a tile stops as soon as it crosses the threshold, so changed
+// tiles cost little more than their first rows. Only dirty tiles are copied
+// into the reference: it always holds what a consumer that acts on dirty
+// tiles alone has seen, so slow drift still adds up to a dirty tile
+// eventually.
+//
+// The bytes are compared as they are (YUYV, RGB24, RGBA, ...); the per-row
+// SAD kernels are picked at runtime like the pixel converters.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// 64-bit x86 only: the SAD totals are read out with _mm_cvtsi128_si64
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define MOTION_X86 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define MOTION_NEON 1
+#endif
+
+namespace motion {
+
+typedef uint64_t (*SadFn)(const uint8_t* a, const uint8_t* b, size_t bytes);
+
+struct SadKernel {
+    const char* name;
+    SadFn sad;
+};
+
+inline uint64_t sadScalar(const uint8_t* a, const uint8_t* b, size_t bytes) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < bytes; i++) sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    return sum;
+}
+
+#ifdef MOTION_X86
+
+__attribute__((target("sse2")))
+inline uint64_t sadSse2(const uint8_t* a, const uint8_t* b, size_t bytes) {
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(x, y));
+    }
+    uint64_t sum = static_cast<uint64_t>(_mm_cvtsi128_si64(acc)) +
+                   static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc)));
+    return sum + sadScalar(a + i, b + i, bytes - i);
+}
+
+__attribute__((target("avx2")))
+inline uint64_t sadAvx2(const uint8_t* a, const uint8_t* b, size_t bytes) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(x, y));
+    }
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    uint64_t sum = static_cast<uint64_t>(_mm_cvtsi128_si64(half)) +
+                   static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(half, half)));
+    return sum + sadSse2(a + i, b + i, bytes - i);
+}
+
+#endif // MOTION_X86
+
+#ifdef MOTION_NEON
+
+inline uint64_t sadNeon(const uint8_t* a, const uint8_t* b, size_t bytes) {
+    // Each 16-byte step adds at most 510 to a 32-bit lane, so a row of any
+    // realistic width cannot overflow
+    uint32x4_t acc = vdupq_n_u32(0);
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        acc = vpadalq_u16(acc, vpaddlq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i))));
+    }
+    uint64_t sum = static_cast<uint64_t>(vgetq_lane_u32(acc, 0)) + vgetq_lane_u32(acc, 1) + vgetq_lane_u32(acc, 2) +
+                   vgetq_lane_u32(acc, 3);
+    return sum + sadScalar(a + i, b + i, bytes - i);
+}
+
+#endif // MOTION_NEON
+
+inline std::vector<SadKernel> availableSadKernels() {
+    std::vector<SadKernel> list;
+    list.push_back({"scalar", sadScalar});
+#ifdef MOTION_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) list.push_back({"sse2", sadSse2});
+    if (__builtin_cpu_supports("avx2")) list.push_back({"avx2", sadAvx2});
+#endif
+#ifdef MOTION_NEON
+    list.push_back({"neon", sadNeon});
+#endif
+    return list;
+}
+
+// Fastest SAD kernel supported by the running CPU (checked once)
+inline const SadKernel& bestSadKernel() {
+    static const SadKernel best = availableSadKernels().back();
+    return best;
+}
+
+struct MotionStats {
+    uint64_t frames = 0;
+    uint64_t staticFrames = 0;  // frames without a single dirty tile
+    uint64_t tiles = 0;         // tiles compared
+    uint64_t dirtyTiles = 0;
+    double seconds = 0.0;       // spent in detect()
+
+    void print(const char* label) const {
+        printf("%s: %llu frames, %llu unchanged (%.1f%%), %.1f%% of tiles dirty, %.3f ms per frame\n", label,
+               static_cast<unsigned long long>(frames), static_cast<unsigned long long>(staticFrames),
+               frames ? staticFrames * 100.0 / frames : 0.0, tiles ? dirtyTiles * 100.0 / tiles : 0.0,
+               frames ? seconds * 1e3 / frames : 0.0);
+    }
+};
+
+class TileDetector {
+public:
+    // `threshold` is the mean absolute difference per byte above which a
+    // tile counts as changed
+    TileDetector(uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t tileSize = 64,
+                 double threshold = 2.0)
+        : width(width), height(height), bytesPerPixel(bytesPerPixel), tile(tileSize), threshold(threshold),
+          cols((width + tileSize - 1) / tileSize), rowCount((height + tileSize - 1) / tileSize),
+          reference(static_cast<size_t>(width) * bytesPerPixel * height), dirtyTiles(cols * rowCount, 1),
+          kernel(bestSadKernel()) {}
+
+    uint32_t tileSize() const { return tile; }
+    uint32_t columns() const { return cols; }
+    uint32_t rows() const { return rowCount; }
+    const char* kernelName() const { return kernel.name; }
+
+    bool dirty(uint32_t column, uint32_t row) const { return dirtyTiles[row * cols + column] != 0; }
+    size_t dirtyCount() const { return dirtyTotal; }
+    // Fraction of the frame that changed in the last detect(), 0..1
+    double motion() const { return static_cast<double>(dirtyTotal) / dirtyTiles.size(); }
+
+    // Compares a frame (rows `stride` bytes apart) with the reference and
+    // returns the number of dirty tiles. The first frame, and the first
+    // after invalidate(), is dirty everywhere.
+    size_t detect(const uint8_t* frame, size_t stride) {
+        auto start = std::chrono::steady_clock::now();
+        const size_t refStride = static_cast<size_t>(width) * bytesPerPixel;
+        dirtyTotal = 0;
+        for (uint32_t ty = 0; ty < rowCount; ty++) {
+            const uint32_t y0 = ty * tile;
+            const uint32_t tileRows = std::min(tile, height - y0);
+            for (uint32_t tx = 0; tx < cols; tx++) {
+                const size_t x0 = static_cast<size_t>(tx) * tile * bytesPerPixel;
+                const size_t tileBytes = static_cast<size_t>(std::min(tile, width - tx * tile)) * bytesPerPixel;
+                bool changed = !haveReference;
+                if (!changed) {
+                    const uint64_t limit = static_cast<uint64_t>(threshold * tileBytes * tileRows);
+                    uint64_t sum = 0;
+                    for (uint32_t y = y0; y < y0 + tileRows && !changed; y++) {
+                        sum += kernel.sad(frame + y * stride + x0, reference.data() + y * refStride + x0, tileBytes);
+                        changed = sum > limit;
+                    }
+                }
+                dirtyTiles[ty * cols + tx] = changed;
+                if (!changed) continue;
+                dirtyTotal++;
+                for (uint32_t y = y0; y < y0 + tileRows; y++) {
+                    memcpy(reference.data() + y * refStride + x0, frame + y * stride + x0, tileBytes);
+                }
+            }
+        }
+        haveReference = true;
+
+        stats.frames++;
+        stats.tiles += dirtyTiles.size();
+        stats.dirtyTiles += dirtyTotal;
+        if (dirtyTotal == 0) stats.staticFrames++;
+        stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return dirtyTotal;
+    }
+
+    // Marks every tile dirty for a frame that could not be compared, and
+    // makes the next detect() treat its frame as new too. Returns the tile count.
+    size_t invalidate() {
+        std::fill(dirtyTiles.begin(), dirtyTiles.end(), 1);
+        dirtyTotal = dirtyTiles.size();
+        haveReference = false;
+        stats.frames++;
+        stats.tiles += dirtyTiles.size();
+        stats.dirtyTiles += dirtyTotal;
+        return dirtyTotal;
+    }
+
+    // Calls fn(x, y, width, height) in pixels for each horizontal run of
+    // dirty tiles from the last detect(), clipped to the frame
+    template <typename Fn>
+    void forEachDirtyRun(Fn fn) const {
+        for (uint32_t ty = 0; ty < rowCount; ty++) {
+            const uint32_t y0 = ty * tile;
+            const uint32_t tileRows = std::min(tile, height - y0);
+            uint32_t tx = 0;
+            while (tx < cols) {
+                if (!dirtyTiles[ty * cols + tx]) {
+                    tx++;
+                    continue;
+                }
+                uint32_t end = tx + 1;
+                while (end < cols && dirtyTiles[ty * cols + end]) end++;
+                fn(tx * tile, y0, std::min(end * tile, width) - tx * tile, tileRows);
+                tx = end;
+            }
+        }
+    }
+
+    MotionStats stats;
+
+private:
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerPixel;
+    uint32_t tile;
+    double threshold;
+    uint32_t cols;
+    uint32_t rowCount;
+    std::vector<uint8_t> reference;   // packed rows, width * bytesPerPixel each
+    std::vector<uint8_t> dirtyTiles;  // row-major, one flag per tile
+    size_t dirtyTotal = 0;
+    bool haveReference = false;
+    SadKernel kernel;
+};
+
+} // namespace motion
+
+#endif // MOTION_DETECT_H
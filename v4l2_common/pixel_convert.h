@@ -0,0 +1,305 @@
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+// Pixel-format conversion kernels for captured V4L2 frames.
+//
+// Every kernel converts one row of `pixels` pixels. The scalar versions are
+// the reference; the SIMD versions must produce bit-identical output and are
+// picked at runtime with bestPixelConverter().
+//
+// YUYV is decoded as BT.601 limited range with 6-bit fixed point
+// coefficients so that the 16-bit SIMD lanes never overflow before clamping.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXCONV_X86 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define PIXCONV_NEON 1
+#endif
+
+namespace pixconv {
+
+typedef void (*RowFn)(const uint8_t* src, uint8_t* dst, size_t pixels);
+
+struct PixelConverter {
+    const char* name;
+    RowFn rgb24ToRgba;   // R G B -> R G B 255
+    RowFn bgr24ToBgra;   // B G R -> B G R 255
+    RowFn yuyvToRgba;    // Y0 U Y1 V -> 2x R G B 255
+};
+
+// ---------------------------------------------------------------------------
+// Scalar reference
+// ---------------------------------------------------------------------------
+
+inline uint8_t clampByte(int v) {
+    return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// 16-bit saturating add, mirrors _mm_adds_epi16 / vqaddq_s16
+inline int addSat16(int a, int b) {
+    int v = a + b;
+    return v < -32768 ? -32768 : (v > 32767 ? 32767 : v);
+}
+
+inline void yuvToRgb(int y, int u, int v, uint8_t* out) {
+    int c = 75 * (y - 16);
+    int d = u - 128;
+    int e = v - 128;
+    out[0] = clampByte(addSat16(addSat16(c, 102 * e), 32) >> 6);
+    out[1] = clampByte(addSat16(addSat16(c, -25 * d - 52 * e), 32) >> 6);
+    out[2] = clampByte(addSat16(addSat16(c, 129 * d), 32) >> 6);
+    out[3] = 255;
+}
+
+inline void expand24to32Scalar(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        dst[i * 4 + 0] = src[i * 3 + 0];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = 255;
+    }
+}
+
+// YUYV rows always hold an even number of pixels
+inline void yuyvToRgbaScalar(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    for (size_t i = 0; i + 1 < pixels; i += 2) {
+        const uint8_t* p = src + i * 2;
+        yuvToRgb(p[0], p[1], p[3], dst + i * 4);
+        yuvToRgb(p[2], p[1], p[3], dst + i * 4 + 4);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// x86: SSSE3 / AVX2
+// ---------------------------------------------------------------------------
+
+#ifdef PIXCONV_X86
+
+__attribute__((target("ssse3")))
+inline void expand24to32Ssse3(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        const uint8_t* s = src + i * 3;
+        __m128i* d = reinterpret_cast<__m128i*>(dst + i * 4);
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+        _mm_storeu_si128(d + 0, _mm_or_si128(_mm_shuffle_epi8(a, mask), alpha));
+        _mm_storeu_si128(d + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), mask), alpha));
+        _mm_storeu_si128(d + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), mask), alpha));
+        _mm_storeu_si128(d + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), mask), alpha));
+    }
+    expand24to32Scalar(src + i * 3, dst + i * 4, pixels - i);
+}
+
+// Converts 8 YUYV pixels (16 bytes) to 8 RGBA pixels (32 bytes)
+__attribute__((target("ssse3")))
+inline void yuyv8Ssse3(const uint8_t* src, uint8_t* dst) {
+    const __m128i lowByte = _mm_set1_epi16(0x00FF);
+    const __m128i dupU = _mm_setr_epi8(0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13);
+    const __m128i dupV = _mm_setr_epi8(2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15);
+    const __m128i round = _mm_set1_epi16(32);
+
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i y = _mm_and_si128(in, lowByte);
+    __m128i uv = _mm_srli_epi16(in, 8);
+    __m128i c = _mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), _mm_set1_epi16(75));
+    __m128i d = _mm_sub_epi16(_mm_shuffle_epi8(uv, dupU), _mm_set1_epi16(128));
+    __m128i e = _mm_sub_epi16(_mm_shuffle_epi8(uv, dupV), _mm_set1_epi16(128));
+
+    __m128i r = _mm_adds_epi16(_mm_adds_epi16(c, _mm_mullo_epi16(e, _mm_set1_epi16(102))), round);
+    __m128i g = _mm_adds_epi16(_mm_adds_epi16(c, _mm_add_epi16(_mm_mullo_epi16(d, _mm_set1_epi16(-25)),
+                                                              _mm_mullo_epi16(e, _mm_set1_epi16(-52)))), round);
+    __m128i b = _mm_adds_epi16(_mm_adds_epi16(c, _mm_mullo_epi16(d, _mm_set1_epi16(129))), round);
+    r = _mm_srai_epi16(r, 6);
+    g = _mm_srai_epi16(g, 6);
+    b = _mm_srai_epi16(b, 6);
+
+    __m128i rb = _mm_packus_epi16(r, b);                       // R0..7 B0..7
+    __m128i ga = _mm_packus_epi16(g, _mm_set1_epi16(255));     // G0..7 A0..7
+    __m128i rg = _mm_unpacklo_epi8(rb, ga);                    // R G R G ...
+    __m128i ba = _mm_unpackhi_epi8(rb, ga);                    // B A B A ...
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(rg, ba));
+}
+
+__attribute__((target("ssse3")))
+inline void yuyvToRgbaSsse3(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        yuyv8Ssse3(src + i * 2, dst + i * 4);
+    }
+    yuyvToRgbaScalar(src + i * 2, dst + i * 4, pixels - i);
+}
+
+__attribute__((target("avx2")))
+inline void expand24to32Avx2(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    // Each 128-bit lane takes 4 pixels (12 of its 16 loaded bytes)
+    const __m256i mask = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                          0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    size_t i = 0;
+    // The last load of an iteration reads 4 bytes past the 16 pixels it converts
+    for (; i + 18 <= pixels; i += 16) {
+        const uint8_t* s = src + i * 3;
+        __m256i lo = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 12)), 1);
+        __m256i hi = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 24))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 36)), 1);
+        __m256i* d = reinterpret_cast<__m256i*>(dst + i * 4);
+        _mm256_storeu_si256(d + 0, _mm256_or_si256(_mm256_shuffle_epi8(lo, mask), alpha));
+        _mm256_storeu_si256(d + 1, _mm256_or_si256(_mm256_shuffle_epi8(hi, mask), alpha));
+    }
+    expand24to32Ssse3(src + i * 3, dst + i * 4, pixels - i);
+}
+
+__attribute__((target("avx2")))
+inline void yuyvToRgbaAvx2(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    const __m256i lowByte = _mm256_set1_epi16(0x00FF);
+    const __m256i dupU = _mm256_setr_epi8(0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13,
+                                          0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13);
+    const __m256i dupV = _mm256_setr_epi8(2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15,
+                                          2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15);
+    const __m256i round = _mm256_set1_epi16(32);
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 2));
+        __m256i y = _mm256_and_si256(in, lowByte);
+        __m256i uv = _mm256_srli_epi16(in, 8);
+        __m256i c = _mm256_mullo_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(16)), _mm256_set1_epi16(75));
+        __m256i d = _mm256_sub_epi16(_mm256_shuffle_epi8(uv, dupU), _mm256_set1_epi16(128));
+        __m256i e = _mm256_sub_epi16(_mm256_shuffle_epi8(uv, dupV), _mm256_set1_epi16(128));
+
+        __m256i r = _mm256_adds_epi16(_mm256_adds_epi16(c, _mm256_mullo_epi16(e, _mm256_set1_epi16(102))), round);
+        __m256i g = _mm256_adds_epi16(_mm256_adds_epi16(c, _mm256_add_epi16(_mm256_mullo_epi16(d, _mm256_set1_epi16(-25)),
+                                                                           _mm256_mullo_epi16(e, _mm256_set1_epi16(-52)))), round);
+        __m256i b = _mm256_adds_epi16(_mm256_adds_epi16(c, _mm256_mullo_epi16(d, _mm256_set1_epi16(129))), round);
+        r = _mm256_srai_epi16(r, 6);
+        g = _mm256_srai_epi16(g, 6);
+        b = _mm256_srai_epi16(b, 6);
+
+        // All packs/unpacks stay within 128-bit lanes: lane 0 holds pixels 0-7, lane 1 pixels 8-15
+        __m256i rb = _mm256_packus_epi16(r, b);
+        __m256i ga = _mm256_packus_epi16(g, _mm256_set1_epi16(255));
+        __m256i rg = _mm256_unpacklo_epi8(rb, ga);
+        __m256i ba = _mm256_unpackhi_epi8(rb, ga);
+        __m256i lo = _mm256_unpacklo_epi16(rg, ba);   // pixels 0-3 | 8-11
+        __m256i hi = _mm256_unpackhi_epi16(rg, ba);   // pixels 4-7 | 12-15
+        __m256i* out = reinterpret_cast<__m256i*>(dst + i * 4);
+        _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    yuyvToRgbaSsse3(src + i * 2, dst + i * 4, pixels - i);
+}
+
+#endif // PIXCONV_X86
+
+// ---------------------------------------------------------------------------
+// ARM: NEON
+// ---------------------------------------------------------------------------
+
+#ifdef PIXCONV_NEON
+
+inline void expand24to32Neon(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+        uint8x16x4_t rgba;
+        rgba.val[0] = rgb.val[0];
+        rgba.val[1] = rgb.val[1];
+        rgba.val[2] = rgb.val[2];
+        rgba.val[3] = vdupq_n_u8(255);
+        vst4q_u8(dst + i * 4, rgba);
+    }
+    expand24to32Scalar(src + i * 3, dst + i * 4, pixels - i);
+}
+
+// Returns clamp((c + chroma + 32) >> 6) with the same saturation as the reference
+inline uint8x8_t neonChannel(int16x8_t c, int16x8_t chroma) {
+    return vqshrun_n_s16(vqaddq_s16(vqaddq_s16(c, chroma), vdupq_n_s16(32)), 6);
+}
+
+inline void yuyvToRgbaNeon(const uint8_t* src, uint8_t* dst, size_t pixels) {
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x8x4_t in = vld4_u8(src + i * 2);   // Y0 U Y1 V for 8 pixel pairs
+        int16x8_t d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(in.val[1])), vdupq_n_s16(128));
+        int16x8_t e = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(in.val[3])), vdupq_n_s16(128));
+        int16x8_t cr = vmulq_n_s16(e, 102);
+        int16x8_t cg = vaddq_s16(vmulq_n_s16(d, -25), vmulq_n_s16(e, -52));
+        int16x8_t cb = vmulq_n_s16(d, 129);
+
+        uint8x8_t rgb[2][3];
+        for (int k = 0; k < 2; k++) {
+            int16x8_t y = vreinterpretq_s16_u16(vmovl_u8(in.val[k * 2]));
+            int16x8_t c = vmulq_n_s16(vsubq_s16(y, vdupq_n_s16(16)), 75);
+            rgb[k][0] = neonChannel(c, cr);
+            rgb[k][1] = neonChannel(c, cg);
+            rgb[k][2] = neonChannel(c, cb);
+        }
+
+        uint8x16x4_t out;
+        for (int ch = 0; ch < 3; ch++) {
+            uint8x8x2_t z = vzip_u8(rgb[0][ch], rgb[1][ch]);
+            out.val[ch] = vcombine_u8(z.val[0], z.val[1]);
+        }
+        out.val[3] = vdupq_n_u8(255);
+        vst4q_u8(dst + i * 4, out);
+    }
+    yuyvToRgbaScalar(src + i * 2, dst + i * 4, pixels - i);
+}
+
+#endif // PIXCONV_NEON
+
+// ---------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------
+
+// RGB24->RGBA and BGR24->BGRA are the same byte shuffle, so they share kernels.
+inline std::vector<PixelConverter> availablePixelConverters() {
+    std::vector<PixelConverter> list;
+    list.push_back({"scalar", expand24to32Scalar, expand24to32Scalar, yuyvToRgbaScalar});
+#ifdef PIXCONV_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        list.push_back({"ssse3", expand24to32Ssse3, expand24to32Ssse3, yuyvToRgbaSsse3});
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        list.push_back({"avx2", expand24to32Avx2, expand24to32Avx2, yuyvToRgbaAvx2});
+    }
+#endif
+#ifdef PIXCONV_NEON
+    list.push_back({"neon", expand24to32Neon, expand24to32Neon, yuyvToRgbaNeon});
+#endif
+    return list;
+}
+
+// Fastest converter supported by the running CPU (checked once)
+inline const PixelConverter& bestPixelConverter() {
+    static const PixelConverter best = availablePixelConverters().back();
+    return best;
+}
+
+// Converts a whole frame row by row, honouring V4L2's bytesperline padding
+inline void convertFrame(RowFn fn, const uint8_t* src, size_t srcStride,
+                         uint8_t* dst, size_t dstStride, size_t width, size_t height) {
+    for (size_t y = 0; y < height; y++) {
+        fn(src + y * srcStride, dst + y * dstStride, width);
+    }
+}
+
+} // namespace pixconv
+
+#endif // PIXEL_CONVERT_H
@@ -0,0 +1,213 @@
+#ifndef PLAYBACK_FILE_H
+#define PLAYBACK_FILE_H
+
+// Random access to a recording for the player.
+//
+// Raw recordings (capture.yuv, segments, event clips) are fixed-size frames
+// back to back, so frame i sits at i * frameBytes and the index is implicit.
+// .v4lz containers carry their own index, which ContainerReader rebuilds if
+// the recording was cut off. Either way the file is mapped and nothing is
+// paged in up front, so opening a multi-GB recording costs nothing.
+//
+// The mapping is MADV_RANDOM: the kernel's own readahead only guesses
+// forwards and wastes I/O when playing backwards or scrubbing. Instead
+// fetch() asks for the frames coming up in the direction of play with
+// MADV_WILLNEED, which starts their reads in the background, twice the
+// window at a time so the madvise() is rare. The wanted frame itself is
+// faulted in by touching one byte per page, timed, so the stats show what
+// the disk costs the player.
+
+#include "video_container.h"
+#include "lossless_codec.h"
+
+#include <linux/videodev2.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct PlaybackStats {
+    uint64_t frames = 0;       // fetched
+    uint64_t bytes = 0;        // of the file, as stored
+    uint64_t majorFaults = 0;  // pages that had to come from the disk
+    uint64_t advises = 0;      // MADV_WILLNEED calls
+    double seconds = 0.0;      // in fetch(), decode included
+    double maxSeconds = 0.0;
+
+    void print(const char* label, double elapsed) const {
+        printf("%s: %llu frames fetched, %.3f ms per fetch (max %.3f ms), %.1f MB/s sustained, %llu major faults, "
+               "%llu readahead hints\n",
+               label, static_cast<unsigned long long>(frames), frames ? seconds * 1e3 / frames : 0.0,
+               maxSeconds * 1e3, elapsed > 0 ? bytes / elapsed / 1e6 : 0.0,
+               static_cast<unsigned long long>(majorFaults), static_cast<unsigned long long>(advises));
+    }
+};
+
+class PlaybackFile {
+public:
+    // Raw files are described by `fourcc` and the size (unpadded rows);
+    // files starting with a container header describe themselves. Lossless
+    // payloads are decoded on `pool` when given.
+    PlaybackFile(const std::string& path, uint32_t fourcc, uint32_t width, uint32_t height,
+                 ThreadPool* pool = nullptr)
+        : pool(pool) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Failed to open " + path + ": " + strerror(errno));
+        char magic[4] = {};
+        bool isContainer = pread(fd, magic, sizeof(magic), 0) == sizeof(magic) && memcmp(magic, "V4LZ", 4) == 0;
+
+        if (isContainer) {
+            close(fd);
+            container.reset(new container::ContainerReader(path));
+            const container::ContainerHeader& info = container->info();
+            layout.fourcc = info.fourcc;
+            layout.width = info.width;
+            layout.height = info.height;
+            layout.bytesperline = info.bytesperline;
+            // Rows are decoded and copied at bytesperline; a shorter stride would overrun the frame
+            if (!layout.width || !layout.height || layout.bytesperline < layout.rowBytes()) {
+                throw std::runtime_error(path + " has an invalid frame size in its header");
+            }
+            base = container->data();
+            mappedBytes = container->fileSize();
+            frameCount = container->frameCount();
+            if (info.codec == container::CODEC_LOSSLESS) {
+                decoded.resize(static_cast<size_t>(layout.bytesperline) * layout.height);
+            }
+        } else {
+            layout.fourcc = fourcc;
+            layout.width = width;
+            layout.height = height;
+            layout.bytesperline = fourcc == V4L2_PIX_FMT_YUYV  ? width * 2
+                                : fourcc == V4L2_PIX_FMT_RGB24 ? width * 3
+                                                               : width;
+            size_t pixels = static_cast<size_t>(width) * height;
+            frameBytes = fourcc == V4L2_PIX_FMT_YUYV  ? pixels * 2
+                       : fourcc == V4L2_PIX_FMT_RGB24 ? pixels * 3
+                       : fourcc == V4L2_PIX_FMT_NV12 || fourcc == V4L2_PIX_FMT_YUV420 ||
+                               fourcc == V4L2_PIX_FMT_YVU420
+                           ? pixels * 3 / 2
+                           : 0;
+            struct stat st{};
+            fstat(fd, &st);
+            mappedBytes = static_cast<size_t>(st.st_size);
+            frameCount = frameBytes ? mappedBytes / frameBytes : 0;
+            if (frameCount == 0) {
+                close(fd);
+                throw std::runtime_error(path + " holds no complete frame of the given format and size");
+            }
+            void* mapped = mmap(nullptr, mappedBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapped == MAP_FAILED) throw std::runtime_error("Failed to map " + path);
+            base = static_cast<const uint8_t*>(mapped);
+        }
+        if (frameCount == 0) throw std::runtime_error(path + " holds no frames");
+        madvise(const_cast<uint8_t*>(base), mappedBytes, MADV_RANDOM);
+    }
+
+    ~PlaybackFile() {
+        if (!container) munmap(const_cast<uint8_t*>(base), mappedBytes);
+    }
+
+    PlaybackFile(const PlaybackFile&) = delete;
+    PlaybackFile& operator=(const PlaybackFile&) = delete;
+
+    bool indexed() const { return container != nullptr; }
+    uint32_t fourcc() const { return layout.fourcc; }
+    uint32_t width() const { return layout.width; }
+    uint32_t height() const { return layout.height; }
+    uint32_t bytesperline() const { return layout.bytesperline; }
+    size_t frames() const { return frameCount; }
+    size_t fileBytes() const { return mappedBytes; }
+
+    // Capture time of a frame in microseconds, or 0 for raw files
+    int64_t timestampUs(size_t frame) const { return container ? container->entry(frame).timestampUs : 0; }
+
+    // Pages in `frame` and returns its pixels (bytesperline() * height() for
+    // packed formats), valid until the next fetch(). `readahead` frames past
+    // it in `direction` (+1 or -1) are hinted to the kernel. Null if a
+    // lossless payload is corrupt.
+    const uint8_t* fetch(size_t frame, int direction, size_t readahead) {
+        auto start = std::chrono::steady_clock::now();
+        struct rusage before{};
+        getrusage(RUSAGE_THREAD, &before);
+
+        hint(frame, direction, std::max<size_t>(readahead, 1));
+        const uint8_t* data = base + offset(frame);
+        const size_t bytes = size(frame);
+        // One read per page faults the frame in here, where it is timed
+        uint8_t sum = 0;
+        for (size_t i = 0; i < bytes; i += PAGE) sum ^= data[i];
+        touched ^= sum ^ data[bytes - 1];
+
+        const uint8_t* pixels = data;
+        if (!decoded.empty()) {
+            pixels = lossless::decodeFrame(layout, data, bytes, decoded.data(), pool) ? decoded.data() : nullptr;
+        }
+
+        struct rusage after{};
+        getrusage(RUSAGE_THREAD, &after);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.frames++;
+        stats.bytes += bytes;
+        stats.majorFaults += after.ru_majflt - before.ru_majflt;
+        stats.seconds += seconds;
+        stats.maxSeconds = std::max(stats.maxSeconds, seconds);
+        return pixels;
+    }
+
+    PlaybackStats stats;
+
+private:
+    static constexpr size_t PAGE = 4096;
+
+    size_t offset(size_t frame) const { return container ? container->entry(frame).offset : frame * frameBytes; }
+    size_t size(size_t frame) const { return container ? container->entry(frame).payloadBytes : frameBytes; }
+
+    // Hints frames [lo, hi) unless the last hint already covers the window
+    void hint(size_t frame, int direction, size_t readahead) {
+        size_t lo, hi;
+        if (direction >= 0) {
+            lo = frame + 1;
+            hi = std::min(frameCount, frame + 1 + readahead);
+            if (lo >= hi || (lo >= hintedLo && hi <= hintedHi)) return;
+            hi = std::min(frameCount, frame + 1 + 2 * readahead);
+        } else {
+            lo = frame > readahead ? frame - readahead : 0;
+            hi = frame;
+            if (lo >= hi || (lo >= hintedLo && hi <= hintedHi)) return;
+            lo = frame > 2 * readahead ? frame - 2 * readahead : 0;
+        }
+        const size_t begin = offset(lo) & ~(PAGE - 1);
+        const size_t end = offset(hi - 1) + size(hi - 1);
+        madvise(const_cast<uint8_t*>(base) + begin, end - begin, MADV_WILLNEED);
+        hintedLo = lo;
+        hintedHi = hi;
+        stats.advises++;
+    }
+
+    std::unique_ptr<container::ContainerReader> container;
+    ThreadPool* pool;
+    lossless::FrameLayout layout;
+    const uint8_t* base = nullptr;
+    size_t mappedBytes = 0;
+    size_t frameBytes = 0;  // raw files
+    size_t frameCount = 0;
+    std::vector<uint8_t> decoded;  // lossless containers
+    size_t hintedLo = 0;
+    size_t hintedHi = 0;
+    uint8_t touched = 0;
+};
+
+#endif // PLAYBACK_FILE_H
@@ -0,0 +1,179 @@
+#ifndef REPLAY_SOURCE_H
+#define REPLAY_SOURCE_H
+
+// Capture source that replays a raw recording (e.g. capture.yuv or an RGB24
+// dump) instead of a camera, so the viewers can be benchmarked without one.
+//
+// The file is mapped and paged in up front. Each dequeue() copies the next
+// frame into one of `bufferCount` slots the way a driver DMAs into a capture
+// buffer, so consumers hold and release replayed frames exactly like V4L2
+// ones. Frames are timestamped with CLOCK_MONOTONIC on dequeue.
+//
+// With fps > 0 a timerfd paces the stream. Ticks that pass while every slot
+// is taken are skipped in the file and show up as sequence gaps, the same as
+// frames a real driver drops. With fps == 0 frames are produced as fast as
+// the consumer returns slots. At the end of the file the source either
+// wraps around or fails with -ENODATA, which CaptureLoop reports as end of
+// stream.
+
+#include "capture_source.h"
+
+#include <linux/videodev2.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class ReplaySource : public CaptureSource {
+public:
+    // Size of one frame of `fourcc` at width x height as the viewers store
+    // it (unpadded rows); 0 for formats that cannot be replayed
+    static size_t frameBytes(uint32_t fourcc, uint32_t width, uint32_t height) {
+        size_t pixels = static_cast<size_t>(width) * height;
+        switch (fourcc) {
+        case V4L2_PIX_FMT_YUYV: return pixels * 2;
+        case V4L2_PIX_FMT_RGB24: return pixels * 3;
+        case V4L2_PIX_FMT_NV12:
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_YVU420: return pixels * 3 / 2;
+        default: return 0;
+        }
+    }
+
+    ReplaySource(const std::string& path, size_t frameBytes, double fps, bool loop, uint32_t bufferCount = 4)
+        : label(path), bytesPerFrame(frameBytes), loop(loop), paced(fps > 0) {
+        if (frameBytes == 0) throw std::runtime_error("Replay needs a fixed-size frame format");
+        int file = open(path.c_str(), O_RDONLY);
+        if (file < 0) throw std::runtime_error("Failed to open " + path + ": " + strerror(errno));
+        struct stat st{};
+        fstat(file, &st);
+        fileSize = static_cast<size_t>(st.st_size);
+        frameCount = fileSize / frameBytes;
+        if (frameCount == 0) {
+            close(file);
+            throw std::runtime_error(path + " holds no complete frame");
+        }
+        // Populate now so page faults never show up in the measurements
+        void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, file, 0);
+        close(file);
+        if (mapped == MAP_FAILED) throw std::runtime_error("Failed to map " + path);
+        data = static_cast<const uint8_t*>(mapped);
+
+        slotLength = (frameBytes + 4095) & ~size_t(4095);
+        for (uint32_t i = 0; i < bufferCount; i++) {
+            void* slot = aligned_alloc(4096, slotLength);
+            if (!slot) {
+                releaseSetup();
+                throw std::runtime_error("Out of memory for replay buffers");
+            }
+            slots.push_back(static_cast<uint8_t*>(slot));
+            freeSlots.push_back(bufferCount - 1 - i);
+        }
+
+        if (paced) {
+            fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            long long periodNs = static_cast<long long>(1e9 / fps);
+            struct itimerspec spec{};
+            spec.it_interval.tv_sec = periodNs / 1000000000;
+            spec.it_interval.tv_nsec = periodNs % 1000000000;
+            spec.it_value = spec.it_interval;
+            if (fd >= 0) timerfd_settime(fd, 0, &spec, nullptr);
+        } else {
+            // Never drained, so the fd stays readable and the loop pulls
+            // frames whenever it has a free slot
+            fd = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+        }
+        if (fd < 0) {
+            releaseSetup();
+            throw std::runtime_error("Failed to create replay timer");
+        }
+    }
+
+    ~ReplaySource() override {
+        close(fd);
+        releaseSetup();
+    }
+
+    ReplaySource(const ReplaySource&) = delete;
+    ReplaySource& operator=(const ReplaySource&) = delete;
+
+    const char* name() const override { return label.c_str(); }
+    int pollFd() const override { return fd; }
+    uint32_t bufferCount() const override { return static_cast<uint32_t>(slots.size()); }
+
+    // Replay buffers stand in for mapped capture buffers
+    void* buffer(uint32_t index) const { return slots[index]; }
+    size_t bufferLength() const { return slotLength; }
+    size_t frames() const { return frameCount; }
+
+    int dequeue(CapturedFrame& frame) override {
+        if (freeSlots.empty()) return 0;
+        uint64_t ticks = 1;
+        if (paced) {
+            if (read(fd, &ticks, sizeof(ticks)) != static_cast<ssize_t>(sizeof(ticks))) {
+                return errno == EAGAIN ? 0 : -errno;
+            }
+            // Only the newest due frame is delivered
+            position += ticks - 1;
+            sequence += static_cast<uint32_t>(ticks - 1);
+        }
+        if (position >= frameCount) {
+            if (!loop) return -ENODATA;
+            position %= frameCount;
+        }
+
+        uint32_t index = freeSlots.back();
+        freeSlots.pop_back();
+        memcpy(slots[index], data + position * bytesPerFrame, bytesPerFrame);
+        position++;
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        frame.index = index;
+        frame.bytesused = static_cast<uint32_t>(bytesPerFrame);
+        frame.sequence = sequence++;
+        frame.timestamp.tv_sec = now.tv_sec;
+        frame.timestamp.tv_usec = now.tv_nsec / 1000;
+        return 1;
+    }
+
+    bool requeue(uint32_t index) override {
+        if (index >= slots.size()) return false;
+        freeSlots.push_back(index);
+        return true;
+    }
+
+private:
+    // Also what a throwing constructor has to undo, as the destructor never runs
+    void releaseSetup() {
+        for (uint8_t* slot : slots) free(slot);
+        munmap(const_cast<uint8_t*>(data), fileSize);
+    }
+
+    std::string label;
+    size_t bytesPerFrame;
+    bool loop;
+    bool paced;
+    int fd = -1;
+    const uint8_t* data = nullptr;
+    size_t fileSize = 0;
+    size_t frameCount = 0;
+    size_t position = 0;   // next frame in the file
+    uint32_t sequence = 0;
+    std::vector<uint8_t*> slots;
+    size_t slotLength = 0;
+    std::vector<uint32_t> freeSlots;  // loop thread only
+};
+
+#endif // REPLAY_SOURCE_H
@@ -0,0 +1,158 @@
+#ifndef SEGMENTED_WRITER_H
+#define SEGMENTED_WRITER_H
+
+// Raw recording split into segment files by size and/or age.
+//
+// Each segment is a FrameWriter of its own (and so has its own writer
+// thread): capture-0000.yuv, capture-0001.yuv, ... With both limits at 0
+// there is a single file named stem + extension, exactly as a plain
+// FrameWriter would write it. A frame never straddles two segments: the
+// writer rolls over before a frame that would push the segment past
+// maxBytes, or before the first frame once the segment is maxSeconds old.
+//
+// A finished segment is flushed and closed on a background thread, so the
+// thread calling write() never waits for the disk.
+
+#include "frame_writer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+class SegmentedWriter {
+public:
+    SegmentedWriter(const std::string& stem, const std::string& extension, uint64_t maxBytes = 0,
+                    double maxSeconds = 0.0)
+        : stem(stem), extension(extension), maxBytes(maxBytes), maxSeconds(maxSeconds),
+          start(std::chrono::steady_clock::now()) {
+        openSegment();
+    }
+
+    ~SegmentedWriter() { close(); }
+
+    SegmentedWriter(const SegmentedWriter&) = delete;
+    SegmentedWriter& operator=(const SegmentedWriter&) = delete;
+
+    bool segmented() const { return maxBytes > 0 || maxSeconds > 0; }
+    bool usingIoUring() const { return current->usingIoUring(); }
+    bool usingDirectIo() const { return current->usingDirectIo(); }
+    const std::string& path() const { return currentPath; }
+    size_t segments() const { return segmentCount; }
+
+    // Queues a copy of the frame, starting a new segment first if this one is
+    // full or old enough. False (and counted as a drop) if it did not fit.
+    bool write(const void* data, size_t bytes) {
+        if (!current) return false;
+        if (segmentBytes > 0 && ((maxBytes && segmentBytes + bytes > maxBytes) ||
+                                 (maxSeconds > 0 && std::chrono::duration<double>(
+                                                        std::chrono::steady_clock::now() - segmentStart)
+                                                            .count() >= maxSeconds))) {
+            retireSegment();
+            openSegment();
+        }
+        if (!current->write(data, bytes)) return false;
+        segmentBytes += bytes;
+        return true;
+    }
+
+    void close() {
+        if (current) retireSegment();
+        if (closer.joinable()) closer.join();
+        if (!closedAt) closedAt = secondsSinceStart();
+    }
+
+    // Totals over every segment so far, the open one included
+    uint64_t bytesWritten() const { return retired.bytesWritten + (current ? current->stats.bytesWritten.load() : 0); }
+    uint64_t framesQueued() const { return retired.framesQueued + (current ? current->stats.framesQueued.load() : 0); }
+    uint64_t framesDropped() const {
+        return retired.framesDropped + (current ? current->stats.framesDropped.load() : 0);
+    }
+    uint64_t writeErrors() const { return retired.writeErrors + (current ? current->stats.writeErrors.load() : 0); }
+
+    void print(const char* label) const {
+        double seconds = closedAt ? closedAt : secondsSinceStart();
+        printf("%s: %zu segment%s, queued %llu, dropped %llu, wrote %.1f MB, errors %llu, %.1f MB/s sustained\n",
+               label, segmentCount, segmentCount == 1 ? "" : "s", static_cast<unsigned long long>(framesQueued()),
+               static_cast<unsigned long long>(framesDropped()), bytesWritten() / 1e6,
+               static_cast<unsigned long long>(writeErrors()), seconds > 0 ? bytesWritten() / seconds / 1e6 : 0.0);
+    }
+
+private:
+    struct Totals {
+        std::atomic<uint64_t> bytesWritten{0};
+        std::atomic<uint64_t> framesQueued{0};
+        std::atomic<uint64_t> framesDropped{0};
+        std::atomic<uint64_t> writeErrors{0};
+    };
+
+    struct Counts {
+        uint64_t bytesWritten, framesQueued, framesDropped, writeErrors;
+    };
+
+    static Counts counts(const FrameWriter& writer) {
+        return {writer.stats.bytesWritten.load(), writer.stats.framesQueued.load(),
+                writer.stats.framesDropped.load(), writer.stats.writeErrors.load()};
+    }
+
+    double secondsSinceStart() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void openSegment() {
+        if (segmented()) {
+            char index[16];
+            snprintf(index, sizeof(index), "-%04zu", segmentCount);
+            currentPath = stem + index + extension;
+        } else {
+            currentPath = stem + extension;
+        }
+        current.reset(new FrameWriter(currentPath));
+        segmentCount++;
+        segmentBytes = 0;
+        segmentStart = std::chrono::steady_clock::now();
+    }
+
+    // Hands the open segment to the closer thread. The previous segment has
+    // had a whole segment's time to flush, so the join is normally instant.
+    void retireSegment() {
+        if (closer.joinable()) closer.join();
+        // Counted before the writer is swapped out, so the totals never dip;
+        // the closer thread adds whatever the flush writes after this
+        Counts counted = counts(*current);
+        retired.framesQueued += counted.framesQueued;
+        retired.framesDropped += counted.framesDropped;
+        retired.writeErrors += counted.writeErrors;
+        retired.bytesWritten += counted.bytesWritten;
+        FrameWriter* writer = current.release();
+        closer = std::thread([this, writer, counted]() {
+            writer->close();
+            Counts closed = counts(*writer);
+            retired.framesQueued += closed.framesQueued - counted.framesQueued;
+            retired.framesDropped += closed.framesDropped - counted.framesDropped;
+            retired.writeErrors += closed.writeErrors - counted.writeErrors;
+            retired.bytesWritten += closed.bytesWritten - counted.bytesWritten;
+            delete writer;
+        });
+    }
+
+    std::string stem;
+    std::string extension;
+    uint64_t maxBytes;
+    double maxSeconds;
+    std::chrono::steady_clock::time_point start;
+    double closedAt = 0.0;
+
+    std::unique_ptr<FrameWriter> current;
+    std::string currentPath;
+    size_t segmentCount = 0;
+    uint64_t segmentBytes = 0;  // queued into the open segment
+    std::chrono::steady_clock::time_point segmentStart;
+    Totals retired;
+    std::thread closer;
+};
+
+#endif // SEGMENTED_WRITER_H
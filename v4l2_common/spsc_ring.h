@@ -0,0 +1,58 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. push() and pop() never block; they return false when the ring is
+// full or empty so the caller can apply its own drop/backpressure policy.
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : slots(capacity + 1) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side
+    bool push(const T& value) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        size_t next = advance(tail);
+        if (next == headIndex.load(std::memory_order_acquire)) return false;
+        slots[tail] = value;
+        tailIndex.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T& value) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailIndex.load(std::memory_order_acquire)) return false;
+        value = slots[head];
+        headIndex.store(advance(head), std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called concurrently with push/pop
+    size_t size() const {
+        size_t head = headIndex.load(std::memory_order_acquire);
+        size_t tail = tailIndex.load(std::memory_order_acquire);
+        return tail >= head ? tail - head : tail + slots.size() - head;
+    }
+
+    size_t capacity() const { return slots.size() - 1; }
+    bool full() const { return size() == capacity(); }
+
+private:
+    size_t advance(size_t i) const { return i + 1 == slots.size() ? 0 : i + 1; }
+
+    std::vector<T> slots;
+    // Producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<size_t> headIndex{0};
+    alignas(64) std::atomic<size_t> tailIndex{0};
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,91 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Fixed-size worker pool with a FIFO task queue.
+//
+// submit() returns a future for the task's result. Tasks start in the order
+// they were submitted, so a task may rely on every earlier task having been
+// picked up. parallelFor() splits an index range across the pool and waits.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < threads; i++) workers.emplace_back(&ThreadPool::run, this);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    template <typename F>
+    auto submit(F&& fn) -> std::future<decltype(fn())> {
+        typedef decltype(fn()) Result;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(fn));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace_back([task]() { (*task)(); });
+        }
+        wakeup.notify_one();
+        return result;
+    }
+
+    // Runs fn(i) for every i in [0, count) on the pool and waits for all of
+    // them. Must not be called from a pool thread.
+    template <typename F>
+    void parallelFor(size_t count, F fn) {
+        std::vector<std::future<void>> pending;
+        size_t batches = std::min(count, size());
+        for (size_t b = 0; b < batches; b++) {
+            pending.push_back(submit([=, &fn]() {
+                for (size_t i = b; i < count; i += batches) fn(i);
+            }));
+        }
+        for (auto& f : pending) f.get();
+    }
+
+private:
+    void run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool stopping = false;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,159 @@
+#ifndef URING_H
+#define URING_H
+
+// Minimal io_uring wrapper on the raw syscalls (no liburing dependency).
+//
+// Only what the recorder needs: fill SQEs, submit, and reap CQEs. One
+// thread owns a ring; nothing here is thread-safe. init() returns false if
+// the kernel (or a seccomp filter) refuses io_uring so callers can fall
+// back to plain syscalls.
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+class Uring {
+public:
+    Uring() {}
+    ~Uring() { shutdown(); }
+
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    bool init(unsigned entries) {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0) return false;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            if (cqRingSize > sqRingSize) sqRingSize = cqRingSize;
+            cqRingSize = sqRingSize;
+        }
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            sqRing = nullptr;
+            shutdown();
+            return false;
+        }
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) {
+                cqRing = nullptr;
+                shutdown();
+                return false;
+            }
+        }
+        sqeSize = params.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = static_cast<struct io_uring_sqe*>(
+            mmap(nullptr, sqeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            sqes = nullptr;
+            shutdown();
+            return false;
+        }
+
+        char* sq = static_cast<char*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+        entryCount = params.sq_entries;
+        return true;
+    }
+
+    void shutdown() {
+        if (sqes) munmap(sqes, sqeSize);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing) munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) close(ringFd);
+        sqes = nullptr;
+        sqRing = cqRing = nullptr;
+        ringFd = -1;
+    }
+
+    bool ready() const { return ringFd >= 0; }
+
+    // Next free SQE, zeroed, or nullptr if the submission queue is full
+    struct io_uring_sqe* getSqe() {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (localTail - head >= entryCount) return nullptr;
+        struct io_uring_sqe* sqe = &sqes[localTail & sqMask];
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[localTail & sqMask] = localTail & sqMask;
+        localTail++;
+        return sqe;
+    }
+
+    void prepWrite(struct io_uring_sqe* sqe, int fd, const void* buf, unsigned len, uint64_t offset, uint64_t userData) {
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->user_data = userData;
+    }
+
+    void prepRead(struct io_uring_sqe* sqe, int fd, void* buf, unsigned len, uint64_t offset, uint64_t userData) {
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->user_data = userData;
+    }
+
+    // Submits every prepared SQE and optionally waits for `waitFor`
+    // completions. Returns the io_uring_enter result (-errno on failure).
+    int submit(unsigned waitFor = 0) {
+        unsigned pending = localTail - *sqTail;
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        unsigned flags = waitFor ? IORING_ENTER_GETEVENTS : 0;
+        int ret = static_cast<int>(syscall(__NR_io_uring_enter, ringFd, pending, waitFor, flags, nullptr, 0));
+        return ret < 0 ? -errno : ret;
+    }
+
+    // Pops one completion if available
+    bool popCqe(struct io_uring_cqe& out) {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+        out = cqes[head & cqMask];
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    int ringFd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqeSize = 0;
+    struct io_uring_sqe* sqes = nullptr;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned localTail = 0;
+    unsigned entryCount = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    struct io_uring_cqe* cqes = nullptr;
+};
+
+#endif // URING_H
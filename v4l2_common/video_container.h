@@ -0,0 +1,151 @@
+#ifndef VIDEO_CONTAINER_H
+#define VIDEO_CONTAINER_H
+
+// Indexed container for recorded frames.
+//
+//   ContainerHeader
+//   { RecordHeader, payload } per frame
+//   IndexEntry[frameCount]
+//   ContainerFooter
+//
+// The index lets a player seek to any frame and read frames from several
+// threads at once. A recording that was cut off before the index was
+// written is still readable: ContainerReader rebuilds the index by walking
+// the records.
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace container {
+
+enum Codec : uint32_t {
+    CODEC_RAW = 0,
+    CODEC_LOSSLESS = 1,  // lossless_codec.h payloads
+};
+
+struct ContainerHeader {
+    char magic[4] = {'V', '4', 'L', 'Z'};
+    uint32_t version = 1;
+    uint32_t fourcc = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bytesperline = 0;
+    uint32_t codec = CODEC_RAW;
+    uint32_t reserved = 0;
+};
+
+struct RecordHeader {
+    uint32_t payloadBytes = 0;
+    uint32_t sequence = 0;
+    int64_t timestampUs = 0;
+};
+
+struct IndexEntry {
+    uint64_t offset = 0;  // of the payload
+    uint32_t payloadBytes = 0;
+    uint32_t sequence = 0;
+    int64_t timestampUs = 0;
+};
+
+struct ContainerFooter {
+    uint64_t indexOffset = 0;
+    uint32_t frameCount = 0;
+    char magic[4] = {'I', 'D', 'X', '1'};
+};
+
+static_assert(sizeof(ContainerHeader) == 32, "container header layout");
+static_assert(sizeof(RecordHeader) == 16, "record header layout");
+static_assert(sizeof(IndexEntry) == 24, "index entry layout");
+static_assert(sizeof(ContainerFooter) == 16, "footer layout");
+
+// Read-only view of a container file, mapped into memory
+class ContainerReader {
+public:
+    explicit ContainerReader(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Failed to open " + path);
+        struct stat st{};
+        fstat(fd, &st);
+        size = static_cast<size_t>(st.st_size);
+        if (size < sizeof(ContainerHeader)) {
+            close(fd);
+            throw std::runtime_error("Not a recording: " + path);
+        }
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) throw std::runtime_error("Failed to map " + path);
+        base = static_cast<const uint8_t*>(mapped);
+
+        memcpy(&header, base, sizeof(header));
+        if (memcmp(header.magic, "V4LZ", 4) != 0 || header.version != 1) {
+            munmap(const_cast<uint8_t*>(base), size);
+            throw std::runtime_error("Not a recording: " + path);
+        }
+        if (!readIndex()) rebuildIndex();
+    }
+
+    ~ContainerReader() { munmap(const_cast<uint8_t*>(base), size); }
+
+    ContainerReader(const ContainerReader&) = delete;
+    ContainerReader& operator=(const ContainerReader&) = delete;
+
+    const ContainerHeader& info() const { return header; }
+    size_t frameCount() const { return index.size(); }
+    const IndexEntry& entry(size_t frame) const { return index[frame]; }
+    const uint8_t* payload(size_t frame) const { return base + index[frame].offset; }
+
+    // The whole mapping, for madvise() by players
+    const uint8_t* data() const { return base; }
+    size_t fileSize() const { return size; }
+
+private:
+    bool readIndex() {
+        ContainerFooter footer;
+        if (size < sizeof(header) + sizeof(footer)) return false;
+        memcpy(&footer, base + size - sizeof(footer), sizeof(footer));
+        if (memcmp(footer.magic, "IDX1", 4) != 0) return false;
+        uint64_t indexBytes = static_cast<uint64_t>(footer.frameCount) * sizeof(IndexEntry);
+        if (footer.indexOffset + indexBytes + sizeof(footer) != size) return false;
+        index.resize(footer.frameCount);
+        memcpy(index.data(), base + footer.indexOffset, indexBytes);
+        for (const auto& e : index) {
+            if (e.payloadBytes == 0 || e.offset + e.payloadBytes > footer.indexOffset) return false;
+        }
+        return true;
+    }
+
+    void rebuildIndex() {
+        index.clear();
+        uint64_t offset = sizeof(header);
+        while (offset + sizeof(RecordHeader) <= size) {
+            RecordHeader record;
+            memcpy(&record, base + offset, sizeof(record));
+            uint64_t payloadOffset = offset + sizeof(record);
+            if (record.payloadBytes == 0 || payloadOffset + record.payloadBytes > size) break;
+            IndexEntry e;
+            e.offset = payloadOffset;
+            e.payloadBytes = record.payloadBytes;
+            e.sequence = record.sequence;
+            e.timestampUs = record.timestampUs;
+            index.push_back(e);
+            offset = payloadOffset + record.payloadBytes;
+        }
+    }
+
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+    ContainerHeader header;
+    std::vector<IndexEntry> index;
+};
+
+} // namespace container
+
+#endif // VIDEO_CONTAINER_H
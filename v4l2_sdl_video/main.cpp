@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <linux/videodev2.h>
 #include <vector>
 #include <cstdio>
@@ -10,155 +11,874 @@
 #include <cstring>
 #include<string>
 #include <stdexcept>
+#include <memory>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+
+#include "capture_loop.h"
+#include "replay_source.h"
+#include "segmented_writer.h"
+#include "frame_bus.h"
+#include "lossless_recorder.h"
+#include "event_recorder.h"
+#include "playback_file.h"
+#include "codec_bench.h"
+#include "latency_stats.h"
+#include "format_negotiation.h"
+#include "texture_upload.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "mjpeg_decoder.h"
 
 // Number of buffers for memory-mapped I/O
 const int N_BUFFERS = 4;
 
+// Latency stages, each measured from the V4L2 capture timestamp. For MJPEG
+// "acquire" is when the decoded frame reaches the render thread. SDL has no
+// present feedback, so "present" is when SDL_RenderPresent returns.
+enum LatencyStage { STAGE_ACQUIRE, STAGE_UPLOAD, STAGE_PRESENT };
+const std::vector<std::string> LATENCY_STAGES = {"acquire", "upload", "present"};
+
+// Render paths: YUV formats upload into native SDL YUV textures, RGB24 is
+// expanded by SDL on upload and MJPEG is decoded on the CPU. The lossless
+// codec only handles packed formats, so lossless recording narrows the set.
+std::vector<negotiation::RenderPath> renderPaths(bool lossless) {
+    std::vector<negotiation::RenderPath> paths;
+    if (!lossless) {
+        paths.push_back({V4L2_PIX_FMT_NV12, "native NV12 texture", 1.5, SDL_PIXELFORMAT_NV12});
+        paths.push_back({V4L2_PIX_FMT_YUV420, "native IYUV texture", 1.5, SDL_PIXELFORMAT_IYUV});
+        paths.push_back({V4L2_PIX_FMT_YVU420, "native YV12 texture", 1.5, SDL_PIXELFORMAT_YV12});
+    }
+    paths.push_back({V4L2_PIX_FMT_YUYV, "native YUY2 texture", 2.0, SDL_PIXELFORMAT_YUY2});
+    paths.push_back({V4L2_PIX_FMT_RGB24, "RGB24 texture", 7.5, SDL_PIXELFORMAT_RGB24});
+    if (!lossless) paths.push_back({V4L2_PIX_FMT_MJPEG, "parallel MJPEG decode", 40.0, SDL_PIXELFORMAT_RGBA32});
+    return paths;
+}
+
 struct Buffer {
     void* start;
     size_t length;
 };
 
-int main(int argc, char* argv[]) {
-    const char* device = "/dev/video0";
-    const char* outfile = "capture.yuv";
-    int fd = open(device, O_RDWR);
-    if (fd < 0) {
-        perror("Opening video device");
-        return EXIT_FAILURE;
+// One streaming capture device, or a recording replayed in its place
+struct Device {
+    std::string path;
+    bool replay = false;                                  // --replay: path is a raw recording
+    std::unique_ptr<ReplaySource> replaySource;           // handed to the capture loop at start
+    int fd = -1;
+    struct v4l2_format fmt = {};
+    SDL_PixelFormat textureFormat = SDL_PIXELFORMAT_UNKNOWN;  // from the negotiated render path
+    std::vector<Buffer> buffers;
+    std::unique_ptr<SegmentedWriter> recorder;            // --record-format raw
+    std::unique_ptr<LosslessRecorder> losslessRecorder;   // --record-format lossless
+    std::unique_ptr<EventRecorder> eventRecorder;         // --pre-trigger
+    std::unique_ptr<MjpegDecoder> mjpeg;                  // negotiated MJPEG
+    std::unique_ptr<framebus::Publisher> publisher;       // --publish
+    SDL_Texture* tex = nullptr;
+    bool haveFrame = false;
+    std::unique_ptr<LatencyTracker> latency;
+    TextureUploadStats uploadStats;
+    int64_t uploadedCaptureUs = 0;  // capture time of the frame uploaded since the last present
+    bool presentPending = false;
+};
+
+// Opens `dev.path`, negotiates the cheapest format for `request`, maps and
+// queues the buffers and starts streaming. Throws on failure.
+void openDevice(Device& dev, const negotiation::Request& request, const std::vector<negotiation::RenderPath>& paths) {
+    dev.fd = open(dev.path.c_str(), O_RDWR);
+    if (dev.fd < 0) {
+        throw std::runtime_error("Opening video device " + dev.path + ": " + strerror(errno));
     }
 
     // 1. Query capabilities
     struct v4l2_capability cap = {};
-    if (ioctl(fd, VIDIOC_QUERYCAP, &cap) < 0) {
-        perror("VIDIOC_QUERYCAP");
-        return EXIT_FAILURE;
+    if (ioctl(dev.fd, VIDIOC_QUERYCAP, &cap) < 0) {
+        throw std::runtime_error("VIDIOC_QUERYCAP failed on " + dev.path);
     }
 
-    // 2. Set format: YUYV 640x480 @ 30fps
-    struct v4l2_format fmt = {};
-    fmt.type                = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    fmt.fmt.pix.width       = 640;
-    fmt.fmt.pix.height      = 480;
-    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-    fmt.fmt.pix.field       = V4L2_FIELD_ANY;
-    if (ioctl(fd, VIDIOC_S_FMT, &fmt) < 0) {
-        perror("VIDIOC_S_FMT");
-        return EXIT_FAILURE;
-    }
+    // 2. Pick and set the format; buffers and textures follow what the driver returned
+    negotiation::Choice choice;
+    dev.fmt = negotiation::negotiate(dev.fd, paths, request, dev.path, choice);
+    dev.textureFormat = static_cast<SDL_PixelFormat>(choice.path.tag);
 
     // 3. Request buffers (MMAP)
     struct v4l2_requestbuffers req = {};
     req.count  = N_BUFFERS;
     req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     req.memory = V4L2_MEMORY_MMAP;
-    if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
-        perror("VIDIOC_REQBUFS");
-        return EXIT_FAILURE;
+    if (ioctl(dev.fd, VIDIOC_REQBUFS, &req) < 0) {
+        throw std::runtime_error("VIDIOC_REQBUFS failed on " + dev.path);
     }
 
     // 4. Map buffers
-    std::vector<Buffer> buffers(req.count);
-    for (auto& buf : buffers) {
+    dev.buffers.resize(req.count);
+    for (auto& buf : dev.buffers) {
         struct v4l2_buffer vbuf = {};
         vbuf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         vbuf.memory = V4L2_MEMORY_MMAP;
-        vbuf.index  = &buf - &buffers[0];
-        if (ioctl(fd, VIDIOC_QUERYBUF, &vbuf) < 0) {
-            perror("VIDIOC_QUERYBUF");
-            return EXIT_FAILURE;
+        vbuf.index  = &buf - &dev.buffers[0];
+        if (ioctl(dev.fd, VIDIOC_QUERYBUF, &vbuf) < 0) {
+            throw std::runtime_error("VIDIOC_QUERYBUF failed on " + dev.path);
         }
         buf.length = vbuf.length;
         buf.start  = mmap(nullptr, buf.length,
                           PROT_READ | PROT_WRITE,
-                          MAP_SHARED, fd, vbuf.m.offset);
+                          MAP_SHARED, dev.fd, vbuf.m.offset);
         if (buf.start == MAP_FAILED) {
-            perror("mmap");
-            return EXIT_FAILURE;
+            throw std::runtime_error("mmap failed on " + dev.path);
         }
     }
 
     // 5. Queue buffers
-    for (unsigned i = 0; i < buffers.size(); ++i) {
+    for (unsigned i = 0; i < dev.buffers.size(); ++i) {
         struct v4l2_buffer vbuf = {};
         vbuf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         vbuf.memory = V4L2_MEMORY_MMAP;
         vbuf.index  = i;
-        ioctl(fd, VIDIOC_QBUF, &vbuf);
+        if (ioctl(dev.fd, VIDIOC_QBUF, &vbuf) < 0) {
+            throw std::runtime_error("VIDIOC_QBUF failed on " + dev.path);
+        }
     }
 
     // 6. Start streaming
     int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    ioctl(fd, VIDIOC_STREAMON, &type);
+    if (ioctl(dev.fd, VIDIOC_STREAMON, &type) < 0) {
+        throw std::runtime_error("VIDIOC_STREAMON failed on " + dev.path);
+    }
+}
+
+void closeDevice(Device& dev) {
+    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    ioctl(dev.fd, VIDIOC_STREAMOFF, &type);
+    for (auto& buf : dev.buffers) munmap(buf.start, buf.length);
+    close(dev.fd);
+}
+
+// Set from SIGINT/SIGTERM to end a headless run
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) { stopRequested = 1; }
+
+// Set from SIGUSR1 to start (or extend) an event recording
+volatile std::sig_atomic_t triggerRequested = 0;
 
-    // Open output file
-    FILE* out = std::fopen(outfile, "wb");
-    if (!out) {
-        perror("Opening output file");
-        return EXIT_FAILURE;
+void requestTrigger(int) { triggerRequested = 1; }
+
+// Hands a SIGUSR1 (or T key) trigger to every event recorder
+void triggerEvents(std::vector<Device>& devices) {
+    triggerRequested = 0;
+    for (auto& dev : devices) {
+        if (dev.eventRecorder) dev.eventRecorder->trigger();
     }
+    printf("Event triggered\n");
+}
 
-    // Initialize SDL3
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        throw std::runtime_error("SDL_Init failed: " + std::string(SDL_GetError()));
+// Headless recording: no window, no texture uploads and no present pacing.
+// Every frame goes to the recorder as soon as it is captured, until SIGINT,
+// SIGTERM, `durationSeconds` (if > 0) or the end of every replay. Prints the
+// sustained write rate and drops per device once a second.
+void recordHeadless(std::vector<Device>& devices, CaptureLoop& capture, bool lowLatency, bool allReplay,
+                    double durationSeconds) {
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+
+    // Bytes on disk and frames dropped anywhere between the driver and the file
+    auto written = [](const Device& dev) -> uint64_t {
+        if (dev.losslessRecorder) return dev.losslessRecorder->writerStats().bytesWritten;
+        if (dev.eventRecorder) return dev.eventRecorder->stats.bytesWritten;
+        return dev.recorder ? dev.recorder->bytesWritten() : 0;
+    };
+    auto dropped = [&capture, &devices](size_t i) -> uint64_t {
+        const Device& dev = devices[i];
+        uint64_t frames = capture.stats(i).dropped + capture.stats(i).driverDropped;
+        if (dev.losslessRecorder) {
+            frames += dev.losslessRecorder->stats.framesDropped + dev.losslessRecorder->writerStats().framesDropped;
+        } else if (dev.eventRecorder) {
+            frames += dev.eventRecorder->stats.framesDropped;
+        } else if (dev.recorder) {
+            frames += dev.recorder->framesDropped();
+        }
+        return frames;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto reportAt = start + std::chrono::seconds(1);
+    std::vector<uint64_t> reportedBytes(devices.size(), 0);
+    while (!stopRequested) {
+        if (triggerRequested) triggerEvents(devices);
+        bool recorded = false;
+        for (size_t i = 0; i < devices.size(); i++) {
+            Device& dev = devices[i];
+            CapturedFrame frame;
+            while (lowLatency ? capture.acquireLatest(i, frame) : capture.acquire(i, frame)) {
+                dev.latency->record(STAGE_ACQUIRE, LatencyTracker::toUs(frame.timestamp));
+                if (dev.losslessRecorder) {
+                    dev.losslessRecorder->write(dev.buffers[frame.index].start, frame.bytesused, frame.sequence,
+                                                frame.timestamp);
+                } else if (dev.eventRecorder) {
+                    dev.eventRecorder->write(dev.buffers[frame.index].start, frame.bytesused, frame.timestamp);
+                } else if (dev.recorder) {
+                    dev.recorder->write(dev.buffers[frame.index].start, frame.bytesused);
+                }
+                if (dev.publisher) {
+                    dev.publisher->publish(dev.buffers[frame.index].start, frame.bytesused, frame.sequence,
+                                           frame.timestamp);
+                }
+                capture.release(i, frame);
+                recorded = true;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - start).count();
+        if (now >= reportAt) {
+            double seconds = std::chrono::duration<double>(now - reportAt).count() + 1.0;
+            for (size_t i = 0; i < devices.size(); i++) {
+                uint64_t bytes = written(devices[i]);
+                printf("%s: %.1f MB/s, %.1f fps, %llu dropped\n", devices[i].path.c_str(),
+                       (bytes - reportedBytes[i]) / seconds / 1e6, capture.stats(i).fps.load(),
+                       static_cast<unsigned long long>(dropped(i)));
+                reportedBytes[i] = bytes;
+            }
+            reportAt = now + std::chrono::seconds(1);
+        }
+        if (durationSeconds > 0 && elapsed >= durationSeconds) break;
+        if (recorded) continue;
+
+        // A replay-only run ends once every file has been recorded
+        bool finished = allReplay;
+        for (size_t i = 0; i < devices.size() && finished; i++) {
+            finished = capture.stats(i).ended && capture.pending(i) == 0;
+        }
+        if (finished) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
 
-    // Create window (width, height, flags)
-    SDL_Window* win = SDL_CreateWindow(
-        "V4L2 + SDL3 Capture",
-        fmt.fmt.pix.width, fmt.fmt.pix.height,
-        0                               // no flags
-    );
-    // Create renderer (name=nullptr lets SDL pick)
-    SDL_Renderer* ren = SDL_CreateRenderer(win, nullptr);
-    if (!ren) {
-        SDL_Log("SDL_CreateRenderer Error: %s", SDL_GetError());
-        return EXIT_FAILURE;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (size_t i = 0; i < devices.size(); i++) {
+        printf("%s: %.1f MB/s sustained over %.1f s, %llu frames dropped\n", devices[i].path.c_str(),
+               elapsed > 0 ? written(devices[i]) / elapsed / 1e6 : 0.0, elapsed,
+               static_cast<unsigned long long>(dropped(i)));
     }
-    SDL_Texture* tex = SDL_CreateTexture(ren,
-        SDL_PIXELFORMAT_YUY2, SDL_TEXTUREACCESS_STREAMING,
-        fmt.fmt.pix.width, fmt.fmt.pix.height);
+}
 
-    // Main loop
+// Interactive player for a raw recording (--format/--size describe it) or a
+// .v4lz container. The file is mapped, not loaded, so multi-GB recordings
+// open at once and seek anywhere:
+//   Space pause      R reverse        Up/Down speed x2 / /2
+//   Left/Right -/+5 s   ,/. step one frame   Home/End, 0-9 jump
+//   click or drag anywhere in the window to scrub
+// Frames come from PlaybackFile, which hints the kernel to read ahead in the
+// direction of play. Seek latency is from the seek to the frame's upload.
+int runPlayer(const std::string& path, const negotiation::Request& request, double fps, bool loop,
+              TextureUpload textureUpload) {
+    if (fps <= 0) fps = 30.0;
+    ThreadPool pool;
+    PlaybackFile file(path, request.fourcc ? request.fourcc : V4L2_PIX_FMT_YUYV, request.width, request.height, &pool);
+
+    negotiation::Mode mode;
+    mode.fourcc = file.fourcc();
+    mode.width = file.width();
+    mode.height = file.height();
+    negotiation::Choice choice;
+    if (!negotiation::choose({mode}, renderPaths(false), request, choice) || mode.fourcc == V4L2_PIX_FMT_MJPEG) {
+        throw std::runtime_error(negotiation::fourccName(mode.fourcc) + " recordings cannot be played");
+    }
+    const SDL_PixelFormat textureFormat = static_cast<SDL_PixelFormat>(choice.path.tag);
+    const size_t frames = file.frames();
+    printf("Playing %s: %zu frames of %s %ux%u, %.1f GB%s\n", path.c_str(), frames,
+           negotiation::fourccName(mode.fourcc).c_str(), mode.width, mode.height, file.fileBytes() / 1e9,
+           file.indexed() ? ", indexed container" : "");
+
+    if (!SDL_Init(SDL_INIT_VIDEO)) {
+        throw std::runtime_error("SDL_Init failed: " + std::string(SDL_GetError()));
+    }
+    // At most 1280 wide, keeping the aspect ratio
+    const int windowWidth = static_cast<int>(std::min<uint32_t>(mode.width, 1280));
+    const int windowHeight = static_cast<int>(static_cast<uint64_t>(mode.height) * windowWidth / mode.width);
+    SDL_Window* win = SDL_CreateWindow("V4L2 + SDL3 Playback", windowWidth, windowHeight, 0);
+    SDL_Renderer* ren = SDL_CreateRenderer(win, nullptr);
+    if (!ren) throw std::runtime_error("SDL_CreateRenderer failed: " + std::string(SDL_GetError()));
+    SDL_Texture* tex = SDL_CreateTexture(ren, textureFormat, SDL_TEXTUREACCESS_STREAMING, mode.width, mode.height);
+    if (!tex) throw std::runtime_error("SDL_CreateTexture failed: " + std::string(SDL_GetError()));
+
+    TextureUploadStats uploadStats;
+    LatencyHistogram seekLatency;
+    double position = 0.0;  // in frames
+    double speed = 1.0;
+    int direction = 1;
+    bool paused = false;
+    bool seekPending = true;  // the first frame counts as a seek
+    auto seekStart = std::chrono::steady_clock::now();
+    size_t shown = frames;  // none yet
+    auto seek = [&](double target) {
+        position = std::min(std::max(target, 0.0), static_cast<double>(frames - 1));
+        seekPending = true;
+        seekStart = std::chrono::steady_clock::now();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto last = start;
+    auto reportAt = start + std::chrono::seconds(1);
+    uint64_t reportedBytes = 0;
     bool running = true;
     while (running) {
-        // Handle SDL events
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
             if (e.type == SDL_EVENT_QUIT) running = false;
+            if (e.type == SDL_EVENT_KEY_DOWN) {
+                const SDL_Keycode key = e.key.key;
+                if (key == SDLK_ESCAPE || key == SDLK_Q) running = false;
+                else if (key == SDLK_SPACE) paused = !paused;
+                else if (key == SDLK_R) direction = -direction;
+                else if (key == SDLK_UP) speed = std::min(speed * 2.0, 64.0);
+                else if (key == SDLK_DOWN) speed = std::max(speed / 2.0, 1.0 / 16.0);
+                else if (key == SDLK_RIGHT) seek(position + 5.0 * fps);
+                else if (key == SDLK_LEFT) seek(position - 5.0 * fps);
+                else if (key == SDLK_PERIOD || key == SDLK_COMMA) {
+                    paused = true;
+                    seek(std::floor(position) + (key == SDLK_PERIOD ? 1.0 : -1.0));
+                } else if (key == SDLK_HOME) seek(0.0);
+                else if (key == SDLK_END) seek(static_cast<double>(frames - 1));
+                else if (key >= SDLK_0 && key <= SDLK_9) seek(static_cast<double>(frames) * (key - SDLK_0) / 10.0);
+            }
+            if (e.type == SDL_EVENT_MOUSE_BUTTON_DOWN) seek(static_cast<double>(frames) * e.button.x / windowWidth);
+            if (e.type == SDL_EVENT_MOUSE_MOTION && (e.motion.state & SDL_BUTTON_LMASK)) {
+                seek(static_cast<double>(frames) * e.motion.x / windowWidth);
+            }
         }
 
-        // Dequeue buffer
-        struct v4l2_buffer vbuf = {};
-        vbuf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        vbuf.memory = V4L2_MEMORY_MMAP;
-        ioctl(fd, VIDIOC_DQBUF, &vbuf);
+        auto now = std::chrono::steady_clock::now();
+        double dt = std::chrono::duration<double>(now - last).count();
+        last = now;
+        if (!paused && !seekPending) {
+            position += dt * fps * speed * direction;
+            if (position < 0.0 || position >= static_cast<double>(frames)) {
+                if (loop) {
+                    position = direction > 0 ? 0.0 : static_cast<double>(frames - 1);
+                } else {
+                    position = std::min(std::max(position, 0.0), static_cast<double>(frames - 1));
+                    paused = true;
+                }
+            }
+        }
 
-        // Write raw YUYV to file
-        fwrite(buffers[vbuf.index].start, 1, buffers[vbuf.index].length, out);
+        const size_t frame = static_cast<size_t>(position);
+        if (frame != shown) {
+            // Half a second of play ahead, capped at 256 MB of file
+            size_t readahead = static_cast<size_t>(std::ceil(fps * speed * 0.5));
+            readahead = std::min(readahead, std::max<size_t>(1, (256u << 20) / (file.fileBytes() / frames)));
+            const uint8_t* pixels = file.fetch(frame, direction, readahead);
+            if (pixels) {
+                uploadTexture(tex, textureFormat, textureUpload, pixels, file.bytesperline(), mode.width, mode.height,
+                              uploadStats);
+            }
+            if (seekPending) {
+                seekLatency.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - seekStart)
+                                    .count());
+            }
+            shown = frame;
+        }
+        seekPending = false;
 
-        // Update SDL texture and render
-        SDL_UpdateTexture(tex, nullptr,
-                          buffers[vbuf.index].start,
-                          fmt.fmt.pix.width * 2);
         SDL_RenderClear(ren);
         SDL_RenderTexture(ren, tex, nullptr, nullptr);
+        // Progress bar along the bottom edge
+        SDL_FRect bar = {0.0f, static_cast<float>(windowHeight - 4),
+                         static_cast<float>(windowWidth * (position + 1.0) / frames), 4.0f};
+        SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+        SDL_RenderFillRect(ren, &bar);
+        SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
         SDL_RenderPresent(ren);
 
-        // Re-queue buffer
-        ioctl(fd, VIDIOC_QBUF, &vbuf);
+        if (now >= reportAt) {
+            double seconds = std::chrono::duration<double>(now - reportAt).count() + 1.0;
+            printf("Frame %zu/%zu (%.1f s), %s %s%.3gx, %.1f MB/s read, %llu major faults\n", frame, frames,
+                   frame / fps, paused ? "paused" : "playing", direction < 0 ? "-" : "", speed,
+                   (file.stats.bytes - reportedBytes) / seconds / 1e6,
+                   static_cast<unsigned long long>(file.stats.majorFaults));
+            reportedBytes = file.stats.bytes;
+            reportAt = now + std::chrono::seconds(1);
+        }
     }
 
-    // Cleanup
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    file.stats.print(("Playback " + path).c_str(), elapsed);
+    printf("Playback %s: %llu seeks, latency p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", path.c_str(),
+           static_cast<unsigned long long>(seekLatency.count()), seekLatency.percentile(50) / 1e3,
+           seekLatency.percentile(99) / 1e3, seekLatency.max() / 1e3);
+    uploadStats.print(("Playback " + path).c_str(), textureUpload);
+
     SDL_DestroyTexture(tex);
     SDL_DestroyRenderer(ren);
     SDL_DestroyWindow(win);
     SDL_Quit();
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<Device> devices;
+    DropPolicy dropPolicy = DropPolicy::DropNewest;
+    bool lowLatency = false;  // newest frame wins; skipped frames are neither shown nor recorded
+    int timeoutMs = 1000;
+    bool lossless = false;
+    negotiation::Request request;  // format 0 = cheapest to show
+    size_t decodeDepth = 0;  // MJPEG frames decoding at once; 0 = one per core + 1
+    double replayFps = 30.0; // 0 = as fast as frames are consumed
+    bool replayLoop = false;
+    std::string latencyCsvPath;
+    double latencyInterval = 5.0;  // seconds between CSV windows
+    TextureUpload textureUpload = TextureUpload::Lock;
+    bool headless = false;         // record only, without SDL video
+    double duration = 0.0;         // headless run time in seconds; 0 = until SIGINT/SIGTERM
+    uint64_t segmentBytes = 0;     // raw recordings roll over to a new file past this size...
+    double segmentSeconds = 0.0;   // ...or this age; 0 = one file
+    std::string publishPath;       // frame bus socket; empty = no bus
+    uint32_t publishSlots = 8;
+    double preTrigger = 0.0;       // seconds kept in memory for event recording; 0 = record everything
+    double postTrigger = 10.0;     // seconds recorded after each trigger
+    double historyMb = 0.0;        // event history cap per device; 0 = sized from --pre-trigger
+    std::string playPath;          // interactive playback instead of capture
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--device" && i + 1 < argc) {
+            // Repeat to capture from several devices at once
+            devices.emplace_back();
+            devices.back().path = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            // Raw recording in the --format pixel format at --size, instead of a camera
+            devices.emplace_back();
+            devices.back().path = argv[++i];
+            devices.back().replay = true;
+        } else if (arg == "--replay-fps" && i + 1 < argc) {
+            replayFps = std::atof(argv[++i]);
+        } else if (arg == "--replay-loop") {
+            replayLoop = true;
+        } else if (arg == "--latency-csv" && i + 1 < argc) {
+            latencyCsvPath = argv[++i];
+        } else if (arg == "--latency-interval" && i + 1 < argc) {
+            latencyInterval = std::atof(argv[++i]);
+        } else if (arg == "--drop-policy" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "newest") dropPolicy = DropPolicy::DropNewest;
+            else if (name == "block") dropPolicy = DropPolicy::Block;
+            else throw std::runtime_error("Unknown drop policy: " + name);
+        } else if (arg == "--low-latency") {
+            lowLatency = true;
+        } else if (arg == "--texture-upload" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "update") textureUpload = TextureUpload::Update;
+            else if (name == "lock") textureUpload = TextureUpload::Lock;
+            else throw std::runtime_error("Unknown texture upload: " + name);
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--duration" && i + 1 < argc) {
+            duration = std::atof(argv[++i]);
+        } else if (arg == "--segment-size" && i + 1 < argc) {
+            // Megabytes
+            segmentBytes = static_cast<uint64_t>(std::atof(argv[++i]) * 1e6);
+        } else if (arg == "--segment-time" && i + 1 < argc) {
+            segmentSeconds = std::atof(argv[++i]);
+        } else if (arg == "--publish" && i + 1 < argc) {
+            // Socket of a shared-memory frame bus for other processes (v4l2_bus_consumer)
+            publishPath = argv[++i];
+        } else if (arg == "--publish-slots" && i + 1 < argc) {
+            publishSlots = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--pre-trigger" && i + 1 < argc) {
+            // Record only around events (SIGUSR1 or the T key), keeping this many seconds before each
+            preTrigger = std::atof(argv[++i]);
+        } else if (arg == "--post-trigger" && i + 1 < argc) {
+            postTrigger = std::atof(argv[++i]);
+        } else if (arg == "--history-mb" && i + 1 < argc) {
+            historyMb = std::atof(argv[++i]);
+        } else if (arg == "--play" && i + 1 < argc) {
+            // Seekable playback of a recording at --replay-fps (--replay-loop to wrap)
+            playPath = argv[++i];
+        } else if (arg == "--timeout" && i + 1 < argc) {
+            timeoutMs = std::atoi(argv[++i]);
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "auto") request.fourcc = 0;
+            else if (name == "yuyv") request.fourcc = V4L2_PIX_FMT_YUYV;
+            else if (name == "nv12") request.fourcc = V4L2_PIX_FMT_NV12;
+            else if (name == "yu12") request.fourcc = V4L2_PIX_FMT_YUV420;
+            else if (name == "yv12") request.fourcc = V4L2_PIX_FMT_YVU420;
+            else if (name == "rgb24") request.fourcc = V4L2_PIX_FMT_RGB24;
+            else if (name == "mjpeg") request.fourcc = V4L2_PIX_FMT_MJPEG;
+            else throw std::runtime_error("Unknown format: " + name);
+        } else if (arg == "--size" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ux%u", &request.width, &request.height) != 2) {
+                throw std::runtime_error("--size takes WIDTHxHEIGHT");
+            }
+        } else if (arg == "--fps" && i + 1 < argc) {
+            request.fps = std::atof(argv[++i]);
+        } else if (arg == "--decode-depth" && i + 1 < argc) {
+            decodeDepth = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--record-format" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "raw") lossless = false;
+            else if (name == "lossless") lossless = true;
+            else throw std::runtime_error("Unknown record format: " + name);
+        } else if (arg == "--bench-codec") {
+            // Optional raw YUYV 640x480 recording to benchmark on
+            const char* rawFile = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : nullptr;
+            return lossless::runCodecBenchmark(rawFile, 640, 480) ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    if (!playPath.empty()) return runPlayer(playPath, request, replayFps, replayLoop, textureUpload);
+    if (devices.empty()) {
+        devices.emplace_back();
+        devices.back().path = "/dev/video0";
+    }
+
+    if (request.fourcc == V4L2_PIX_FMT_MJPEG && lossless) {
+        throw std::runtime_error("MJPEG is already compressed; record it with --record-format raw");
+    }
+    if (lossless && (segmentBytes || segmentSeconds > 0)) {
+        throw std::runtime_error("Segmented recording needs --record-format raw");
+    }
+    if (preTrigger > 0 && (lossless || segmentBytes || segmentSeconds > 0)) {
+        throw std::runtime_error("Event recording (--pre-trigger) writes raw clips and cannot be segmented");
+    }
+    const std::vector<negotiation::RenderPath> paths = renderPaths(lossless);
+
+    // Compression/decode workers shared by every device, created on first use
+    std::unique_ptr<ThreadPool> codecPool;
+    auto sharedPool = [&codecPool]() -> ThreadPool& {
+        if (!codecPool) codecPool.reset(new ThreadPool());
+        return *codecPool;
+    };
+
+    for (size_t i = 0; i < devices.size(); i++) {
+        Device& dev = devices[i];
+        dev.latency.reset(new LatencyTracker(dev.path, LATENCY_STAGES));
+        if (dev.replay) {
+            // Replayed frames stand in for the mapped capture buffers and are
+            // not recorded again. The file has no header, so --format (YUYV
+            // by default) and --size describe it.
+            negotiation::Mode mode;
+            mode.fourcc = request.fourcc ? request.fourcc : V4L2_PIX_FMT_YUYV;
+            mode.width = request.width;
+            mode.height = request.height;
+            negotiation::Choice choice;
+            if (mode.fourcc == V4L2_PIX_FMT_MJPEG || !negotiation::choose({mode}, paths, request, choice)) {
+                throw std::runtime_error(negotiation::fourccName(mode.fourcc) + " recordings cannot be replayed");
+            }
+            dev.textureFormat = static_cast<SDL_PixelFormat>(choice.path.tag);
+            dev.fmt.fmt.pix.width = mode.width;
+            dev.fmt.fmt.pix.height = mode.height;
+            dev.fmt.fmt.pix.pixelformat = mode.fourcc;
+            dev.fmt.fmt.pix.bytesperline = mode.fourcc == V4L2_PIX_FMT_YUYV  ? mode.width * 2
+                                         : mode.fourcc == V4L2_PIX_FMT_RGB24 ? mode.width * 3
+                                                                             : mode.width;
+            dev.replaySource.reset(new ReplaySource(dev.path, ReplaySource::frameBytes(mode.fourcc, mode.width, mode.height),
+                                                    replayFps, replayLoop, N_BUFFERS));
+            for (uint32_t b = 0; b < dev.replaySource->bufferCount(); b++) {
+                dev.buffers.push_back({dev.replaySource->buffer(b), dev.replaySource->bufferLength()});
+            }
+            if (replayFps > 0) printf("Replaying %s: %zu frames at %.1f fps\n", dev.path.c_str(), dev.replaySource->frames(), replayFps);
+            else printf("Replaying %s: %zu frames at unlimited rate\n", dev.path.c_str(), dev.replaySource->frames());
+            continue;
+        }
+        openDevice(dev, request, paths);
+        const bool mjpeg = dev.fmt.fmt.pix.pixelformat == V4L2_PIX_FMT_MJPEG;
+        if (mjpeg && !headless) {
+            // Headless runs only record the compressed stream
+            ThreadPool& pool = sharedPool();
+            dev.mjpeg.reset(new MjpegDecoder(pool, decodeDepth ? decodeDepth : pool.size() + 1));
+        }
+
+        // Raw YUV goes to capture.yuv, capture1.yuv, ... (RGB24 to .rgb);
+        // lossless recordings to capture.v4lz, ...; MJPEG streams to capture.mjpeg, ...
+        // Segmented recordings number their files: capture-0000.yuv, capture1-0000.yuv, ...
+        const char* extension = lossless ? ".v4lz"
+                              : mjpeg ? ".mjpeg"
+                              : dev.fmt.fmt.pix.pixelformat == V4L2_PIX_FMT_RGB24 ? ".rgb" : ".yuv";
+        std::string stem = i == 0 ? "capture" : "capture" + std::to_string(i);
+        if (lossless) {
+            std::string outfile = stem + extension;
+            lossless::FrameLayout layout;
+            layout.fourcc = dev.fmt.fmt.pix.pixelformat;
+            layout.width = dev.fmt.fmt.pix.width;
+            layout.height = dev.fmt.fmt.pix.height;
+            layout.bytesperline = dev.fmt.fmt.pix.bytesperline;
+            dev.losslessRecorder.reset(new LosslessRecorder(outfile, layout, sharedPool()));
+            printf("Recording %s to %s (lossless, %zu threads)\n", dev.path.c_str(), outfile.c_str(), codecPool->size());
+        } else if (preTrigger > 0) {
+            // Unless capped, the history holds the pre-trigger window plus a
+            // second of slack at the requested (or a typical 30) fps
+            const double fps = request.fps > 0 ? request.fps : 30.0;
+            const size_t historyBytes = historyMb > 0 ? static_cast<size_t>(historyMb * 1e6)
+                                                      : static_cast<size_t>(dev.buffers[0].length * fps * (preTrigger + 1.0));
+            dev.eventRecorder.reset(new EventRecorder(stem, extension, historyBytes, preTrigger, postTrigger));
+            printf("Recording %s events to %s-event-NNNN%s (%.1f s before, %.1f s after, %.1f MB history)\n",
+                   dev.path.c_str(), stem.c_str(), extension, preTrigger, postTrigger,
+                   dev.eventRecorder->capacity() / 1e6);
+        } else {
+            dev.recorder.reset(new SegmentedWriter(stem, extension, segmentBytes, segmentSeconds));
+            printf("Recording %s to %s%s (%s%s)\n", dev.path.c_str(), dev.recorder->path().c_str(),
+                   dev.recorder->segmented() ? " onwards" : "",
+                   dev.recorder->usingIoUring() ? "io_uring" : "pwrite",
+                   dev.recorder->usingDirectIo() ? ", O_DIRECT" : "");
+        }
+    }
+
+    // Each device gets a bus of its own: PATH, PATH1, PATH2, ... Frames are
+    // published as captured (MJPEG still compressed), before any decode
+    if (!publishPath.empty()) {
+        for (size_t i = 0; i < devices.size(); i++) {
+            Device& dev = devices[i];
+            framebus::Format format;
+            format.fourcc = dev.fmt.fmt.pix.pixelformat;
+            format.width = dev.fmt.fmt.pix.width;
+            format.height = dev.fmt.fmt.pix.height;
+            format.bytesperline = dev.fmt.fmt.pix.bytesperline;
+            std::string path = i == 0 ? publishPath : publishPath + std::to_string(i);
+            dev.publisher.reset(new framebus::Publisher(path, format, dev.buffers[0].length, publishSlots));
+            printf("Publishing %s on %s (%u slots of %zu bytes)\n", dev.path.c_str(), path.c_str(),
+                   dev.publisher->slots(), dev.buffers[0].length);
+        }
+    }
+
+    // Devices are tiled left to right, top to bottom in 640x480 cells
+    const int tileWidth = 640, tileHeight = 480;
+    int columns = 1;
+    SDL_Window* win = nullptr;
+    SDL_Renderer* ren = nullptr;
+    if (!headless) {
+        // Initialize SDL3
+        if (!SDL_Init(SDL_INIT_VIDEO)) {
+            throw std::runtime_error("SDL_Init failed: " + std::string(SDL_GetError()));
+        }
+
+        while (columns * columns < static_cast<int>(devices.size())) columns++;
+        int rows = (static_cast<int>(devices.size()) + columns - 1) / columns;
 
-    std::fclose(out);
-    type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    ioctl(fd, VIDIOC_STREAMOFF, &type);
-    for (auto& buf : buffers) munmap(buf.start, buf.length);
-    close(fd);
+        // Create window (width, height, flags)
+        win = SDL_CreateWindow(
+            "V4L2 + SDL3 Capture",
+            columns * tileWidth, rows * tileHeight,
+            0                               // no flags
+        );
+        // Create renderer (name=nullptr lets SDL pick)
+        ren = SDL_CreateRenderer(win, nullptr);
+        if (!ren) {
+            SDL_Log("SDL_CreateRenderer Error: %s", SDL_GetError());
+            return EXIT_FAILURE;
+        }
+        // SDL has no mailbox setting; without vsync a present never waits for
+        // the display, which is the nearest equivalent
+        if (lowLatency) SDL_SetRenderVSync(ren, SDL_RENDERER_VSYNC_DISABLED);
+        for (auto& dev : devices) {
+            // Sized from the negotiated format; the tile scales it to the cell
+            dev.tex = SDL_CreateTexture(ren, dev.textureFormat, SDL_TEXTUREACCESS_STREAMING,
+                                        dev.fmt.fmt.pix.width, dev.fmt.fmt.pix.height);
+            if (!dev.tex) {
+                throw std::runtime_error("SDL_CreateTexture failed for " + dev.path + ": " + SDL_GetError());
+            }
+        }
+    }
+
+    // One epoll-driven thread captures from every device, so a slow present
+    // or a stalled camera never blocks the window or the other devices
+    CaptureLoop capture;
+    bool allReplay = true;
+    for (auto& dev : devices) {
+        if (dev.replay) {
+            capture.addSource(std::move(dev.replaySource), dropPolicy, 0, timeoutMs);
+        } else {
+            capture.addSource(std::unique_ptr<CaptureSource>(new V4l2Source(dev.fd, V4L2_MEMORY_MMAP, dev.buffers.size(), dev.path)),
+                              dropPolicy, 0, timeoutMs);
+            allReplay = false;
+        }
+    }
+    std::unique_ptr<LatencyCsv> latencyCsv;
+    if (!latencyCsvPath.empty()) latencyCsv.reset(new LatencyCsv(latencyCsvPath));
+    auto startTime = std::chrono::steady_clock::now();
+    double nextLatencyWindow = latencyInterval;
+    if (preTrigger > 0) signal(SIGUSR1, requestTrigger);
+    capture.start();
+    if (headless) recordHeadless(devices, capture, lowLatency, allReplay, duration);
+
+    // Main loop
+    bool running = !headless;
+    while (running) {
+        // Handle SDL events
+        SDL_Event e;
+        while (SDL_PollEvent(&e)) {
+            if (e.type == SDL_EVENT_QUIT) running = false;
+            if (e.type == SDL_EVENT_KEY_DOWN && e.key.key == SDLK_T && preTrigger > 0) triggerRequested = 1;
+        }
+
+        if (triggerRequested) triggerEvents(devices);
+
+        // Take the next frame from each device, or in low-latency mode the
+        // newest one with the older ones requeued at once; a device without
+        // a new frame keeps showing its last one
+        bool updated = false;
+        for (size_t i = 0; i < devices.size(); i++) {
+            Device& dev = devices[i];
+            CapturedFrame frame;
+            bool got = lowLatency ? capture.acquireLatest(i, frame) : capture.acquire(i, frame);
+            if (dev.mjpeg) {
+                // Compressed frames go to the decode pool; show whatever is
+                // next in sequence order once it is ready
+                if (got) {
+                    if (dev.eventRecorder) {
+                        dev.eventRecorder->write(dev.buffers[frame.index].start, frame.bytesused, frame.timestamp);
+                    } else {
+                        dev.recorder->write(dev.buffers[frame.index].start, frame.bytesused);
+                    }
+                    if (dev.publisher) {
+                        dev.publisher->publish(dev.buffers[frame.index].start, frame.bytesused, frame.sequence,
+                                               frame.timestamp);
+                    }
+                    dev.mjpeg->submit(dev.buffers[frame.index].start, frame.bytesused, frame.sequence,
+                                      frame.timestamp);
+                    capture.release(i, frame);
+                }
+                DecodedFrame decoded;
+                bool haveDecoded = false;
+                while (dev.mjpeg->next(decoded)) haveDecoded = true;
+                if (!haveDecoded) continue;
+                int64_t captureUs = LatencyTracker::toUs(decoded.timestamp);
+                dev.latency->record(STAGE_ACQUIRE, captureUs);
+                if (decoded.width == static_cast<int>(dev.fmt.fmt.pix.width) &&
+                    decoded.height == static_cast<int>(dev.fmt.fmt.pix.height)) {
+                    uploadTexture(dev.tex, dev.textureFormat, textureUpload, decoded.rgba.get(), decoded.width * 4,
+                                  decoded.width, decoded.height, dev.uploadStats);
+                }
+                dev.latency->record(STAGE_UPLOAD, captureUs);
+                dev.uploadedCaptureUs = captureUs;
+                dev.presentPending = true;
+                dev.haveFrame = true;
+                updated = true;
+                continue;
+            }
+            if (!got) continue;
+            int64_t captureUs = LatencyTracker::toUs(frame.timestamp);
+            dev.latency->record(STAGE_ACQUIRE, captureUs);
+
+            // Queue the frame for the recorder; dropped if compression or the disk falls behind
+            if (dev.losslessRecorder) {
+                dev.losslessRecorder->write(dev.buffers[frame.index].start, frame.bytesused, frame.sequence,
+                                            frame.timestamp);
+            } else if (dev.eventRecorder) {
+                dev.eventRecorder->write(dev.buffers[frame.index].start, frame.bytesused, frame.timestamp);
+            } else if (dev.recorder) {
+                dev.recorder->write(dev.buffers[frame.index].start, frame.bytesused);
+            }
+            if (dev.publisher) {
+                dev.publisher->publish(dev.buffers[frame.index].start, frame.bytesused, frame.sequence,
+                                       frame.timestamp);
+            }
+
+            // Update SDL texture
+            uploadTexture(dev.tex, dev.textureFormat, textureUpload, dev.buffers[frame.index].start,
+                          dev.fmt.fmt.pix.bytesperline, dev.fmt.fmt.pix.width, dev.fmt.fmt.pix.height,
+                          dev.uploadStats);
+            dev.latency->record(STAGE_UPLOAD, captureUs);
+            dev.uploadedCaptureUs = captureUs;
+            dev.presentPending = true;
+
+            // Hand the buffer back to the capture thread for re-queueing
+            capture.release(i, frame);
+            dev.haveFrame = true;
+            updated = true;
+        }
+        if (!updated) {
+            // A replay-only run ends once every file has been shown
+            bool finished = allReplay;
+            for (size_t i = 0; i < devices.size() && finished; i++) {
+                finished = capture.stats(i).ended && capture.pending(i) == 0;
+            }
+            if (finished) break;
+            SDL_Delay(1);
+            continue;
+        }
+
+        SDL_RenderClear(ren);
+        for (size_t i = 0; i < devices.size(); i++) {
+            if (!devices[i].haveFrame) continue;
+            SDL_FRect dst = {static_cast<float>((i % columns) * tileWidth), static_cast<float>((i / columns) * tileHeight),
+                             static_cast<float>(tileWidth), static_cast<float>(tileHeight)};
+            SDL_RenderTexture(ren, devices[i].tex, nullptr, &dst);
+        }
+        SDL_RenderPresent(ren);
+        int64_t presentedUs = LatencyTracker::nowUs();
+        for (auto& dev : devices) {
+            if (!dev.presentPending) continue;
+            dev.latency->record(STAGE_PRESENT, dev.uploadedCaptureUs, presentedUs);
+            dev.presentPending = false;
+        }
+
+        double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        if (latencyCsv && now >= nextLatencyWindow) {
+            for (auto& dev : devices) dev.latency->writeWindow(*latencyCsv, now);
+            nextLatencyWindow = now + latencyInterval;
+        }
+    }
+    capture.stop();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    for (auto& dev : devices) {
+        dev.latency->print();
+        if (latencyCsv) {
+            dev.latency->writeWindow(*latencyCsv, elapsed);
+            dev.latency->writeTotals(*latencyCsv, elapsed);
+        }
+    }
+    for (size_t i = 0; i < devices.size(); i++) {
+        capture.stats(i).print(devices[i].path.c_str());
+        if (!headless) devices[i].uploadStats.print(devices[i].path.c_str(), textureUpload);
+        if (devices[i].replay) {
+            printf("%s: %.1f frames/s rendered over %.1f s\n", devices[i].path.c_str(),
+                   capture.stats(i).rendered / elapsed, elapsed);
+        }
+        if (devices[i].mjpeg) devices[i].mjpeg->stats.print(("MJPEG " + devices[i].path).c_str());
+        if (devices[i].publisher) devices[i].publisher->print(("Bus " + devices[i].path).c_str());
+    }
+    // Whole process, capture and decode threads included
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    double cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec +
+                        usage.ru_stime.tv_usec * 1e-6;
+    printf("CPU: %.1f%% of one core over %.1f s\n", elapsed > 0 ? cpuSeconds / elapsed * 100.0 : 0.0, elapsed);
+
+    // Cleanup
+    if (!headless) {
+        for (auto& dev : devices) SDL_DestroyTexture(dev.tex);
+        SDL_DestroyRenderer(ren);
+        SDL_DestroyWindow(win);
+        SDL_Quit();
+    }
+
+    for (auto& dev : devices) {
+        std::string label = "Recording " + dev.path;
+        if (dev.losslessRecorder) {
+            dev.losslessRecorder->close();
+            uint64_t raw = dev.losslessRecorder->stats.rawBytes;
+            printf("%s: %zu frames, %llu dropped before compression, ratio %.2fx\n", label.c_str(),
+                   dev.losslessRecorder->framesRecorded(),
+                   static_cast<unsigned long long>(dev.losslessRecorder->stats.framesDropped.load()),
+                   raw ? static_cast<double>(raw) / dev.losslessRecorder->compressedBytes() : 0.0);
+            dev.losslessRecorder->writerStats().print(label.c_str());
+        } else if (dev.eventRecorder) {
+            dev.eventRecorder->close();
+            dev.eventRecorder->print(label.c_str());
+        } else if (dev.recorder) {
+            dev.recorder->close();
+            dev.recorder->print(label.c_str());
+        }
+        if (!dev.replay) closeDevice(dev);
+    }
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,125 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+// Frame uploads into SDL streaming textures.
+//
+//   Update - SDL_UpdateTexture: SDL copies the frame into its own staging
+//            memory (or into a converting shadow texture) before the
+//            renderer uploads it.
+//   Lock   - SDL_LockTexture: the frame is copied once, straight into the
+//            memory the renderer uploads from, and SDL_UnlockTexture hands
+//            it over.
+//
+// Which one saves a copy depends on the renderer, hence the per-frame
+// timing kept in TextureUploadStats.
+//
+// Locked planes follow SDL's layout, not V4L2's: chroma planes come right
+// after the luma plane, with half its pitch (IYUV, YV12) or the same pitch
+// rounded up to whole CbCr pairs (NV12). Rows are copied one by one only
+// when the pitches differ.
+
+#include <SDL3/SDL.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+enum class TextureUpload {
+    Update,  // SDL_UpdateTexture
+    Lock,    // SDL_LockTexture + direct write
+};
+
+inline const char* textureUploadName(TextureUpload mode) {
+    return mode == TextureUpload::Lock ? "lock" : "update";
+}
+
+struct TextureUploadStats {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;      // frame bytes handed to SDL
+    double seconds = 0.0;    // in the upload call(s) on the render thread
+    double maxSeconds = 0.0;
+
+    void print(const char* label, TextureUpload mode) const {
+        printf("%s: %s upload, %llu frames, %.3f ms per frame (max %.3f ms), %.1f MB/s through the render thread\n",
+               label, textureUploadName(mode), static_cast<unsigned long long>(frames),
+               frames ? seconds * 1e3 / frames : 0.0, maxSeconds * 1e3, seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+    }
+};
+
+// Copies `rows` rows of `rowBytes` between buffers with their own pitches
+inline void copyPlane(uint8_t* dst, int dstPitch, const uint8_t* src, int srcPitch, size_t rowBytes, int rows) {
+    if (rows <= 0) return;
+    if (dstPitch == srcPitch) {
+        memcpy(dst, src, static_cast<size_t>(rows - 1) * srcPitch + rowBytes);
+        return;
+    }
+    for (int y = 0; y < rows; y++) {
+        memcpy(dst + static_cast<size_t>(y) * dstPitch, src + static_cast<size_t>(y) * srcPitch, rowBytes);
+    }
+}
+
+// Uploads one width x height frame of `format` laid out V4L2-style: planes
+// back to back, chroma pitches derived from `srcPitch`. False on SDL error.
+inline bool uploadTexture(SDL_Texture* tex, SDL_PixelFormat format, TextureUpload mode, const void* pixels,
+                          int srcPitch, int width, int height, TextureUploadStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+    size_t bytes = static_cast<size_t>(srcPitch) * height;
+    if (format == SDL_PIXELFORMAT_NV12) bytes += static_cast<size_t>(srcPitch) * chromaHeight;
+    if (format == SDL_PIXELFORMAT_IYUV || format == SDL_PIXELFORMAT_YV12) {
+        bytes += static_cast<size_t>(srcPitch / 2) * chromaHeight * 2;
+    }
+
+    bool ok;
+    if (mode == TextureUpload::Update) {
+        ok = SDL_UpdateTexture(tex, nullptr, pixels, srcPitch);
+    } else {
+        void* locked;
+        int pitch;
+        ok = SDL_LockTexture(tex, nullptr, &locked, &pitch);
+        if (ok) {
+            const uint8_t* src = static_cast<const uint8_t*>(pixels);
+            uint8_t* dst = static_cast<uint8_t*>(locked);
+            switch (format) {
+            case SDL_PIXELFORMAT_NV12: {
+                copyPlane(dst, pitch, src, srcPitch, width, height);
+                const int chromaPitch = 2 * ((pitch + 1) / 2);
+                copyPlane(dst + static_cast<size_t>(pitch) * height, chromaPitch,
+                          src + static_cast<size_t>(srcPitch) * height, srcPitch, 2 * chromaWidth, chromaHeight);
+                break;
+            }
+            case SDL_PIXELFORMAT_IYUV:
+            case SDL_PIXELFORMAT_YV12: {
+                // Both chroma planes are copied in the order they arrive
+                copyPlane(dst, pitch, src, srcPitch, width, height);
+                const int chromaPitch = (pitch + 1) / 2;
+                const int srcChromaPitch = srcPitch / 2;
+                dst += static_cast<size_t>(pitch) * height;
+                src += static_cast<size_t>(srcPitch) * height;
+                for (int plane = 0; plane < 2; plane++) {
+                    copyPlane(dst, chromaPitch, src, srcChromaPitch, chromaWidth, chromaHeight);
+                    dst += static_cast<size_t>(chromaPitch) * chromaHeight;
+                    src += static_cast<size_t>(srcChromaPitch) * chromaHeight;
+                }
+                break;
+            }
+            default:
+                // Packed formats: one plane of whole pixels
+                copyPlane(dst, pitch, src, srcPitch, static_cast<size_t>(width) * SDL_BYTESPERPIXEL(format), height);
+                break;
+            }
+            SDL_UnlockTexture(tex);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.frames++;
+    stats.bytes += bytes;
+    stats.seconds += seconds;
+    if (seconds > stats.maxSeconds) stats.maxSeconds = seconds;
+    return ok;
+}
+
+#endif // TEXTURE_UPLOAD_H
@@ -0,0 +1,156 @@
+#ifndef EXTERNAL_MEMORY_H
+#define EXTERNAL_MEMORY_H
+
+// Imports capture memory into Vulkan buffers so the GPU can read captured
+// frames without a CPU copy: either dma-bufs exported by the V4L2 driver,
+// or host allocations the driver DMAs into (USERPTR).
+//
+// The import helpers return false (and leave nothing to clean up) if the
+// driver refuses the import; callers then fall back to the staging copy path.
+
+#include <vulkan/vulkan.h>
+
+#include <unistd.h>
+
+struct ImportedBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+};
+
+inline void destroyImportedBuffer(VkDevice device, ImportedBuffer& imported) {
+    vkDestroyBuffer(device, imported.buffer, nullptr);
+    vkFreeMemory(device, imported.memory, nullptr);
+    imported = ImportedBuffer{};
+}
+
+// Imports a dma-buf fd (from VIDIOC_EXPBUF) as a storage buffer of `size`
+// bytes. Requires VK_KHR_external_memory_fd and VK_EXT_external_memory_dma_buf.
+// On success Vulkan owns the fd; on failure the fd is closed.
+inline bool importDmabufBuffer(VkDevice device, int fd, VkDeviceSize size, ImportedBuffer& out) {
+    auto getMemoryFdProperties = reinterpret_cast<PFN_vkGetMemoryFdPropertiesKHR>(
+        vkGetDeviceProcAddr(device, "vkGetMemoryFdPropertiesKHR"));
+    if (!getMemoryFdProperties) {
+        close(fd);
+        return false;
+    }
+
+    VkExternalMemoryBufferCreateInfo externalInfo{};
+    externalInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+    externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = &externalInfo;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &out.buffer) != VK_SUCCESS) {
+        close(fd);
+        return false;
+    }
+
+    VkMemoryFdPropertiesKHR fdProps{};
+    fdProps.sType = VK_STRUCTURE_TYPE_MEMORY_FD_PROPERTIES_KHR;
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(device, out.buffer, &memReqs);
+    uint32_t typeBits = 0;
+    if (getMemoryFdProperties(device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT, fd, &fdProps) == VK_SUCCESS) {
+        typeBits = fdProps.memoryTypeBits & memReqs.memoryTypeBits;
+    }
+    if (typeBits == 0) {
+        vkDestroyBuffer(device, out.buffer, nullptr);
+        out.buffer = VK_NULL_HANDLE;
+        close(fd);
+        return false;
+    }
+    uint32_t memTypeIndex = 0;
+    while (!(typeBits & (1u << memTypeIndex))) memTypeIndex++;
+
+    VkImportMemoryFdInfoKHR importInfo{};
+    importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR;
+    importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+    importInfo.fd = fd;
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = &importInfo;
+    allocInfo.allocationSize = memReqs.size;
+    allocInfo.memoryTypeIndex = memTypeIndex;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &out.memory) != VK_SUCCESS) {
+        vkDestroyBuffer(device, out.buffer, nullptr);
+        out.buffer = VK_NULL_HANDLE;
+        close(fd);
+        return false;
+    }
+    vkBindBufferMemory(device, out.buffer, out.memory, 0);
+    return true;
+}
+
+// Imports `size` bytes of host memory at `ptr` as a storage buffer. Both
+// must be multiples of minImportedHostPointerAlignment. Requires
+// VK_EXT_external_memory_host. The memory stays owned by the caller and
+// must outlive the buffer.
+inline bool importHostPointerBuffer(VkDevice device, void* ptr, VkDeviceSize size, ImportedBuffer& out) {
+    auto getHostPointerProperties = reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(
+        vkGetDeviceProcAddr(device, "vkGetMemoryHostPointerPropertiesEXT"));
+    if (!getHostPointerProperties) return false;
+
+    VkExternalMemoryBufferCreateInfo externalInfo{};
+    externalInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+    externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = &externalInfo;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &out.buffer) != VK_SUCCESS) return false;
+
+    VkMemoryHostPointerPropertiesEXT hostProps{};
+    hostProps.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(device, out.buffer, &memReqs);
+    uint32_t typeBits = 0;
+    if (getHostPointerProperties(device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, ptr, &hostProps) == VK_SUCCESS) {
+        typeBits = hostProps.memoryTypeBits & memReqs.memoryTypeBits;
+    }
+    if (typeBits == 0 || memReqs.size > size) {
+        vkDestroyBuffer(device, out.buffer, nullptr);
+        out.buffer = VK_NULL_HANDLE;
+        return false;
+    }
+    uint32_t memTypeIndex = 0;
+    while (!(typeBits & (1u << memTypeIndex))) memTypeIndex++;
+
+    VkImportMemoryHostPointerInfoEXT importInfo{};
+    importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+    importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    importInfo.pHostPointer = ptr;
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = &importInfo;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memTypeIndex;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &out.memory) != VK_SUCCESS) {
+        vkDestroyBuffer(device, out.buffer, nullptr);
+        out.buffer = VK_NULL_HANDLE;
+        return false;
+    }
+    vkBindBufferMemory(device, out.buffer, out.memory, 0);
+    return true;
+}
+
+// Alignment required for host pointer imports (0 if the extension is absent)
+inline VkDeviceSize hostPointerImportAlignment(VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProps{};
+    hostProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 props{};
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props.pNext = &hostProps;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &props);
+    return hostProps.minImportedHostPointerAlignment;
+}
+
+#endif // EXTERNAL_MEMORY_H
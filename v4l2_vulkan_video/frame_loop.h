@@ -0,0 +1,497 @@
+#ifndef FRAME_LOOP_H
+#define FRAME_LOOP_H
+
+// Vulkan bring-up and per-frame plumbing for a render loop that presents to
+// a window: the device and its queues, the swapchain with its render pass
+// and framebuffers, and the frame slots that keep up to N frames in flight.
+//
+// A frame goes through FrameSlots in this order:
+//   retire()/acquireStaging()  recycle finished staging slots, without blocking if possible
+//   wait()                     the GPU is done with this frame slot
+//   acquireImage(), begin()    record into the slot's command buffer (skip the
+//                              frame if no image was acquired)
+//   submit(), present()        and advance() to the next slot
+// Staging slots are owned by submission serials (see staging_ring.h); the
+// frame slots report every fence they see signalled to the ring.
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "frame_stats.h"
+#include "present_wait.h"
+#include "staging_ring.h"
+
+// Logical device with a graphics and a present queue (often the same
+// family), and a resettable command pool on the graphics family
+struct DisplayDevice {
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue graphicsQueue = VK_NULL_HANDLE;
+    VkQueue presentQueue = VK_NULL_HANDLE;
+    uint32_t graphicsFamily = 0;
+    uint32_t presentFamily = 0;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    bool timestamps = false;    // the graphics queue can write GPU timestamps
+
+    // `pNext` is the feature chain for VkDeviceCreateInfo, or null
+    void create(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, const std::vector<const char*>& extensions,
+                const void* pNext) {
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+        int graphics = -1, present = -1;
+        for (uint32_t i = 0; i < queueFamilyCount; i++) {
+            if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) graphics = i;
+            VkBool32 presentSupport = false;
+            vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+            if (presentSupport) present = i;
+            if (graphics != -1 && present != -1) break;
+        }
+        graphicsFamily = graphics;
+        presentFamily = present;
+        timestamps = queueFamilies[graphicsFamily].timestampValidBits != 0;
+
+        float queuePriority = 1.0f;
+        VkDeviceQueueCreateInfo queueCreateInfos[2]{};
+        queueCreateInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfos[0].queueFamilyIndex = graphicsFamily;
+        queueCreateInfos[0].queueCount = 1;
+        queueCreateInfos[0].pQueuePriorities = &queuePriority;
+        uint32_t queueCount = 1;
+        if (graphicsFamily != presentFamily) {
+            queueCreateInfos[1] = queueCreateInfos[0];
+            queueCreateInfos[1].queueFamilyIndex = presentFamily;
+            queueCount = 2;
+        }
+        VkDeviceCreateInfo deviceCreateInfo{};
+        deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceCreateInfo.pNext = pNext;
+        deviceCreateInfo.queueCreateInfoCount = queueCount;
+        deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
+        deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
+        vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device);
+        vkGetDeviceQueue(device, graphicsFamily, 0, &graphicsQueue);
+        vkGetDeviceQueue(device, presentFamily, 0, &presentQueue);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = graphicsFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
+    }
+
+    void destroy() {
+        if (!device) return;
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        vkDestroyDevice(device, nullptr);
+        device = VK_NULL_HANDLE;
+    }
+};
+
+// Swapchain for a window, with one color render pass (cleared to black), a
+// framebuffer per image and a semaphore per image that the present waits on.
+// The render-finished semaphores follow the images, not the frame slots: a
+// slot's fence shows its submit is done, not that the present which waits on
+// the semaphore has consumed it.
+class SwapchainTarget {
+public:
+    // Images of `extent`, the size of the window. `lowLatency` asks for MAILBOX.
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkExtent2D extent,
+                bool lowLatency) {
+        this->device = device;
+        this->physicalDevice = physicalDevice;
+        this->surface = surface;
+        size = extent;
+        uint32_t formatCount;
+        vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, nullptr);
+        std::vector<VkSurfaceFormatKHR> formats(formatCount);
+        vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, formats.data());
+        surfaceFormat = formats[0];
+        for (const auto& format : formats) {
+            if (format.format == VK_FORMAT_B8G8R8A8_UNORM) {
+                surfaceFormat = format;
+                break;
+            }
+        }
+
+        presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        if (lowLatency) {
+            // MAILBOX replaces a queued image instead of waiting behind it, so a
+            // present never adds a refresh interval of latency. FIFO is the only
+            // mode every surface supports.
+            uint32_t modeCount = 0;
+            vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &modeCount, nullptr);
+            std::vector<VkPresentModeKHR> presentModes(modeCount);
+            vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &modeCount, presentModes.data());
+            if (std::find(presentModes.begin(), presentModes.end(), VK_PRESENT_MODE_MAILBOX_KHR) != presentModes.end()) {
+                presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            } else {
+                std::cout << "MAILBOX present mode not supported, using FIFO" << std::endl;
+            }
+        }
+        std::cout << "Present mode: " << (presentMode == VK_PRESENT_MODE_MAILBOX_KHR ? "MAILBOX" : "FIFO") << std::endl;
+        createSwapchain(VK_NULL_HANDLE);
+
+        VkAttachmentDescription colorAttachment{};
+        colorAttachment.format = surfaceFormat.format;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        VkAttachmentReference colorAttachmentRef{};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+        // Wait for the acquired swapchain image before writing to it
+        VkSubpassDependency dependency{};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+        vkCreateRenderPass(device, &renderPassInfo, nullptr, &pass);
+        createFramebuffers();
+    }
+
+    // Replaces an out-of-date or suboptimal swapchain with one of the same
+    // size, format and present mode. The render pass, and every pipeline
+    // built against it, stays valid. `timer` is moved to the new swapchain.
+    void recreate(PresentTimer* timer = nullptr) {
+        vkDeviceWaitIdle(device);
+        destroyImages();
+        VkSwapchainKHR old = chain;
+        createSwapchain(old);
+        vkDestroySwapchainKHR(device, old, nullptr);
+        createFramebuffers();
+        if (timer && timer->enabled()) timer->retarget(chain);
+        recreated++;
+    }
+
+    void destroy() {
+        if (!chain) return;
+        destroyImages();
+        vkDestroyRenderPass(device, pass, nullptr);
+        vkDestroySwapchainKHR(device, chain, nullptr);
+        chain = VK_NULL_HANDLE;
+        if (recreated) std::cout << "Swapchain recreated " << recreated << " times" << std::endl;
+    }
+
+    VkSwapchainKHR swapchain() const { return chain; }
+    VkRenderPass renderPass() const { return pass; }
+    VkExtent2D extent() const { return size; }
+    // Signalled by the submit that renders `imageIndex`, waited on by its present
+    VkSemaphore renderFinished(uint32_t imageIndex) const { return renderDone[imageIndex]; }
+
+    void beginRenderPass(VkCommandBuffer cmd, uint32_t imageIndex) const {
+        VkRenderPassBeginInfo rpInfo{};
+        rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        rpInfo.renderPass = pass;
+        rpInfo.framebuffer = framebuffers[imageIndex];
+        rpInfo.renderArea.extent = size;
+        VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+        rpInfo.clearValueCount = 1;
+        rpInfo.pClearValues = &clearColor;
+        vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+private:
+    void createSwapchain(VkSwapchainKHR old) {
+        VkSurfaceCapabilitiesKHR capabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
+        VkSwapchainCreateInfoKHR swapchainInfo{};
+        swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+        swapchainInfo.surface = surface;
+        swapchainInfo.minImageCount = 2;
+        if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+            swapchainInfo.minImageCount = std::max(3u, capabilities.minImageCount);
+            if (capabilities.maxImageCount) {
+                swapchainInfo.minImageCount = std::min(swapchainInfo.minImageCount, capabilities.maxImageCount);
+            }
+        }
+        swapchainInfo.imageFormat = surfaceFormat.format;
+        swapchainInfo.imageColorSpace = surfaceFormat.colorSpace;
+        swapchainInfo.imageExtent = size;
+        swapchainInfo.imageArrayLayers = 1;
+        swapchainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        swapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        swapchainInfo.preTransform = capabilities.currentTransform;
+        swapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+        swapchainInfo.presentMode = presentMode;
+        swapchainInfo.oldSwapchain = old;
+        vkCreateSwapchainKHR(device, &swapchainInfo, nullptr, &chain);
+    }
+
+    void createFramebuffers() {
+        uint32_t imageCount;
+        vkGetSwapchainImagesKHR(device, chain, &imageCount, nullptr);
+        std::vector<VkImage> images(imageCount);
+        vkGetSwapchainImagesKHR(device, chain, &imageCount, images.data());
+        views.resize(imageCount);
+        framebuffers.resize(imageCount);
+        renderDone.resize(imageCount);
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        for (size_t i = 0; i < imageCount; i++) {
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = images[i];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = surfaceFormat.format;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.layerCount = 1;
+            vkCreateImageView(device, &viewInfo, nullptr, &views[i]);
+
+            VkFramebufferCreateInfo fbInfo{};
+            fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            fbInfo.renderPass = pass;
+            fbInfo.attachmentCount = 1;
+            fbInfo.pAttachments = &views[i];
+            fbInfo.width = size.width;
+            fbInfo.height = size.height;
+            fbInfo.layers = 1;
+            vkCreateFramebuffer(device, &fbInfo, nullptr, &framebuffers[i]);
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderDone[i]);
+        }
+    }
+
+    void destroyImages() {
+        for (auto fb : framebuffers) vkDestroyFramebuffer(device, fb, nullptr);
+        for (auto iv : views) vkDestroyImageView(device, iv, nullptr);
+        for (auto s : renderDone) vkDestroySemaphore(device, s, nullptr);
+        framebuffers.clear();
+        views.clear();
+        renderDone.clear();
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    VkSurfaceFormatKHR surfaceFormat{};
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    VkSwapchainKHR chain = VK_NULL_HANDLE;
+    VkRenderPass pass = VK_NULL_HANDLE;
+    VkExtent2D size{};
+    std::vector<VkImageView> views;
+    std::vector<VkFramebuffer> framebuffers;
+    std::vector<VkSemaphore> renderDone;
+    uint32_t recreated = 0;
+};
+
+// Command buffer, image-acquired semaphore, fence and two GPU timestamps
+// (start and end of the command buffer) for each frame in flight
+class FrameSlots {
+public:
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, uint32_t count,
+                bool timestamps) {
+        this->device = device;
+        this->commandPool = commandPool;
+        gpuTimestamps = timestamps;
+        slot = 0;
+        submitSerial = 0;
+        commandBuffers.resize(count);
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = count;
+        vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data());
+
+        imageAvailable.resize(count);
+        fences.resize(count);
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        for (uint32_t i = 0; i < count; i++) {
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailable[i]);
+            vkCreateFence(device, &fenceInfo, nullptr, &fences[i]);
+        }
+        serials.assign(count, 0);
+        hasTimestamps.assign(count, false);
+
+        VkPhysicalDeviceProperties deviceProps;
+        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProps);
+        period = deviceProps.limits.timestampPeriod;
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = 2 * count;
+        vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampPool);
+    }
+
+    void destroy() {
+        if (!timestampPool) return;
+        vkDestroyQueryPool(device, timestampPool, nullptr);
+        for (size_t i = 0; i < fences.size(); i++) {
+            vkDestroySemaphore(device, imageAvailable[i], nullptr);
+            vkDestroyFence(device, fences[i], nullptr);
+        }
+        vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+        timestampPool = VK_NULL_HANDLE;
+    }
+
+    uint32_t current() const { return slot; }
+    uint32_t count() const { return static_cast<uint32_t>(fences.size()); }
+    // Nanoseconds per timestamp tick, 0 without GPU timestamps
+    float timestampPeriod() const { return gpuTimestamps ? period : 0.0f; }
+
+    // Retire finished frames oldest first, without blocking
+    void retire(StagingRing& staging) {
+        for (uint32_t i = 0; i < count(); i++) {
+            uint32_t s = (slot + i) % count();
+            if (vkGetFenceStatus(device, fences[s]) != VK_SUCCESS) break;
+            staging.complete(serials[s]);
+        }
+    }
+
+    // retire(), then a staging slot. If every slot is still being read, the
+    // oldest frame in flight (the one this frame slot last submitted) frees
+    // the oldest one. Returns the seconds spent waiting for it.
+    double acquireStaging(StagingRing& staging, uint32_t& stagingSlot) {
+        retire(staging);
+        if (staging.acquire(stagingSlot)) return 0.0;
+        double waited = wait(staging);
+        staging.acquire(stagingSlot);
+        return waited;
+    }
+
+    // Waits until the GPU is done with this frame slot and recycles its
+    // staging slot. Returns the seconds spent waiting.
+    double wait(StagingRing& staging) {
+        auto waitStart = FrameStats::Clock::now();
+        vkWaitForFences(device, 1, &fences[slot], VK_TRUE, UINT64_MAX);
+        staging.complete(serials[slot]);
+        return std::chrono::duration<double>(FrameStats::Clock::now() - waitStart).count();
+    }
+
+    // GPU time of this slot's last command buffer; valid after wait()
+    double gpuSeconds() const {
+        if (!gpuTimestamps || !hasTimestamps[slot]) return 0.0;
+        uint64_t ticks[2];
+        if (vkGetQueryPoolResults(device, timestampPool, slot * 2, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+                                  VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            return 0.0;
+        }
+        return (ticks[1] - ticks[0]) * period * 1e-9;
+    }
+
+    // Acquires the next image into `imageIndex`, signalling this slot's
+    // semaphore. False if there is none to render this frame: an out-of-date
+    // swapchain is recreated first (moving `timer` along). A suboptimal one
+    // still presents and is recreated by present().
+    bool acquireImage(SwapchainTarget& target, uint32_t& imageIndex, PresentTimer* timer = nullptr) {
+        VkResult result = vkAcquireNextImageKHR(device, target.swapchain(), UINT64_MAX, imageAvailable[slot],
+                                                VK_NULL_HANDLE, &imageIndex);
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) return true;
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            target.recreate(timer);
+            return false;
+        }
+        if (result == VK_NOT_READY || result == VK_TIMEOUT) return false;
+        throw std::runtime_error("vkAcquireNextImageKHR failed: " + std::to_string(result));
+    }
+
+    // Resets and begins this slot's command buffer, with the start timestamp
+    VkCommandBuffer begin() {
+        VkCommandBuffer cmd = commandBuffers[slot];
+        vkResetFences(device, 1, &fences[slot]);
+        vkResetCommandBuffer(cmd, 0);
+        VkCommandBufferBeginInfo cmdBeginInfo{};
+        cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(cmd, &cmdBeginInfo);
+        if (gpuTimestamps) {
+            vkCmdResetQueryPool(cmd, timestampPool, slot * 2, 2);
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, slot * 2);
+        }
+        return cmd;
+    }
+
+    // Ends and submits the command buffer; it waits for the acquired image
+    // and signals the present of `imageIndex`. Returns the submission's serial.
+    uint64_t submit(VkQueue queue, const SwapchainTarget& target, uint32_t imageIndex) {
+        VkCommandBuffer cmd = commandBuffers[slot];
+        if (gpuTimestamps) {
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, slot * 2 + 1);
+        }
+        vkEndCommandBuffer(cmd);
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        VkSubmitInfo submit{};
+        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit.waitSemaphoreCount = 1;
+        submit.pWaitSemaphores = &imageAvailable[slot];
+        submit.pWaitDstStageMask = &waitStage;
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &cmd;
+        submit.signalSemaphoreCount = 1;
+        VkSemaphore renderFinished = target.renderFinished(imageIndex);
+        submit.pSignalSemaphores = &renderFinished;
+        vkQueueSubmit(queue, 1, &submit, fences[slot]);
+        serials[slot] = ++submitSerial;
+        hasTimestamps[slot] = gpuTimestamps;
+        return submitSerial;
+    }
+
+    // `timer`, if given and enabled, tags the present with the capture time.
+    // An out-of-date or suboptimal swapchain is recreated afterwards.
+    void present(VkQueue queue, SwapchainTarget& target, uint32_t imageIndex, PresentTimer* timer = nullptr,
+                 int64_t captureUs = 0) {
+        VkSwapchainKHR swapchain = target.swapchain();
+        VkSemaphore renderFinished = target.renderFinished(imageIndex);
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = &renderFinished;
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = &swapchain;
+        presentInfo.pImageIndices = &imageIndex;
+        if (timer && timer->enabled()) timer->tag(presentInfo, captureUs);
+        VkResult result = vkQueuePresentKHR(queue, &presentInfo);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            target.recreate(timer);
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("vkQueuePresentKHR failed: " + std::to_string(result));
+        }
+    }
+
+    void advance() { slot = (slot + 1) % count(); }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<VkSemaphore> imageAvailable;
+    std::vector<VkFence> fences;
+    std::vector<uint64_t> serials;      // last submission of each slot, for staging slot ownership
+    std::vector<bool> hasTimestamps;
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    bool gpuTimestamps = false;
+    float period = 0.0f;
+    uint32_t slot = 0;
+    uint64_t submitSerial = 0;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+// Once-per-second frame pacing report for the render loop.
+//
+// cpu   - time the render thread spent converting, recording and submitting
+// wait  - time blocked on the in-flight fence of the frame slot being reused
+// gpu   - command buffer execution time from timestamp queries
+// skip  - captured frames passed over for a newer one (--low-latency)
+//
+// overlap is how much of the shorter of CPU and GPU work was hidden behind
+// the other: 0% when they run strictly one after another (wall = cpu + gpu),
+// 100% when the frame time is just max(cpu, gpu).
+//
+// printTotals() summarizes the whole run, for comparing upload paths.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+struct FrameStats {
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point periodStart = Clock::now();
+    int frames = 0;
+    double cpuSeconds = 0.0;
+    double waitSeconds = 0.0;
+    double gpuSeconds = 0.0;
+    uint64_t skippedAtStart = 0;
+
+    // Whole run
+    Clock::time_point runStart = Clock::now();
+    uint64_t runFrames = 0;
+    double runCpuSeconds = 0.0;
+
+    void addFrame(double cpu, double wait, double gpu) {
+        frames++;
+        runFrames++;
+        runCpuSeconds += cpu;
+        cpuSeconds += cpu;
+        waitSeconds += wait;
+        gpuSeconds += gpu;
+    }
+
+    // `skippedTotal` is the capture's running count of skipped frames
+    void reportIfDue(uint64_t skippedTotal) {
+        double wall = std::chrono::duration<double>(Clock::now() - periodStart).count();
+        if (wall < 1.0 || frames == 0) return;
+
+        double busyWall = cpuSeconds + waitSeconds;  // render thread time spent on frames
+        double shorter = std::min(cpuSeconds, gpuSeconds);
+        double overlap = shorter > 0.0 ? (cpuSeconds + gpuSeconds - busyWall) / shorter : 0.0;
+        overlap = std::clamp(overlap, 0.0, 1.0);
+        printf("%6.1f fps | cpu %6.2f ms | wait %6.2f ms | gpu %6.2f ms | overlap %3.0f%% | skip %3llu\n",
+               frames / wall, cpuSeconds * 1000.0 / frames, waitSeconds * 1000.0 / frames,
+               gpuSeconds * 1000.0 / frames, overlap * 100.0,
+               static_cast<unsigned long long>(skippedTotal - skippedAtStart));
+
+        periodStart = Clock::now();
+        frames = 0;
+        skippedAtStart = skippedTotal;
+        cpuSeconds = waitSeconds = gpuSeconds = 0.0;
+    }
+
+    void printTotals(const char* label) const {
+        double wall = std::chrono::duration<double>(Clock::now() - runStart).count();
+        if (runFrames == 0) return;
+        printf("%s: %.1f fps, cpu %.2f ms per frame over %llu frames\n", label, runFrames / wall,
+               runCpuSeconds * 1000.0 / runFrames, static_cast<unsigned long long>(runFrames));
+    }
+};
+
+#endif // FRAME_STATS_H
@@ -0,0 +1,162 @@
+#ifndef GPU_DECODE_H
+#define GPU_DECODE_H
+
+// Compute-shader decode of raw YUV frames into the RGBA video image.
+//
+// The raw V4L2 frame is bound as a storage buffer (binding 0) and the video
+// image as a storage image (binding 1). There is one descriptor set per
+// source buffer range so frames can be decoded from whichever buffer or
+// staging slot they landed in without rewriting descriptors. recordGpuDecode() transitions the
+// image to GENERAL, dispatches the decoder and leaves the image in
+// SHADER_READ_ONLY_OPTIMAL for the fullscreen draw.
+
+#include <vulkan/vulkan.h>
+
+#include <stdexcept>
+#include <vector>
+
+struct GpuDecodeParams {
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;        // bytes per source row
+    uint32_t chromaOffset;  // byte offset of the chroma plane (NV12 only)
+};
+
+struct GpuDecoder {
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> descriptorSets;  // one per source range
+    GpuDecodeParams params{};
+    uint32_t pixelsPerInvocation = 1;  // 2 for packed YUYV
+};
+
+inline GpuDecoder createGpuDecoder(VkDevice device, VkShaderModule shader, uint32_t pixelsPerInvocation,
+                                   const GpuDecodeParams& params, const std::vector<VkDescriptorBufferInfo>& sources,
+                                   VkImageView dstView) {
+    GpuDecoder decoder;
+    decoder.params = params;
+    decoder.pixelsPerInvocation = pixelsPerInvocation;
+
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &decoder.setLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create decode descriptor set layout");
+    }
+
+    VkPushConstantRange pushRange{};
+    pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushRange.size = sizeof(GpuDecodeParams);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &decoder.setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &decoder.pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create decode pipeline layout");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shader;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = decoder.pipelineLayout;
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &decoder.pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create decode pipeline");
+    }
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = static_cast<uint32_t>(sources.size());
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = static_cast<uint32_t>(sources.size());
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = static_cast<uint32_t>(sources.size());
+    vkCreateDescriptorPool(device, &poolInfo, nullptr, &decoder.descriptorPool);
+
+    std::vector<VkDescriptorSetLayout> layouts(sources.size(), decoder.setLayout);
+    decoder.descriptorSets.resize(sources.size());
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = decoder.descriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+    allocInfo.pSetLayouts = layouts.data();
+    vkAllocateDescriptorSets(device, &allocInfo, decoder.descriptorSets.data());
+
+    for (size_t i = 0; i < sources.size(); i++) {
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageView = dstView;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet writes[2]{};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = decoder.descriptorSets[i];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[0].descriptorCount = 1;
+        writes[0].pBufferInfo = &sources[i];
+        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstSet = decoder.descriptorSets[i];
+        writes[1].dstBinding = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].descriptorCount = 1;
+        writes[1].pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    }
+
+    return decoder;
+}
+
+inline void recordGpuDecode(VkCommandBuffer cmd, const GpuDecoder& decoder, size_t source, VkImage dstImage) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = dstImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, decoder.pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, decoder.pipelineLayout, 0, 1, &decoder.descriptorSets[source], 0, nullptr);
+    vkCmdPushConstants(cmd, decoder.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GpuDecodeParams), &decoder.params);
+    uint32_t columns = (decoder.params.width + decoder.pixelsPerInvocation - 1) / decoder.pixelsPerInvocation;
+    vkCmdDispatch(cmd, (columns + 15) / 16, (decoder.params.height + 15) / 16, 1);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+inline void destroyGpuDecoder(VkDevice device, GpuDecoder& decoder) {
+    vkDestroyDescriptorPool(device, decoder.descriptorPool, nullptr);
+    vkDestroyPipeline(device, decoder.pipeline, nullptr);
+    vkDestroyPipelineLayout(device, decoder.pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, decoder.setLayout, nullptr);
+}
+
+#endif // GPU_DECODE_H
@@ -0,0 +1,274 @@
+#ifndef HOST_UPLOAD_H
+#define HOST_UPLOAD_H
+
+// Uploads of CPU-converted RGBA frames that skip the staging buffer and
+// vkCmdCopyBufferToImage. On integrated GPUs and software rasterizers the
+// staging hop is a second full pass over host memory.
+//
+//   HostCopy - VK_EXT_host_image_copy: vkCopyMemoryToImageEXT writes the
+//              frame into an optimally tiled image on the CPU.
+//   Linear   - a LINEAR-tiled, host-visible image that the converter writes
+//              straight into and the fragment shader samples in GENERAL.
+//
+// There is one image per frame in flight: the CPU writes image i only after
+// the fence of frame slot i shows the GPU has stopped sampling it. Host
+// writes become visible to the GPU at the next vkQueueSubmit.
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+enum class UploadPath {
+    Staging,   // staging ring + vkCmdCopyBufferToImage
+    HostCopy,  // VK_EXT_host_image_copy
+    Linear,    // host-visible LINEAR image
+};
+
+inline const char* uploadPathName(UploadPath path) {
+    switch (path) {
+    case UploadPath::HostCopy: return "host image copy";
+    case UploadPath::Linear: return "linear image";
+    default: return "staging copy";
+    }
+}
+
+// Feature struct to chain into VkDeviceCreateInfo::pNext. Must not be moved
+// once chained.
+struct HostImageCopyFeatures {
+    VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopy{};
+
+    // True if the device supports the feature; the struct is then ready to
+    // enable it. The extension must be checked first.
+    bool query(VkPhysicalDevice physicalDevice) {
+        hostImageCopy.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &hostImageCopy;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+        return hostImageCopy.hostImageCopy;
+    }
+};
+
+class HostUploader {
+public:
+    // Creates `count` RGBA images of width x height for `path` (HostCopy or
+    // Linear). Returns false, with nothing left to clean up, if the device
+    // cannot do it; the caller then stays on the staging path.
+    bool init(VkDevice device, VkPhysicalDevice physicalDevice, UploadPath path, uint32_t width, uint32_t height,
+              uint32_t count) {
+        this->device = device;
+        this->width = width;
+        this->height = height;
+        if (path == UploadPath::HostCopy) {
+            copyMemoryToImage = reinterpret_cast<PFN_vkCopyMemoryToImageEXT>(
+                vkGetDeviceProcAddr(device, "vkCopyMemoryToImageEXT"));
+            transitionImageLayout = reinterpret_cast<PFN_vkTransitionImageLayoutEXT>(
+                vkGetDeviceProcAddr(device, "vkTransitionImageLayoutEXT"));
+            if (!copyMemoryToImage || !transitionImageLayout) return false;
+            imageLayout = hostCopyLayout(physicalDevice);
+        } else {
+            imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = FORMAT;
+        imageInfo.extent = {width, height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        VkMemoryPropertyFlags memoryFlags;
+        if (path == UploadPath::HostCopy) {
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            memoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        } else {
+            // The fragment shader samples with linear filtering
+            VkFormatProperties formatProps;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, FORMAT, &formatProps);
+            const VkFormatFeatureFlags needed =
+                VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+            if ((formatProps.linearTilingFeatures & needed) != needed) return false;
+            imageInfo.tiling = VK_IMAGE_TILING_LINEAR;
+            imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+            memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        }
+        VkImageFormatProperties limits;
+        if (vkGetPhysicalDeviceImageFormatProperties(physicalDevice, FORMAT, VK_IMAGE_TYPE_2D, imageInfo.tiling,
+                                                     imageInfo.usage, 0, &limits) != VK_SUCCESS ||
+            limits.maxExtent.width < width || limits.maxExtent.height < height) {
+            return false;
+        }
+
+        VkPhysicalDeviceMemoryProperties memProps;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+        for (uint32_t i = 0; i < count; i++) {
+            Image image;
+            if (vkCreateImage(device, &imageInfo, nullptr, &image.image) != VK_SUCCESS) {
+                destroy();
+                return false;
+            }
+            images.push_back(image);
+            Image& img = images.back();
+
+            VkMemoryRequirements memReqs;
+            vkGetImageMemoryRequirements(device, img.image, &memReqs);
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = memReqs.size;
+            allocInfo.memoryTypeIndex = UINT32_MAX;
+            for (uint32_t t = 0; t < memProps.memoryTypeCount; t++) {
+                if ((memReqs.memoryTypeBits & (1 << t)) &&
+                    (memProps.memoryTypes[t].propertyFlags & memoryFlags) == memoryFlags) {
+                    allocInfo.memoryTypeIndex = t;
+                    break;
+                }
+            }
+            if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+                vkAllocateMemory(device, &allocInfo, nullptr, &img.memory) != VK_SUCCESS) {
+                destroy();
+                return false;
+            }
+            vkBindImageMemory(device, img.image, img.memory, 0);
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = img.image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = FORMAT;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.layerCount = 1;
+            vkCreateImageView(device, &viewInfo, nullptr, &img.view);
+
+            if (path == UploadPath::HostCopy) {
+                // Host transitions need no command buffer and no GPU sync
+                VkHostImageLayoutTransitionInfoEXT transition{};
+                transition.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+                transition.image = img.image;
+                transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                transition.newLayout = imageLayout;
+                transition.subresourceRange = viewInfo.subresourceRange;
+                if (transitionImageLayout(device, 1, &transition) != VK_SUCCESS) {
+                    destroy();
+                    return false;
+                }
+            } else {
+                VkImageSubresource subresource{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+                VkSubresourceLayout layout;
+                vkGetImageSubresourceLayout(device, img.image, &subresource, &layout);
+                void* mapped;
+                vkMapMemory(device, img.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+                img.pixels = static_cast<uint8_t*>(mapped) + layout.offset;
+                img.rowPitch = static_cast<size_t>(layout.rowPitch);
+                img.needsTransition = true;
+            }
+        }
+        return true;
+    }
+
+    void destroy() {
+        for (auto& img : images) {
+            if (img.view) vkDestroyImageView(device, img.view, nullptr);
+            if (img.image) vkDestroyImage(device, img.image, nullptr);
+            if (img.memory) vkFreeMemory(device, img.memory, nullptr);
+        }
+        images.clear();
+    }
+
+    size_t count() const { return images.size(); }
+    VkImageView view(size_t i) const { return images[i].view; }
+    VkImageLayout layout() const { return imageLayout; }
+
+    // Linear: where the converter writes image i directly
+    uint8_t* pixels(size_t i) const { return images[i].pixels; }
+    size_t rowPitch(size_t i) const { return images[i].rowPitch; }
+
+    // HostCopy: writes a srcWidth x srcHeight RGBA frame (rows srcWidth
+    // pixels apart) into image i. Only the overlap with the image is copied;
+    // the rest of the image keeps what it had.
+    void copy(size_t i, const void* rgba, uint32_t srcWidth, uint32_t srcHeight) {
+        VkMemoryToImageCopyEXT region{};
+        region.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+        region.pHostPointer = rgba;
+        region.memoryRowLength = srcWidth;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {std::min(width, srcWidth), std::min(height, srcHeight), 1};
+        VkCopyMemoryToImageInfoEXT info{};
+        info.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+        info.dstImage = images[i].image;
+        info.dstImageLayout = imageLayout;
+        info.regionCount = 1;
+        info.pRegions = &region;
+        copyMemoryToImage(device, &info);
+    }
+
+    // Linear: records the one-time PREINITIALIZED -> GENERAL transition of
+    // image i into `cmd` the first time the image is drawn
+    void recordFirstUse(VkCommandBuffer cmd, size_t i) {
+        if (!images[i].needsTransition) return;
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = images[i].image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                             nullptr, 1, &barrier);
+        images[i].needsTransition = false;
+    }
+
+private:
+    static constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+    struct Image {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        uint8_t* pixels = nullptr;   // Linear only
+        size_t rowPitch = 0;
+        bool needsTransition = false;
+    };
+
+    // SHADER_READ_ONLY_OPTIMAL if host copies may target it, so the image
+    // never changes layout; GENERAL otherwise
+    static VkImageLayout hostCopyLayout(VkPhysicalDevice physicalDevice) {
+        VkPhysicalDeviceHostImageCopyPropertiesEXT copyProps{};
+        copyProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 props{};
+        props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        props.pNext = &copyProps;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &props);
+        std::vector<VkImageLayout> dstLayouts(copyProps.copyDstLayoutCount);
+        copyProps.pCopyDstLayouts = dstLayouts.data();
+        vkGetPhysicalDeviceProperties2(physicalDevice, &props);
+        for (VkImageLayout layout : dstLayouts) {
+            if (layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) return layout;
+        }
+        return VK_IMAGE_LAYOUT_GENERAL;
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkImageLayout imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    PFN_vkCopyMemoryToImageEXT copyMemoryToImage = nullptr;
+    PFN_vkTransitionImageLayoutEXT transitionImageLayout = nullptr;
+    std::vector<Image> images;
+};
+
+#endif // HOST_UPLOAD_H
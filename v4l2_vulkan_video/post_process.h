@@ -0,0 +1,681 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+// Chain of compute passes between the frame upload and the fullscreen draw.
+//
+//   blur     - separable Gaussian blur (a horizontal and a vertical pass)
+//   lanczos  - separable Lanczos-3 resample to --post-size, widened to the
+//              scale factor when downscaling so it also low-passes
+//   lut      - 3D LUT color grade from a .cube file, trilinearly filtered
+//
+// Every pass samples its source (binding 0) and writes a storage image
+// (binding 1); the LUT pass also samples the LUT (binding 2). The first pass
+// reads the video image the viewer uploaded, through an immutable YCbCr
+// sampler if that is how the viewer samples it, with one descriptor set per
+// possible input as in GpuDecoder. Intermediate passes ping-pong between two
+// images sized to the largest intermediate, each writing only the region it
+// needs; the last pass writes an output image of exactly its size, which the
+// draw samples instead of the video image.
+//
+// A timestamp after each pass gives its GPU time. collect() reads a frame
+// slot's timestamps once its fence has signaled.
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+enum class PostEffect { Blur, Lanczos, Lut };
+
+struct PostSettings {
+    std::vector<PostEffect> effects;  // --post, in chain order
+    float blurSigma = 1.5f;           // --blur-sigma, in source pixels
+    uint32_t scaleWidth = 0;          // --post-size; 0 = the window size
+    uint32_t scaleHeight = 0;
+    std::string lutPath;              // --lut: .cube file for the lut pass
+};
+
+// "blur,lanczos,lut" -> effects; throws on an unknown name
+inline std::vector<PostEffect> parsePostEffects(const std::string& list) {
+    std::vector<PostEffect> effects;
+    std::stringstream names(list);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        if (name == "blur") effects.push_back(PostEffect::Blur);
+        else if (name == "lanczos") effects.push_back(PostEffect::Lanczos);
+        else if (name == "lut") effects.push_back(PostEffect::Lut);
+        else throw std::runtime_error("Unknown post-processing pass: " + name);
+    }
+    return effects;
+}
+
+// Reads an Adobe .cube 3D LUT: `size` entries per axis, RGB triples with red
+// varying fastest. DOMAIN_MIN/MAX other than 0..1 are not supported.
+inline std::vector<float> loadCubeLut(const std::string& path, uint32_t& size) {
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Failed to open LUT: " + path);
+    std::vector<float> values;
+    size = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "LUT_3D_SIZE") {
+            fields >> size;
+        } else if (key == "LUT_1D_SIZE") {
+            throw std::runtime_error(path + ": 1D LUTs are not supported");
+        } else if (!key.empty() && (isdigit(static_cast<unsigned char>(key[0])) || key[0] == '-' || key[0] == '.')) {
+            float g, b;
+            fields >> g >> b;
+            values.push_back(std::stof(key));
+            values.push_back(g);
+            values.push_back(b);
+        }
+    }
+    if (size < 2 || values.size() != static_cast<size_t>(size) * size * size * 3) {
+        throw std::runtime_error(path + ": not a 3D .cube LUT");
+    }
+    return values;
+}
+
+// Push constants shared by every pass shader
+struct PostParams {
+    int32_t srcSize[2];   // valid region of the source
+    float srcScale[2];    // 1 / extent of the source image, for normalized lookups
+    int32_t dstSize[2];
+    float direction[2];   // (1, 0) horizontal pass, (0, 1) vertical pass
+    float param;          // blur sigma, Lanczos lobes or LUT size
+};
+
+// One viewer image the chain can start from, with the layout it is in
+struct PostInput {
+    VkImageView view;
+    VkImageLayout layout;
+};
+
+class PostProcessChain {
+public:
+    explicit operator bool() const { return !passes.empty(); }
+
+    // Builds the passes for `settings` on width x height frames. `loadShader`
+    // returns a module for a .spv file name; the chain destroys it.
+    // `inputSampler` is an immutable sampler for the inputs (YCbCr), whose
+    // bindings then take `inputDescriptorCount` descriptors; otherwise the
+    // chain's own linear sampler is used. `timestampPeriod` 0 disables timing.
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue queue,
+                const PostSettings& settings, const std::vector<PostInput>& inputs, const VkSampler* inputSampler,
+                uint32_t inputDescriptorCount, uint32_t width, uint32_t height, uint32_t frameSlots,
+                float timestampPeriod, const std::function<VkShaderModule(const std::string&)>& loadShader) {
+        this->device = device;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+        this->timestampPeriod = timestampPeriod;
+
+        // Expand the effects into passes, following the frame size through them
+        uint32_t w = width, h = height;
+        for (PostEffect effect : settings.effects) {
+            switch (effect) {
+            case PostEffect::Blur:
+                addPass("blur-h", "blur.spv", w, h, w, h, 1.0f, 0.0f, settings.blurSigma);
+                addPass("blur-v", "blur.spv", w, h, w, h, 0.0f, 1.0f, settings.blurSigma);
+                break;
+            case PostEffect::Lanczos: {
+                uint32_t outW = settings.scaleWidth, outH = settings.scaleHeight;
+                addPass("lanczos-h", "lanczos.spv", w, h, outW, h, 1.0f, 0.0f, 3.0f);
+                addPass("lanczos-v", "lanczos.spv", outW, h, outW, outH, 0.0f, 1.0f, 3.0f);
+                w = outW;
+                h = outH;
+                break;
+            }
+            case PostEffect::Lut:
+                if (!lutImage.image) createLut(physicalDevice, commandPool, queue, settings.lutPath);
+                addPass("lut", "lut.spv", w, h, w, h, 0.0f, 0.0f, static_cast<float>(lutSize));
+                break;
+            }
+        }
+        if (passes.empty()) return;
+
+        // Ping-pong between targets 0 and 1; the last pass writes target 2
+        uint32_t pingWidth = 1, pingHeight = 1;
+        for (size_t i = 0; i < passes.size(); i++) {
+            Pass& pass = passes[i];
+            pass.src = i == 0 ? -1 : passes[i - 1].dst;
+            pass.dst = i + 1 == passes.size() ? 2 : static_cast<int>(i % 2);
+            if (pass.dst != 2) {
+                pingWidth = std::max<uint32_t>(pingWidth, pass.params.dstSize[0]);
+                pingHeight = std::max<uint32_t>(pingHeight, pass.params.dstSize[1]);
+            }
+        }
+        if (passes.size() > 1) {
+            createTarget(targets[0], pingWidth, pingHeight);
+            if (passes.size() > 2) createTarget(targets[1], pingWidth, pingHeight);
+        }
+        createTarget(targets[2], passes.back().params.dstSize[0], passes.back().params.dstSize[1]);
+        for (size_t i = 0; i < passes.size(); i++) {
+            Pass& pass = passes[i];
+            if (pass.src < 0) {
+                pass.params.srcScale[0] = 1.0f / width;
+                pass.params.srcScale[1] = 1.0f / height;
+            } else {
+                pass.params.srcScale[0] = 1.0f / targets[pass.src].width;
+                pass.params.srcScale[1] = 1.0f / targets[pass.src].height;
+            }
+        }
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        if (vkCreateSampler(device, &samplerInfo, nullptr, &linearSampler) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create post-processing sampler");
+        }
+
+        // Layouts: the first pass may read through the immutable YCbCr sampler
+        inputLayout = createSetLayout(inputSampler);
+        passLayout = createSetLayout(nullptr);
+        for (int i = 0; i < 2; i++) {
+            VkPushConstantRange pushRange{};
+            pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            pushRange.size = sizeof(PostParams);
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = i == 0 ? &inputLayout : &passLayout;
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+            if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayouts[i]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create post-processing pipeline layout");
+            }
+        }
+
+        std::vector<std::pair<std::string, VkShaderModule>> modules;
+        for (size_t i = 0; i < passes.size(); i++) {
+            Pass& pass = passes[i];
+            pass.layout = pipelineLayouts[i == 0 ? 0 : 1];
+            auto found = std::find_if(modules.begin(), modules.end(),
+                                       [&pass](const std::pair<std::string, VkShaderModule>& m) {
+                                           return m.first == pass.shader;
+                                       });
+            if (found == modules.end()) {
+                modules.emplace_back(pass.shader, loadShader(pass.shader));
+                found = modules.end() - 1;
+            }
+            VkComputePipelineCreateInfo pipelineInfo{};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            pipelineInfo.stage.module = found->second;
+            pipelineInfo.stage.pName = "main";
+            pipelineInfo.layout = pass.layout;
+            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pass.pipeline) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("Failed to create " + pass.name + " pipeline");
+            }
+        }
+        for (auto& module : modules) vkDestroyShaderModule(device, module.second, nullptr);
+
+        // One set per input for the first pass, one per later pass; each set
+        // has a source, a destination and (unused outside lut) a LUT binding
+        const uint32_t setCount = static_cast<uint32_t>(inputs.size() + passes.size() - 1);
+        VkDescriptorPoolSize poolSizes[2]{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[0].descriptorCount = static_cast<uint32_t>(inputs.size()) * inputDescriptorCount +
+                                       static_cast<uint32_t>(passes.size() - 1) + setCount;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        poolSizes[1].descriptorCount = setCount;
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = poolSizes;
+        poolInfo.maxSets = setCount;
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create post-processing descriptor pool");
+        }
+        for (size_t i = 0; i < passes.size(); i++) {
+            Pass& pass = passes[i];
+            if (pass.src < 0) {
+                for (const PostInput& input : inputs) {
+                    pass.sets.push_back(createSet(inputLayout, input.view, input.layout, pass));
+                }
+            } else {
+                pass.sets.push_back(createSet(passLayout, targets[pass.src].view,
+                                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, pass));
+            }
+        }
+
+        // passes + 1 timestamps per frame slot: before the first pass and after each
+        if (timestampPeriod > 0) {
+            VkQueryPoolCreateInfo queryPoolInfo{};
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolInfo.queryCount = static_cast<uint32_t>(passes.size() + 1) * frameSlots;
+            if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+                this->timestampPeriod = 0;
+            }
+        }
+        slotRecorded.assign(frameSlots, false);
+        periodSeconds.assign(passes.size(), 0.0);
+        runSeconds.assign(passes.size(), 0.0);
+    }
+
+    void destroy() {
+        if (queryPool) vkDestroyQueryPool(device, queryPool, nullptr);
+        if (descriptorPool) vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        for (Pass& pass : passes) {
+            if (pass.pipeline) vkDestroyPipeline(device, pass.pipeline, nullptr);
+        }
+        for (VkPipelineLayout& layout : pipelineLayouts) {
+            if (layout) vkDestroyPipelineLayout(device, layout, nullptr);
+            layout = VK_NULL_HANDLE;
+        }
+        if (inputLayout) vkDestroyDescriptorSetLayout(device, inputLayout, nullptr);
+        if (passLayout) vkDestroyDescriptorSetLayout(device, passLayout, nullptr);
+        if (linearSampler) vkDestroySampler(device, linearSampler, nullptr);
+        for (Target& target : targets) destroyTarget(target);
+        destroyTarget(lutImage);
+        passes.clear();
+        queryPool = VK_NULL_HANDLE;
+        descriptorPool = VK_NULL_HANDLE;
+        inputLayout = VK_NULL_HANDLE;
+        passLayout = VK_NULL_HANDLE;
+        linearSampler = VK_NULL_HANDLE;
+    }
+
+    // The final image, in SHADER_READ_ONLY_OPTIMAL after record()
+    VkImageView outputView() const { return targets[2].view; }
+    uint32_t outputWidth() const { return targets[2].width; }
+    uint32_t outputHeight() const { return targets[2].height; }
+
+    // Records every pass on inputs[input], timed into frame slot `slot`.
+    // The input must have been written by a transfer, a compute shader or
+    // the host earlier in this submission.
+    void record(VkCommandBuffer cmd, size_t input, uint32_t slot) {
+        VkMemoryBarrier uploaded{};
+        uploaded.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        uploaded.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        uploaded.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &uploaded, 0, nullptr, 0, nullptr);
+
+        const uint32_t firstQuery = slot * static_cast<uint32_t>(passes.size() + 1);
+        if (queryPool) {
+            vkCmdResetQueryPool(cmd, queryPool, firstQuery, static_cast<uint32_t>(passes.size() + 1));
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery);
+        }
+        for (size_t i = 0; i < passes.size(); i++) {
+            const Pass& pass = passes[i];
+            const Target& dst = targets[pass.dst];
+
+            // The previous frame may still be sampling this target
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = dst.image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = 1;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pass.pipeline);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pass.layout, 0, 1,
+                                    &pass.sets[pass.src < 0 ? input : 0], 0, nullptr);
+            vkCmdPushConstants(cmd, pass.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PostParams), &pass.params);
+            vkCmdDispatch(cmd, (pass.params.dstSize[0] + 15) / 16, (pass.params.dstSize[1] + 15) / 16, 1);
+
+            // Read by the next pass, or by the draw
+            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                                 nullptr, 0, nullptr, 1, &barrier);
+            if (queryPool) {
+                vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool,
+                                    firstQuery + static_cast<uint32_t>(i) + 1);
+            }
+        }
+        if (queryPool) slotRecorded[slot] = true;
+    }
+
+    // Adds frame slot `slot`'s pass times; call once its fence has signaled
+    void collect(uint32_t slot) {
+        if (!queryPool || !slotRecorded[slot]) return;
+        slotRecorded[slot] = false;
+        std::vector<uint64_t> ticks(passes.size() + 1);
+        if (vkGetQueryPoolResults(device, queryPool, slot * static_cast<uint32_t>(ticks.size()),
+                                  static_cast<uint32_t>(ticks.size()), ticks.size() * sizeof(uint64_t), ticks.data(),
+                                  sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            return;
+        }
+        for (size_t i = 0; i < passes.size(); i++) {
+            double seconds = (ticks[i + 1] - ticks[i]) * timestampPeriod * 1e-9;
+            periodSeconds[i] += seconds;
+            runSeconds[i] += seconds;
+        }
+        periodFrames++;
+        runFrames++;
+    }
+
+    // Once a second, the average GPU time of each pass
+    void reportIfDue() {
+        double wall = std::chrono::duration<double>(Clock::now() - periodStart).count();
+        if (wall < 1.0 || periodFrames == 0) return;
+        printTimes("post", periodSeconds, periodFrames);
+        std::fill(periodSeconds.begin(), periodSeconds.end(), 0.0);
+        periodFrames = 0;
+        periodStart = Clock::now();
+    }
+
+    void printTotals(const char* label) const {
+        if (runFrames) printTimes(label, runSeconds, runFrames);
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Pass {
+        std::string name;
+        std::string shader;
+        PostParams params{};
+        int src = -1;  // -1 = the input, else a target
+        int dst = 0;
+        VkPipelineLayout layout = VK_NULL_HANDLE;  // owned by the chain
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet> sets;  // one per input for the first pass
+    };
+
+    struct Target {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    void addPass(const char* name, const char* shader, uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth,
+                 uint32_t dstHeight, float dx, float dy, float param) {
+        Pass pass;
+        pass.name = name;
+        pass.shader = shader;
+        pass.params.srcSize[0] = static_cast<int32_t>(srcWidth);
+        pass.params.srcSize[1] = static_cast<int32_t>(srcHeight);
+        pass.params.dstSize[0] = static_cast<int32_t>(dstWidth);
+        pass.params.dstSize[1] = static_cast<int32_t>(dstHeight);
+        pass.params.direction[0] = dx;
+        pass.params.direction[1] = dy;
+        pass.params.param = param;
+        passes.push_back(pass);
+    }
+
+    void printTimes(const char* label, const std::vector<double>& seconds, uint64_t frames) const {
+        double total = 0.0;
+        printf("%s:", label);
+        for (size_t i = 0; i < passes.size(); i++) {
+            printf(" %s %.3f ms |", passes[i].name.c_str(), seconds[i] * 1000.0 / frames);
+            total += seconds[i];
+        }
+        printf(" total %.3f ms per frame\n", total * 1000.0 / frames);
+    }
+
+    VkDeviceMemory allocate(const VkMemoryRequirements& memReqs, VkMemoryPropertyFlags wanted) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memReqs.size;
+        allocInfo.memoryTypeIndex = UINT32_MAX;
+        for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+            if ((memReqs.memoryTypeBits & (1 << i)) && (memProps.memoryTypes[i].propertyFlags & wanted) == wanted) {
+                allocInfo.memoryTypeIndex = i;
+                break;
+            }
+        }
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+            vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate post-processing memory");
+        }
+        return memory;
+    }
+
+    void createImage(Target& target, VkImageType type, VkFormat format, uint32_t width, uint32_t height,
+                     uint32_t depth, VkImageUsageFlags usage) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = type;
+        imageInfo.extent = {width, height, depth};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        if (vkCreateImage(device, &imageInfo, nullptr, &target.image) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create post-processing image");
+        }
+        VkMemoryRequirements memReqs;
+        vkGetImageMemoryRequirements(device, target.image, &memReqs);
+        target.memory = allocate(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        vkBindImageMemory(device, target.image, target.memory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = target.image;
+        viewInfo.viewType = type == VK_IMAGE_TYPE_3D ? VK_IMAGE_VIEW_TYPE_3D : VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(device, &viewInfo, nullptr, &target.view) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create post-processing image view");
+        }
+        target.width = width;
+        target.height = height;
+    }
+
+    void createTarget(Target& target, uint32_t width, uint32_t height) {
+        createImage(target, VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, width, height, 1,
+                    VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    }
+
+    void destroyTarget(Target& target) {
+        if (target.view) vkDestroyImageView(device, target.view, nullptr);
+        if (target.image) vkDestroyImage(device, target.image, nullptr);
+        if (target.memory) vkFreeMemory(device, target.memory, nullptr);
+        target = Target();
+    }
+
+    // Loads the .cube file into a 3D image, 16 bits per channel where it can
+    // be filtered, and uploads it with a one-shot command buffer
+    void createLut(VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue queue, const std::string& path) {
+        std::vector<float> values = loadCubeLut(path, lutSize);
+        VkFormat format = VK_FORMAT_R16G16B16A16_UNORM;
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+        if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+            format = VK_FORMAT_R8G8B8A8_UNORM;
+        }
+        const bool wide = format == VK_FORMAT_R16G16B16A16_UNORM;
+        const size_t entries = values.size() / 3;
+        const VkDeviceSize bytes = entries * (wide ? 8 : 4);
+        createImage(lutImage, VK_IMAGE_TYPE_3D, format, lutSize, lutSize, lutSize,
+                    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+        VkBuffer staging;
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = bytes;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkCreateBuffer(device, &bufferInfo, nullptr, &staging) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create LUT staging buffer");
+        }
+        VkMemoryRequirements memReqs;
+        vkGetBufferMemoryRequirements(device, staging, &memReqs);
+        VkDeviceMemory stagingMemory =
+            allocate(memReqs, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        vkBindBufferMemory(device, staging, stagingMemory, 0);
+        void* mapped;
+        vkMapMemory(device, stagingMemory, 0, bytes, 0, &mapped);
+        for (size_t i = 0; i < entries; i++) {
+            for (int c = 0; c < 4; c++) {
+                float v = c < 3 ? std::min(std::max(values[i * 3 + c], 0.0f), 1.0f) : 1.0f;
+                if (wide) static_cast<uint16_t*>(mapped)[i * 4 + c] = static_cast<uint16_t>(std::lround(v * 65535.0f));
+                else static_cast<uint8_t*>(mapped)[i * 4 + c] = static_cast<uint8_t>(std::lround(v * 255.0f));
+            }
+        }
+        vkUnmapMemory(device, stagingMemory);
+
+        VkCommandBuffer cmd;
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        vkAllocateCommandBuffers(device, &allocInfo, &cmd);
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(cmd, &beginInfo);
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = lutImage.image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                             nullptr, 1, &barrier);
+        VkBufferImageCopy region{};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {lutSize, lutSize, lutSize};
+        vkCmdCopyBufferToImage(cmd, staging, lutImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                             0, nullptr, 1, &barrier);
+        vkEndCommandBuffer(cmd);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd;
+        vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueWaitIdle(queue);
+        vkFreeCommandBuffers(device, commandPool, 1, &cmd);
+        vkDestroyBuffer(device, staging, nullptr);
+        vkFreeMemory(device, stagingMemory, nullptr);
+    }
+
+    VkDescriptorSetLayout createSetLayout(const VkSampler* immutableSampler) {
+        VkDescriptorSetLayoutBinding bindings[3]{};
+        bindings[0].binding = 0;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[0].descriptorCount = 1;
+        bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[0].pImmutableSamplers = immutableSampler;
+        bindings[1].binding = 1;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[1].descriptorCount = 1;
+        bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[2].binding = 2;
+        bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[2].descriptorCount = 1;
+        bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 3;
+        layoutInfo.pBindings = bindings;
+        VkDescriptorSetLayout layout;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create post-processing descriptor set layout");
+        }
+        return layout;
+    }
+
+    VkDescriptorSet createSet(VkDescriptorSetLayout layout, VkImageView src, VkImageLayout srcLayout,
+                              const Pass& pass) {
+        VkDescriptorSet set;
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+        if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate post-processing descriptor set");
+        }
+
+        VkDescriptorImageInfo srcInfo{linearSampler, src, srcLayout};  // sampler ignored if immutable
+        VkDescriptorImageInfo dstInfo{VK_NULL_HANDLE, targets[pass.dst].view, VK_IMAGE_LAYOUT_GENERAL};
+        VkDescriptorImageInfo lutInfo{linearSampler, lutImage.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkWriteDescriptorSet writes[3]{};
+        for (uint32_t b = 0; b < 3; b++) {
+            writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[b].dstSet = set;
+            writes[b].dstBinding = b;
+            writes[b].descriptorCount = 1;
+        }
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].pImageInfo = &srcInfo;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].pImageInfo = &dstInfo;
+        writes[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[2].pImageInfo = &lutInfo;
+        // The LUT binding is only written (and only used) by the lut pass
+        vkUpdateDescriptorSets(device, pass.shader == "lut.spv" ? 3 : 2, writes, 0, nullptr);
+        return set;
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memProps{};
+    std::vector<Pass> passes;
+    Target targets[3];  // ping, pong, output
+    Target lutImage;
+    uint32_t lutSize = 0;
+    VkSampler linearSampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout inputLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout passLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayouts[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};  // first pass, later passes
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    float timestampPeriod = 0.0f;
+    std::vector<bool> slotRecorded;
+    std::vector<double> periodSeconds;
+    std::vector<double> runSeconds;
+    uint64_t periodFrames = 0;
+    uint64_t runFrames = 0;
+    Clock::time_point periodStart = Clock::now();
+};
+
+#endif // POST_PROCESS_H
@@ -0,0 +1,101 @@
+#ifndef PRESENT_WAIT_H
+#define PRESENT_WAIT_H
+
+// Finds out when presented frames actually reached the display, using
+// VK_KHR_present_id and VK_KHR_present_wait.
+//
+// Every present is tagged with an increasing id. poll() asks, without
+// blocking, which ids have taken effect. vkWaitForPresentKHR must be
+// externally synchronized with presents to the same swapchain, so it is
+// polled from the render loop instead of blocking on a helper thread; a
+// present is therefore noticed up to one loop iteration late (about 1 ms
+// while the loop waits for frames).
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+
+// Feature structs to chain into VkDeviceCreateInfo::pNext. Must not be
+// moved once chained.
+struct PresentWaitFeatures {
+    VkPhysicalDevicePresentIdFeaturesKHR presentId{};
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWait{};
+
+    // True if the device supports both features; the structs are then
+    // linked and ready to enable them. The extensions must be checked first.
+    bool query(VkPhysicalDevice physicalDevice) {
+        presentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentId.pNext = &presentWait;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &presentId;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+        return presentId.presentId && presentWait.presentWait;
+    }
+};
+
+class PresentTimer {
+public:
+    bool init(VkDevice device, VkSwapchainKHR swapchain) {
+        this->device = device;
+        this->swapchain = swapchain;
+        waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
+        return waitForPresent != nullptr;
+    }
+
+    bool enabled() const { return waitForPresent != nullptr; }
+
+    // The swapchain was recreated. Present ids belong to a swapchain, so
+    // frames still pending on the old one can no longer be waited for.
+    void retarget(VkSwapchainKHR swapchain) {
+        this->swapchain = swapchain;
+        pending.clear();
+    }
+
+    // Chains a present id into `presentInfo` for a frame captured at
+    // `captureUs`. presentInfo must be presented before the next call.
+    void tag(VkPresentInfoKHR& presentInfo, int64_t captureUs) {
+        currentId = ++lastId;
+        presentIdInfo = VkPresentIdKHR{};
+        presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentIdInfo.pNext = presentInfo.pNext;
+        presentIdInfo.swapchainCount = 1;
+        presentIdInfo.pPresentIds = &currentId;
+        presentInfo.pNext = &presentIdInfo;
+        pending.push_back({currentId, captureUs});
+    }
+
+    // Calls onPresented(captureUs) for every tagged frame that has reached
+    // the display since the last call
+    template <typename Fn>
+    void poll(Fn onPresented) {
+        while (!pending.empty()) {
+            VkResult result = waitForPresent(device, swapchain, pending.front().id, 0);
+            if (result == VK_TIMEOUT) break;
+            if (result == VK_SUCCESS) onPresented(pending.front().captureUs);
+            pending.pop_front();
+        }
+        // A hidden window may never present; don't let the queue grow forever
+        while (pending.size() > MAX_PENDING) pending.pop_front();
+    }
+
+private:
+    static constexpr size_t MAX_PENDING = 16;
+
+    struct Pending {
+        uint64_t id;
+        int64_t captureUs;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+    VkPresentIdKHR presentIdInfo{};
+    uint64_t currentId = 0;
+    uint64_t lastId = 0;
+    std::deque<Pending> pending;
+};
+
+#endif // PRESENT_WAIT_H
@@ -0,0 +1,12 @@
+#version 450
+
+layout(location = 0) in vec2 uv;
+layout(location = 1) flat in uint layer;
+layout(location = 2) flat in float shade;
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 0) uniform sampler2DArray streams;
+
+void main() {
+    outColor = vec4(texture(streams, vec3(uv, float(layer))).rgb * shade, 1.0);
+}
@@ -0,0 +1,41 @@
+#version 450
+
+// Video wall tile: one instance per tile, six vertices (two triangles) each.
+// The instance index picks the tile's cell in the grid and its entry in the
+// tile table, which names the texture array layer to sample.
+
+struct Tile {
+    vec2 uvScale;  // stream size / layer size
+    uint layer;
+    float shade;   // dims a stalled stream
+};
+
+layout(std430, binding = 1) readonly buffer Tiles { Tile tiles[]; };
+
+layout(push_constant) uniform Grid {
+    uint columns;
+    uint rows;
+    vec2 gap;  // space between tiles, in normalized device coordinates
+} grid;
+
+layout(location = 0) out vec2 uv;
+layout(location = 1) flat out uint layer;
+layout(location = 2) flat out float shade;
+
+void main() {
+    const vec2 corners[6] = vec2[](
+        vec2(0, 0), vec2(1, 0), vec2(1, 1),
+        vec2(1, 1), vec2(0, 1), vec2(0, 0)
+    );
+    vec2 corner = corners[gl_VertexIndex];
+    uint tile = gl_InstanceIndex;
+    vec2 cell = vec2(tile % grid.columns, tile / grid.columns);
+    vec2 size = 2.0 / vec2(grid.columns, grid.rows);
+
+    // Row 0 at the top: Vulkan's y axis points down
+    vec2 pos = -1.0 + cell * size + grid.gap * 0.5 + corner * (size - grid.gap);
+    gl_Position = vec4(pos, 0, 1);
+    uv = corner * tiles[tile].uvScale;
+    layer = tiles[tile].layer;
+    shade = tiles[tile].shade;
+}
@@ -0,0 +1,137 @@
+#ifndef STAGING_RING_H
+#define STAGING_RING_H
+
+// Ring of upload slots sub-allocated from one persistently mapped,
+// host-visible buffer.
+//
+// The render thread fills a slot while the GPU is still copying or decoding
+// earlier ones. Each slot is owned by the CPU from acquire() until submit(),
+// then by the GPU until the submission that reads it is known to be
+// complete. Submissions are identified by an increasing serial, and the
+// caller reports completion with complete() whenever it has waited on (or
+// polled) the fence of a submission. Slots are handed out in ring order, so
+// acquire() only has to look at the oldest one.
+//
+// Slots are 4 KiB aligned, which satisfies every storage-buffer and copy
+// offset alignment.
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+struct StagingStats {
+    uint64_t acquires = 0;
+    uint64_t full = 0;          // acquire() found every slot still owned by the GPU
+    uint64_t busySum = 0;       // slots owned by the GPU at each acquire(), summed
+    uint32_t busyMax = 0;
+
+    void print(const char* label, uint32_t slots) const {
+        printf("%s: %u slots, %.2f busy with the GPU on average (max %u), ring full %llu times in %llu uploads\n",
+               label, slots, acquires ? static_cast<double>(busySum) / acquires : 0.0, busyMax,
+               static_cast<unsigned long long>(full), static_cast<unsigned long long>(acquires));
+    }
+};
+
+class StagingRing {
+public:
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize slotBytes, uint32_t slotCount,
+                VkBufferUsageFlags usage) {
+        this->device = device;
+        stride = (slotBytes + 4095) & ~VkDeviceSize(4095);
+        size = slotBytes;
+        serials.assign(slotCount, 0);
+        next = 0;
+        completed = 0;
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = stride * slotCount;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkCreateBuffer(device, &bufferInfo, nullptr, &buf) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create staging buffer");
+        }
+
+        VkMemoryRequirements memReqs;
+        vkGetBufferMemoryRequirements(device, buf, &memReqs);
+        VkPhysicalDeviceMemoryProperties memProps;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+        const VkMemoryPropertyFlags wanted = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memReqs.size;
+        allocInfo.memoryTypeIndex = UINT32_MAX;
+        for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+            if ((memReqs.memoryTypeBits & (1 << i)) && (memProps.memoryTypes[i].propertyFlags & wanted) == wanted) {
+                allocInfo.memoryTypeIndex = i;
+                break;
+            }
+        }
+        if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+            vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            vkDestroyBuffer(device, buf, nullptr);
+            throw std::runtime_error("Failed to allocate staging memory");
+        }
+        vkBindBufferMemory(device, buf, memory, 0);
+        void* mapped;
+        vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        base = static_cast<uint8_t*>(mapped);
+    }
+
+    void destroy() {
+        if (!buf) return;
+        vkUnmapMemory(device, memory);
+        vkDestroyBuffer(device, buf, nullptr);
+        vkFreeMemory(device, memory, nullptr);
+        buf = VK_NULL_HANDLE;
+        memory = VK_NULL_HANDLE;
+    }
+
+    VkBuffer buffer() const { return buf; }
+    uint32_t slotCount() const { return static_cast<uint32_t>(serials.size()); }
+    VkDeviceSize slotSize() const { return size; }
+    VkDeviceSize offset(uint32_t slot) const { return slot * stride; }
+    uint8_t* data(uint32_t slot) const { return base + slot * stride; }
+
+    // Next slot, if the GPU is done with it. Otherwise the caller waits for
+    // an older submission, reports it with complete() and tries again.
+    bool acquire(uint32_t& slot) {
+        if (serials[next] > completed) {
+            stats.full++;
+            return false;
+        }
+        uint32_t busy = 0;
+        for (uint64_t serial : serials) busy += serial > completed;
+        stats.acquires++;
+        stats.busySum += busy;
+        stats.busyMax = std::max(stats.busyMax, busy);
+        slot = next;
+        next = (next + 1) % slotCount();
+        return true;
+    }
+
+    // The CPU has filled `slot`; submission `serial` (> 0) reads it
+    void submit(uint32_t slot, uint64_t serial) { serials[slot] = serial; }
+
+    // Every submission up to and including `serial` has finished on the GPU
+    void complete(uint64_t serial) { completed = std::max(completed, serial); }
+
+    StagingStats stats;
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkBuffer buf = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    uint8_t* base = nullptr;
+    VkDeviceSize stride = 0;
+    VkDeviceSize size = 0;
+    std::vector<uint64_t> serials;  // last submission to read each slot; 0 = never used
+    uint32_t next = 0;
+    uint64_t completed = 0;
+};
+
+#endif // STAGING_RING_H
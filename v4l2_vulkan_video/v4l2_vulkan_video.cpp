@@ -1,8 +1,12 @@
 #include <iostream>
 #include <vector>
 #include <cstring>
+#include <cstdlib>
 #include <stdexcept>
 #include <fstream>
+#include <string>
+#include <algorithm>
+#include <memory>
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_vulkan.h>
@@ -14,11 +18,250 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include "pixel_convert.h"
+#include "convert_bench.h"
+#include "gpu_decode.h"
+#include "external_memory.h"
+#include "capture_thread.h"
+#include "format_negotiation.h"
+#include "replay_source.h"
+#include "frame_stats.h"
+#include "present_wait.h"
+#include "staging_ring.h"
+#include "host_upload.h"
+#include "ycbcr_image.h"
+#include "post_process.h"
+#include "motion_detect.h"
+#include "latency_stats.h"
+#include "video_wall.h"
+#include "frame_loop.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "mjpeg_decoder.h"
+
 // Constants
 const int WIDTH = 640;
 const int HEIGHT = 480;
 const char* DEVICE = "/dev/video0";
 
+const int MAX_FRAMES_IN_FLIGHT = 2;
+
+// How captured frames reach the GPU
+enum class CaptureMode {
+    Mmap,    // mmap the V4L2 buffers and copy each frame into the staging buffer
+    Dmabuf,  // export V4L2 buffers as dma-bufs and import them as Vulkan buffers
+    Userptr, // the driver DMAs into host memory imported with VK_EXT_external_memory_host
+};
+
+// Where raw frames are converted to RGBA
+enum class ConvertOn {
+    Auto,  // whichever render path is cheaper for the negotiated format
+    Gpu,   // --gpu-decode: always in a compute shader
+    Cpu,   // --cpu-convert: always with the SIMD converters (not available for NV12)
+};
+
+// Command line options
+struct Options {
+    negotiation::Request request;               // --format auto|rgb24|yuyv|nv12|nv12m|yu12|yu12m|mjpeg, --size WxH, --fps N
+    ConvertOn convertOn = ConvertOn::Auto;
+    uint32_t pixelFormat = 0;                   // negotiated pixel format
+    bool gpuDecode = false;                     // negotiated: convert in a compute shader
+    CaptureMode captureMode = CaptureMode::Mmap;  // --capture mmap|dmabuf|userptr
+    DropPolicy dropPolicy = DropPolicy::DropNewest;  // --drop-policy newest|block
+    bool lowLatency = false;                    // --low-latency: newest frame wins, MAILBOX present
+    uint32_t stagingSlots = MAX_FRAMES_IN_FLIGHT + 1;  // --staging-slots: upload ring size
+    UploadPath upload = UploadPath::Staging;    // --upload staging|host-copy|linear
+    bool benchConvert = false;                  // --bench-convert
+    size_t decodeDepth = 0;                     // --decode-depth: MJPEG frames decoding at once (0 = cores + 1)
+    std::string replayPath;                     // --replay: raw recording to play instead of the camera
+    double replayFps = 30.0;                    // --replay-fps: 0 = as fast as frames are rendered
+    bool replayLoop = false;                    // --replay-loop
+    std::string latencyCsvPath;                 // --latency-csv: per-stage latency over time
+    double latencyInterval = 5.0;               // --latency-interval: seconds per CSV window
+    PostSettings post;                          // --post blur,lanczos,lut, --blur-sigma, --post-size WxH, --lut FILE
+    bool motion = false;                        // --motion: upload changed tiles only, skip unchanged frames
+    double motionThreshold = 2.0;               // --motion-threshold: mean difference per byte for a dirty tile
+    WallSettings wall;                          // --wall-device DEV, --wall-replay FILE (repeatable), --wall-size WxH
+};
+
+Options parseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "auto") options.request.fourcc = 0;
+            else if (name == "rgb24") options.request.fourcc = V4L2_PIX_FMT_RGB24;
+            else if (name == "yuyv") options.request.fourcc = V4L2_PIX_FMT_YUYV;
+            else if (name == "nv12") options.request.fourcc = V4L2_PIX_FMT_NV12;
+            else if (name == "nv12m") options.request.fourcc = V4L2_PIX_FMT_NV12M;
+            else if (name == "yu12") options.request.fourcc = V4L2_PIX_FMT_YUV420;
+            else if (name == "yu12m") options.request.fourcc = V4L2_PIX_FMT_YUV420M;
+            else if (name == "mjpeg") options.request.fourcc = V4L2_PIX_FMT_MJPEG;
+            else throw std::runtime_error("Unknown format: " + name);
+        } else if (arg == "--size" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ux%u", &options.request.width, &options.request.height) != 2) {
+                throw std::runtime_error("--size takes WIDTHxHEIGHT");
+            }
+        } else if (arg == "--fps" && i + 1 < argc) {
+            options.request.fps = std::atof(argv[++i]);
+        } else if (arg == "--gpu-decode") {
+            options.convertOn = ConvertOn::Gpu;
+        } else if (arg == "--cpu-convert") {
+            options.convertOn = ConvertOn::Cpu;
+        } else if (arg == "--capture" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "mmap") options.captureMode = CaptureMode::Mmap;
+            else if (name == "dmabuf") options.captureMode = CaptureMode::Dmabuf;
+            else if (name == "userptr") options.captureMode = CaptureMode::Userptr;
+            else throw std::runtime_error("Unknown capture mode: " + name);
+        } else if (arg == "--drop-policy" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "newest") options.dropPolicy = DropPolicy::DropNewest;
+            else if (name == "block") options.dropPolicy = DropPolicy::Block;
+            else throw std::runtime_error("Unknown drop policy: " + name);
+        } else if (arg == "--low-latency") {
+            options.lowLatency = true;
+        } else if (arg == "--upload" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "staging") options.upload = UploadPath::Staging;
+            else if (name == "host-copy") options.upload = UploadPath::HostCopy;
+            else if (name == "linear") options.upload = UploadPath::Linear;
+            else throw std::runtime_error("Unknown upload path: " + name);
+        } else if (arg == "--staging-slots" && i + 1 < argc) {
+            options.stagingSlots = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--decode-depth" && i + 1 < argc) {
+            options.decodeDepth = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--replay" && i + 1 < argc) {
+            options.replayPath = argv[++i];
+        } else if (arg == "--replay-fps" && i + 1 < argc) {
+            options.replayFps = std::atof(argv[++i]);
+        } else if (arg == "--replay-loop") {
+            options.replayLoop = true;
+        } else if (arg == "--latency-csv" && i + 1 < argc) {
+            options.latencyCsvPath = argv[++i];
+        } else if (arg == "--latency-interval" && i + 1 < argc) {
+            options.latencyInterval = std::atof(argv[++i]);
+        } else if (arg == "--post" && i + 1 < argc) {
+            options.post.effects = parsePostEffects(argv[++i]);
+        } else if (arg == "--blur-sigma" && i + 1 < argc) {
+            options.post.blurSigma = static_cast<float>(std::atof(argv[++i]));
+        } else if (arg == "--post-size" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ux%u", &options.post.scaleWidth, &options.post.scaleHeight) != 2 ||
+                !options.post.scaleWidth || !options.post.scaleHeight) {
+                throw std::runtime_error("--post-size takes WIDTHxHEIGHT");
+            }
+        } else if (arg == "--lut" && i + 1 < argc) {
+            options.post.lutPath = argv[++i];
+        } else if (arg == "--motion") {
+            options.motion = true;
+        } else if (arg == "--motion-threshold" && i + 1 < argc) {
+            options.motionThreshold = std::atof(argv[++i]);
+        } else if (arg == "--wall-device" && i + 1 < argc) {
+            options.wall.sources.push_back({argv[++i], false});
+        } else if (arg == "--wall-replay" && i + 1 < argc) {
+            options.wall.sources.push_back({argv[++i], true});
+        } else if (arg == "--wall-size" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ux%u", &options.wall.width, &options.wall.height) != 2 || !options.wall.width ||
+                !options.wall.height) {
+                throw std::runtime_error("--wall-size takes WIDTHxHEIGHT");
+            }
+        } else if (arg == "--bench-convert") {
+            options.benchConvert = true;
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    // Fewer slots than frames in flight would make every frame wait for the GPU
+    if (options.stagingSlots < MAX_FRAMES_IN_FLIGHT) {
+        throw std::runtime_error("--staging-slots must be at least " + std::to_string(MAX_FRAMES_IN_FLIGHT));
+    }
+    // Lanczos scales to the window unless told otherwise
+    if (!options.post.scaleWidth) {
+        options.post.scaleWidth = WIDTH;
+        options.post.scaleHeight = HEIGHT;
+    }
+    if (std::find(options.post.effects.begin(), options.post.effects.end(), PostEffect::Lut) !=
+            options.post.effects.end() &&
+        options.post.lutPath.empty()) {
+        throw std::runtime_error("--post lut needs --lut FILE.cube");
+    }
+    // Zero-copy capture only feeds the compute shader
+    if (options.captureMode != CaptureMode::Mmap && options.convertOn == ConvertOn::Cpu) {
+        throw std::runtime_error("--capture dmabuf and userptr decode on the GPU; they cannot be combined with "
+                                 "--cpu-convert");
+    }
+    // A replayed file is copied like mmap capture
+    if (!options.replayPath.empty() && options.captureMode != CaptureMode::Mmap) {
+        throw std::runtime_error("Replay needs --capture mmap");
+    }
+    // The wall converts every stream on the CPU and uploads through the staging ring
+    if (!options.wall.sources.empty()) {
+        if (options.wall.sources.size() > VideoWall::MAX_STREAMS) {
+            throw std::runtime_error("The wall takes at most " + std::to_string(VideoWall::MAX_STREAMS) + " streams");
+        }
+        if (!options.replayPath.empty() || options.captureMode != CaptureMode::Mmap ||
+            options.convertOn == ConvertOn::Gpu || options.upload != UploadPath::Staging ||
+            !options.post.effects.empty() || options.motion) {
+            throw std::runtime_error("The wall cannot be combined with --replay, --capture, --gpu-decode, --upload, "
+                                     "--post or --motion");
+        }
+    }
+    return options;
+}
+
+enum RenderKind : uint32_t {
+    RENDER_GPU,    // compute shader converts the raw frame
+    RENDER_CPU,    // SIMD converter writes RGBA into the staging buffer
+    RENDER_MJPEG,  // decoded to RGBA on the CPU
+    RENDER_YCBCR,  // planes copied into a multi-planar image, sampled through a YCbCr conversion
+};
+
+// Render paths this viewer has for the given options. The cost is roughly
+// the bytes per pixel the render thread has to touch, plus the conversion.
+// `ycbcrSampling` is whether the device has the samplerYcbcrConversion feature.
+std::vector<negotiation::RenderPath> renderPaths(const Options& options, VkPhysicalDevice physicalDevice,
+                                                 bool ycbcrSampling) {
+    std::vector<negotiation::RenderPath> paths;
+    if (options.captureMode != CaptureMode::Mmap) {
+        // Zero-copy: the compute shader reads the capture buffer itself
+        paths.push_back({V4L2_PIX_FMT_NV12, "zero-copy GPU compute", 0.15, RENDER_GPU});
+        paths.push_back({V4L2_PIX_FMT_YUYV, "zero-copy GPU compute", 0.2, RENDER_GPU});
+        paths.push_back({V4L2_PIX_FMT_RGB24, "zero-copy GPU compute", 0.3, RENDER_GPU});
+        return paths;
+    }
+    // Raw planes copied into the staging buffer and on into the image the
+    // fragment shader samples: no RGBA intermediate at all. The only path
+    // for multi-planar buffers.
+    if (options.convertOn == ConvertOn::Auto && ycbcrSampling) {
+        const uint32_t planar[][2] = {{V4L2_PIX_FMT_NV12, negotiation::ANY_PLANAR},
+                                      {V4L2_PIX_FMT_YUV420, negotiation::ANY_PLANAR},
+                                      {V4L2_PIX_FMT_NV12M, negotiation::MULTI_PLANAR},
+                                      {V4L2_PIX_FMT_YUV420M, negotiation::MULTI_PLANAR}};
+        for (const auto& format : planar) {
+            if (YcbcrImage::supported(physicalDevice, format[0])) {
+                paths.push_back({format[0], "YCbCr sampler", 1.2, RENDER_YCBCR, format[1]});
+            }
+        }
+    }
+    // Raw frame copied into the staging buffer as is
+    if (options.convertOn != ConvertOn::Cpu) {
+        paths.push_back({V4L2_PIX_FMT_NV12, "GPU compute", 1.5, RENDER_GPU});
+        paths.push_back({V4L2_PIX_FMT_YUYV, "GPU compute", 2.0, RENDER_GPU});
+        paths.push_back({V4L2_PIX_FMT_RGB24, "GPU compute", 3.0, RENDER_GPU});
+    }
+    // Read the raw frame, write 4 bytes of RGBA
+    if (options.convertOn != ConvertOn::Gpu) {
+        paths.push_back({V4L2_PIX_FMT_RGB24, "CPU SIMD widening", 7.5, RENDER_CPU});
+        paths.push_back({V4L2_PIX_FMT_YUYV, "CPU SIMD conversion", 8.0, RENDER_CPU});
+    }
+    // Replayed frames must all be the same size, so no MJPEG there
+    if (options.replayPath.empty()) {
+        paths.push_back({V4L2_PIX_FMT_MJPEG, "parallel MJPEG decode", 40.0, RENDER_MJPEG});
+    }
+    return paths;
+}
+
 // Vertex structure
 struct Vertex {
     float pos[2];
@@ -48,6 +291,17 @@ std::vector<char> readFile(const std::string& filename) {
     return buffer;
 }
 
+bool hasDeviceExtension(VkPhysicalDevice physicalDevice, const char* name) {
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> available(count);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, available.data());
+    for (const auto& ext : available) {
+        if (strcmp(ext.extensionName, name) == 0) return true;
+    }
+    return false;
+}
+
 VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code) {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -60,20 +314,114 @@ VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code
     return shaderModule;
 }
 
-void convertRGB24toRGBA32(const uint8_t* rgb24, uint8_t* rgba32, size_t width, size_t height) {
-    for (size_t y = 0; y < height; y++) {
-        for (size_t x = 0; x < width; x++) {
-            size_t idx = (y * width + x) * 3;
-            size_t idx4 = (y * width + x) * 4;
-            rgba32[idx4 + 0] = rgb24[idx + 0];
-            rgba32[idx4 + 1] = rgb24[idx + 1];
-            rgba32[idx4 + 2] = rgb24[idx + 2];
-            rgba32[idx4 + 3] = 255;
+// Video wall: every --wall-device and --wall-replay stream in one window,
+// composited by a single instanced draw. Has its own render loop, built on
+// the same frame_loop.h pieces as the single-stream viewer; the
+// single-stream upload paths do not apply.
+int runWall(Options& options, VkSurfaceKHR surface, VkPhysicalDevice physicalDevice) {
+    // One graphics queue does every upload and draw
+    DisplayDevice display;
+    display.create(physicalDevice, surface, {VK_KHR_SWAPCHAIN_EXTENSION_NAME}, nullptr);
+    VkDevice device = display.device;
+    SwapchainTarget target;
+    target.create(device, physicalDevice, surface, {options.wall.width, options.wall.height}, options.lowLatency);
+    FrameSlots frames;
+    frames.create(device, physicalDevice, display.commandPool, MAX_FRAMES_IN_FLIGHT, display.timestamps);
+
+    // Every stream is converted on the CPU, so devices only offer the packed formats
+    const std::vector<negotiation::RenderPath> paths = {
+        {V4L2_PIX_FMT_RGB24, "CPU SIMD widening", 7.5, RENDER_CPU},
+        {V4L2_PIX_FMT_YUYV, "CPU SIMD conversion", 8.0, RENDER_CPU},
+    };
+    VideoWall wall;
+    wall.open(options.wall, options.request, paths, options.replayFps, options.replayLoop, options.dropPolicy);
+    wall.create(device, physicalDevice, display.commandPool, display.graphicsQueue, target.renderPass(),
+                target.extent(), options.stagingSlots,
+                [device](const std::string& file) { return createShaderModule(device, readFile(file)); });
+    wall.start();
+
+    FrameStats frameStats;
+    auto lastPresent = FrameStats::Clock::now();
+    bool presented = false;
+
+    bool running = true;
+    while (running) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_EVENT_QUIT) running = false;
         }
+
+        // Nothing new from any stream: nothing to upload or draw
+        if (!wall.acquire()) {
+            if (wall.ended()) break;
+            SDL_Delay(1);
+            continue;
+        }
+        auto frameStart = FrameStats::Clock::now();
+
+        // Convert into a free staging slot before waiting on the frame
+        // slot's fence, as the single-stream viewer does
+        uint32_t stagingSlot = 0;
+        double waitSeconds = frames.acquireStaging(wall.staging, stagingSlot);
+        wall.convert(stagingSlot);
+        double convertSeconds =
+            std::chrono::duration<double>(FrameStats::Clock::now() - frameStart).count() - waitSeconds;
+
+        waitSeconds += frames.wait(wall.staging);
+        double gpuSeconds = frames.gpuSeconds();
+
+        // Without an image the converted slot is dropped; streams that
+        // changed show their next frame instead
+        uint32_t imageIndex;
+        if (!frames.acquireImage(target, imageIndex)) continue;
+        auto recordStart = FrameStats::Clock::now();
+
+        VkCommandBuffer cmd = frames.begin();
+        wall.recordUpload(cmd, stagingSlot);
+        target.beginRenderPass(cmd, imageIndex);
+        wall.recordDraw(cmd);
+        vkCmdEndRenderPass(cmd);
+        wall.staging.submit(stagingSlot, frames.submit(display.graphicsQueue, target, imageIndex));
+        frames.present(display.presentQueue, target, imageIndex);
+
+        auto cpuEnd = FrameStats::Clock::now();
+        if (presented) {
+            wall.addFrame(std::chrono::duration_cast<std::chrono::microseconds>(cpuEnd - lastPresent).count());
+        }
+        lastPresent = cpuEnd;
+        presented = true;
+        frameStats.addFrame(convertSeconds + std::chrono::duration<double>(cpuEnd - recordStart).count(), waitSeconds,
+                            gpuSeconds);
+        frameStats.reportIfDue(wall.skipped());
+        wall.reportIfDue();
+
+        frames.advance();
     }
+    vkDeviceWaitIdle(device);
+    wall.stop();
+    wall.printTotals();
+    wall.staging.stats.print("Staging", wall.staging.slotCount());
+    frameStats.printTotals("Wall upload");
+
+    wall.destroy();
+    frames.destroy();
+    target.destroy();
+    display.destroy();
+    return 0;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+    if (options.benchConvert) {
+        // The odd width leaves a scalar tail on every row of every kernel
+        bool ok = pixconv::runConvertBenchmark(1920, 1080, 200);
+        ok &= pixconv::runConvertBenchmark(1917, 1080, 50);
+        return ok ? 0 : 1;
+    }
+
+    // Zero-copy modes keep up to MAX_FRAMES_IN_FLIGHT capture buffers busy on the GPU
+    const uint32_t bufferCount = 4 + MAX_FRAMES_IN_FLIGHT;
+
     // Initialize SDL3
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         std::cerr << "SDL_Init failed: " << SDL_GetError() << std::endl;
@@ -81,7 +429,10 @@ int main() {
     }
 
     // Create window
-    SDL_Window* window = SDL_CreateWindow("Video Player", WIDTH, HEIGHT, SDL_WINDOW_VULKAN);
+    const bool wallMode = !options.wall.sources.empty();
+    SDL_Window* window = wallMode ? SDL_CreateWindow("Video Wall", options.wall.width, options.wall.height,
+                                                     SDL_WINDOW_VULKAN)
+                                  : SDL_CreateWindow("Video Player", WIDTH, HEIGHT, SDL_WINDOW_VULKAN);
     if (!window) {
         std::cerr << "SDL_CreateWindow failed: " << SDL_GetError() << std::endl;
         SDL_Quit();
@@ -100,7 +451,7 @@ int main() {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_1;  // external memory is core in 1.1
 
     VkInstanceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -134,133 +485,155 @@ int main() {
     vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
     VkPhysicalDevice physicalDevice = devices[0]; // Pick first device
 
-    // Find queue families
-    uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    if (wallMode) {
+        int result = runWall(options, surface, physicalDevice);
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+        vkDestroyInstance(instance, nullptr);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return result;
+    }
+
+    // V4L2 setup, or a recording replayed in place of the camera. The
+    // format is settled before the device is created because it decides the
+    // render path, the device features and the size of every video buffer.
+    YcbcrFeatures ycbcrFeatures;
+    const std::vector<negotiation::RenderPath> paths =
+        renderPaths(options, physicalDevice, ycbcrFeatures.query(physicalDevice));
+    negotiation::Choice choice;
+    const bool replay = !options.replayPath.empty();
+    std::unique_ptr<ReplaySource> replaySource;
+    int fd = -1;
+    struct v4l2_format fmt{};
+    if (replay) {
+        // A raw recording has no format of its own: --format (YUYV by default) at --size
+        negotiation::Mode mode;
+        mode.fourcc = options.request.fourcc ? options.request.fourcc : V4L2_PIX_FMT_YUYV;
+        mode.width = options.request.width;
+        mode.height = options.request.height;
+        if (!negotiation::choose({mode}, paths, options.request, choice)) {
+            throw std::runtime_error("No render path for " + negotiation::fourccName(mode.fourcc) + " replay");
+        }
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        fmt.fmt.pix.width = mode.width;
+        fmt.fmt.pix.height = mode.height;
+        fmt.fmt.pix.pixelformat = mode.fourcc;
+        fmt.fmt.pix.bytesperline = mode.fourcc == V4L2_PIX_FMT_YUYV  ? mode.width * 2
+                                 : mode.fourcc == V4L2_PIX_FMT_RGB24 ? mode.width * 3
+                                                                     : mode.width;
+        fmt.fmt.pix.sizeimage = ReplaySource::frameBytes(mode.fourcc, mode.width, mode.height);
+        replaySource.reset(new ReplaySource(options.replayPath, fmt.fmt.pix.sizeimage, options.replayFps,
+                                            options.replayLoop, bufferCount));
+        std::cout << "Replaying " << options.replayPath << ": " << replaySource->frames() << " frames at ";
+        if (options.replayFps > 0) std::cout << options.replayFps << " fps" << std::endl;
+        else std::cout << "unlimited rate" << std::endl;
+    } else {
+        fd = open(DEVICE, O_RDWR);
+        if (fd == -1) throw std::runtime_error("Failed to open video device");
+
+        struct v4l2_capability cap{};
+        ioctl(fd, VIDIOC_QUERYCAP, &cap);
+        if (!(cap.capabilities & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE))) {
+            close(fd);
+            throw std::runtime_error("Device does not support capture");
+        }
+
+        fmt = negotiation::negotiate(fd, paths, options.request, DEVICE, choice);
+    }
+    const negotiation::FrameFormat frame = negotiation::frameFormat(fmt);
+    options.pixelFormat = frame.fourcc;
+    options.gpuDecode = choice.path.tag == RENDER_GPU;
+    const bool ycbcrSampling = choice.path.tag == RENDER_YCBCR;
+    const uint32_t videoWidth = frame.width;
+    const uint32_t videoHeight = frame.height;
+
+    // The compute shader and the YCbCr image take raw frames from the
+    // staging ring (or the capture buffers); only CPU-converted RGBA frames
+    // can skip it
+    if ((options.gpuDecode || ycbcrSampling) && options.upload != UploadPath::Staging) {
+        std::cout << "Raw YUV frames upload through the staging ring; ignoring --upload" << std::endl;
+        options.upload = UploadPath::Staging;
+    }
 
-    int graphicsFamily = -1, presentFamily = -1;
-    for (uint32_t i = 0; i < queueFamilyCount; i++) {
-        if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) graphicsFamily = i;
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
-        if (presentSupport) presentFamily = i;
-        if (graphicsFamily != -1 && presentFamily != -1) break;
+    const pixconv::PixelConverter& converter = pixconv::bestPixelConverter();
+    const pixconv::RowFn rowFn = options.pixelFormat == V4L2_PIX_FMT_YUYV ? converter.yuyvToRgba : converter.rgb24ToRgba;
+    if (options.gpuDecode) {
+        std::cout << "Pixel conversion: GPU compute" << std::endl;
+    } else if (ycbcrSampling) {
+        std::cout << "Pixel conversion: YCbCr sampler" << std::endl;
+    } else if (options.pixelFormat == V4L2_PIX_FMT_MJPEG) {
+        std::cout << "Pixel conversion: parallel MJPEG decode" << std::endl;
+    } else {
+        std::cout << "Pixel converter: " << converter.name << std::endl;
     }
 
     // Create logical device
-    float queuePriority = 1.0f;
-    VkDeviceQueueCreateInfo queueCreateInfos[2]{};
-    queueCreateInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueCreateInfos[0].queueFamilyIndex = graphicsFamily;
-    queueCreateInfos[0].queueCount = 1;
-    queueCreateInfos[0].pQueuePriorities = &queuePriority;
-    uint32_t queueCount = 1;
-    if (graphicsFamily != presentFamily) {
-        queueCreateInfos[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueCreateInfos[1].queueFamilyIndex = presentFamily;
-        queueCreateInfos[1].queueCount = 1;
-        queueCreateInfos[1].pQueuePriorities = &queuePriority;
-        queueCount = 2;
-    }
-
-    VkDeviceCreateInfo deviceCreateInfo{};
-    deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    deviceCreateInfo.queueCreateInfoCount = queueCount;
-    deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
-    deviceCreateInfo.enabledExtensionCount = 1;
-    const char* deviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
-    deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions;
-
-    VkDevice device;
-    vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device);
-
-    // Get queues
-    VkQueue graphicsQueue, presentQueue;
-    vkGetDeviceQueue(device, graphicsFamily, 0, &graphicsQueue);
-    vkGetDeviceQueue(device, presentFamily, 0, &presentQueue);
-
-    // Create swapchain
-    VkSurfaceCapabilitiesKHR capabilities;
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
-    uint32_t formatCount;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, nullptr);
-    std::vector<VkSurfaceFormatKHR> formats(formatCount);
-    vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, formats.data());
-    VkSurfaceFormatKHR surfaceFormat = formats[0];
-    for (const auto& format : formats) {
-        if (format.format == VK_FORMAT_B8G8R8A8_UNORM) {
-            surfaceFormat = format;
-            break;
+    std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    void* featureChain = nullptr;
+    bool dmabufImport = false;
+    if (options.captureMode == CaptureMode::Dmabuf) {
+        dmabufImport = hasDeviceExtension(physicalDevice, VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME) &&
+                       hasDeviceExtension(physicalDevice, VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME);
+        if (dmabufImport) {
+            deviceExtensions.push_back(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
+            deviceExtensions.push_back(VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME);
+        } else {
+            std::cerr << "dma-buf import not supported, falling back to copy" << std::endl;
+        }
+    }
+    VkDeviceSize hostImportAlignment = 0;
+    if (options.captureMode == CaptureMode::Userptr) {
+        if (hasDeviceExtension(physicalDevice, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME)) {
+            deviceExtensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+            hostImportAlignment = hostPointerImportAlignment(physicalDevice);
+        } else {
+            std::cerr << "host memory import not supported, falling back to copy" << std::endl;
         }
     }
+    // Host image copy needs copy_commands2 and format_feature_flags2 on Vulkan 1.1
+    HostImageCopyFeatures hostImageCopyFeatures;
+    if (options.upload == UploadPath::HostCopy) {
+        if (hasDeviceExtension(physicalDevice, VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME) &&
+            hasDeviceExtension(physicalDevice, VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME) &&
+            hasDeviceExtension(physicalDevice, VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME) &&
+            hostImageCopyFeatures.query(physicalDevice)) {
+            deviceExtensions.push_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
+            deviceExtensions.push_back(VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME);
+            deviceExtensions.push_back(VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME);
+        } else {
+            std::cerr << "host image copy not supported, falling back to staging copy" << std::endl;
+            options.upload = UploadPath::Staging;
+        }
+    }
+    // Present feedback for the capture-to-display latency
+    PresentWaitFeatures presentWaitFeatures;
+    bool presentWait = hasDeviceExtension(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+                       hasDeviceExtension(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) &&
+                       presentWaitFeatures.query(physicalDevice);
+    if (presentWait) {
+        deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        featureChain = &presentWaitFeatures.presentId;
+    }
+    if (options.upload == UploadPath::HostCopy) {
+        hostImageCopyFeatures.hostImageCopy.pNext = featureChain;
+        featureChain = &hostImageCopyFeatures.hostImageCopy;
+    }
+    if (ycbcrSampling) {
+        ycbcrFeatures.ycbcr.pNext = featureChain;
+        featureChain = &ycbcrFeatures.ycbcr;
+    }
+
+    DisplayDevice display;
+    display.create(physicalDevice, surface, deviceExtensions, featureChain);
+    VkDevice device = display.device;
+    VkQueue graphicsQueue = display.graphicsQueue;
+    VkCommandPool commandPool = display.commandPool;
 
-    VkExtent2D extent = {WIDTH, HEIGHT};
-    VkSwapchainCreateInfoKHR swapchainInfo{};
-    swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    swapchainInfo.surface = surface;
-    swapchainInfo.minImageCount = 2;
-    swapchainInfo.imageFormat = surfaceFormat.format;
-    swapchainInfo.imageColorSpace = surfaceFormat.colorSpace;
-    swapchainInfo.imageExtent = extent;
-    swapchainInfo.imageArrayLayers = 1;
-    swapchainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    swapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    swapchainInfo.preTransform = capabilities.currentTransform;
-    swapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    swapchainInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
-
-    VkSwapchainKHR swapchain;
-    vkCreateSwapchainKHR(device, &swapchainInfo, nullptr, &swapchain);
-
-    // Get swapchain images
-    uint32_t imageCount;
-    vkGetSwapchainImagesKHR(device, swapchain, &imageCount, nullptr);
-    std::vector<VkImage> swapchainImages(imageCount);
-    vkGetSwapchainImagesKHR(device, swapchain, &imageCount, swapchainImages.data());
-
-    // Create image views
-    std::vector<VkImageView> swapchainImageViews(imageCount);
-    for (size_t i = 0; i < imageCount; i++) {
-        VkImageViewCreateInfo viewInfo{};
-        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        viewInfo.image = swapchainImages[i];
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        viewInfo.format = surfaceFormat.format;
-        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        viewInfo.subresourceRange.levelCount = 1;
-        viewInfo.subresourceRange.layerCount = 1;
-        vkCreateImageView(device, &viewInfo, nullptr, &swapchainImageViews[i]);
-    }
-
-    // Create render pass
-    VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = surfaceFormat.format;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass{};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-
-    VkRenderPassCreateInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-
-    VkRenderPass renderPass;
-    vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass);
+    // Swapchain, render pass and framebuffers
+    SwapchainTarget target;
+    target.create(device, physicalDevice, surface, {WIDTH, HEIGHT}, options.lowLatency);
+    const VkExtent2D extent = target.extent();
 
     // Create shaders and pipeline
     auto vertShaderCode = readFile("vert.spv");
@@ -305,8 +678,8 @@ int main() {
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
     VkViewport viewport{};
-    viewport.width = WIDTH;
-    viewport.height = HEIGHT;
+    viewport.width = extent.width;
+    viewport.height = extent.height;
     viewport.maxDepth = 1.0f;
 
     VkRect2D scissor{};
@@ -338,6 +711,13 @@ int main() {
     colorBlending.attachmentCount = 1;
     colorBlending.pAttachments = &colorBlendAttachment;
 
+    // Multi-planar video image; its conversion sampler is baked into the
+    // layout, unless the draw samples the post-processing output instead
+    YcbcrImage ycbcrImage;
+    if (ycbcrSampling) ycbcrImage.create(device, physicalDevice, frame);
+    const bool postProcess = !options.post.effects.empty();
+    const bool drawYcbcr = ycbcrSampling && !postProcess;
+
     // Descriptor set layout
     VkDescriptorSetLayout descriptorSetLayout;
     VkDescriptorSetLayoutBinding samplerBinding{};
@@ -345,6 +725,7 @@ int main() {
     samplerBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     samplerBinding.descriptorCount = 1;
     samplerBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    if (drawYcbcr) samplerBinding.pImmutableSamplers = ycbcrImage.sampler();
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.bindingCount = 1;
@@ -369,7 +750,7 @@ int main() {
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.layout = pipelineLayout;
-    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.renderPass = target.renderPass();
     pipelineInfo.subpass = 0;
 
     VkPipeline graphicsPipeline;
@@ -378,29 +759,7 @@ int main() {
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
 
-    // Create framebuffers
-    std::vector<VkFramebuffer> swapchainFramebuffers(imageCount);
-    for (size_t i = 0; i < imageCount; i++) {
-        VkFramebufferCreateInfo fbInfo{};
-        fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        fbInfo.renderPass = renderPass;
-        fbInfo.attachmentCount = 1;
-        fbInfo.pAttachments = &swapchainImageViews[i];
-        fbInfo.width = WIDTH;
-        fbInfo.height = HEIGHT;
-        fbInfo.layers = 1;
-        vkCreateFramebuffer(device, &fbInfo, nullptr, &swapchainFramebuffers[i]);
-    }
-
-    // Create command pool
-    VkCommandPool commandPool;
-    VkCommandPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.queueFamilyIndex = graphicsFamily;
-    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
-
-    // Create command buffer
+    // One-shot command buffer for the vertex upload
     VkCommandBuffer commandBuffer;
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -482,6 +841,10 @@ int main() {
     vkDestroyBuffer(device, stagingBuffer, nullptr);
     vkFreeMemory(device, stagingMemory, nullptr);
 
+    // Per-frame command buffers, synchronization and GPU timestamps
+    FrameSlots frames;
+    frames.create(device, physicalDevice, commandPool, MAX_FRAMES_IN_FLIGHT, display.timestamps);
+
     // Create index buffer similarly (omitted for brevity, follows vertex buffer pattern)
 
     // Create video image
@@ -490,8 +853,8 @@ int main() {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = WIDTH;
-    imageInfo.extent.height = HEIGHT;
+    imageInfo.extent.width = videoWidth;
+    imageInfo.extent.height = videoHeight;
     imageInfo.extent.depth = 1;
     imageInfo.mipLevels = 1;
     imageInfo.arrayLayers = 1;
@@ -499,6 +862,7 @@ int main() {
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (options.gpuDecode) imageInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     vkCreateImage(device, &imageInfo, nullptr, &videoImage);
@@ -525,41 +889,49 @@ int main() {
     viewInfo.subresourceRange.layerCount = 1;
     vkCreateImageView(device, &viewInfo, nullptr, &videoImageView);
 
-    // Create staging buffer for video frames
-    VkBuffer frameStagingBuffer;
-    VkDeviceMemory frameStagingMemory;
-    size_t frameSize = WIDTH * HEIGHT * 4;
-    VkBufferCreateInfo frameBufferInfo{};
-    frameBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    frameBufferInfo.size = frameSize;
-    frameBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    frameBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    vkCreateBuffer(device, &frameBufferInfo, nullptr, &frameStagingBuffer);
-
-    vkGetBufferMemoryRequirements(device, frameStagingBuffer, &memReqs);
-    memAllocInfo.allocationSize = memReqs.size;
-    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
-        if ((memReqs.memoryTypeBits & (1 << i)) && (memProps.memoryTypes[i].propertyFlags & (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))) {
-            memAllocInfo.memoryTypeIndex = i;
-            break;
-        }
+    // Images the CPU writes directly, one per frame in flight, replacing the
+    // staging ring and the copy into videoImage
+    HostUploader uploader;
+    if (options.upload != UploadPath::Staging &&
+        !uploader.init(device, physicalDevice, options.upload, videoWidth, videoHeight, MAX_FRAMES_IN_FLIGHT)) {
+        std::cerr << uploadPathName(options.upload) << " upload not supported, falling back to staging copy"
+                  << std::endl;
+        options.upload = UploadPath::Staging;
+    }
+    const bool hostUpload = options.upload != UploadPath::Staging;
+    std::cout << "Upload: " << uploadPathName(options.upload) << std::endl;
+    // Host copies need a packed RGBA source; MJPEG frames already are one
+    std::vector<uint8_t> hostFrame;
+    if (options.upload == UploadPath::HostCopy && options.pixelFormat != V4L2_PIX_FMT_MJPEG) {
+        hostFrame.resize(static_cast<size_t>(videoWidth) * videoHeight * 4);
     }
-    vkAllocateMemory(device, &memAllocInfo, nullptr, &frameStagingMemory);
-    vkBindBufferMemory(device, frameStagingBuffer, frameStagingMemory, 0);
-
-    void* mappedMemory;
-    vkMapMemory(device, frameStagingMemory, 0, frameSize, 0, &mappedMemory);
 
-    // Create descriptor pool and set
+    // Upload ring for video frames. With more slots than frames in flight the
+    // CPU converts the next frame into a free slot before it waits for the
+    // GPU, so conversion overlaps the copy (or decode) of earlier frames.
+    // With GPU decode a slot holds the raw YUV frame and is read directly by
+    // the compute shader; for the YCbCr image it holds the frame's memory
+    // planes back to back.
+    StagingRing staging;
+    size_t frameSize = ycbcrSampling ? frame.frameBytes()
+                                     : std::max<size_t>(static_cast<size_t>(videoWidth) * videoHeight * 4,
+                                                        frame.sizeimage[0]);
+    VkBufferUsageFlags stagingUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    if (options.gpuDecode) stagingUsage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    if (!hostUpload) staging.create(device, physicalDevice, frameSize, options.stagingSlots, stagingUsage);
+
+    // Create descriptor pool and sets: one for videoImage, one per host upload
+    // image and one for the post-processing output
+    const uint32_t descriptorSetCount = 2 + static_cast<uint32_t>(uploader.count());
     VkDescriptorPool descriptorPool;
     VkDescriptorPoolSize poolSize{};
     poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSize.descriptorCount = 1;
+    poolSize.descriptorCount = descriptorSetCount * (drawYcbcr ? ycbcrImage.descriptorCount() : 1);
     VkDescriptorPoolCreateInfo poolInfoDesc{};
     poolInfoDesc.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfoDesc.poolSizeCount = 1;
     poolInfoDesc.pPoolSizes = &poolSize;
-    poolInfoDesc.maxSets = 1;
+    poolInfoDesc.maxSets = descriptorSetCount;
     vkCreateDescriptorPool(device, &poolInfoDesc, nullptr, &descriptorPool);
 
     VkDescriptorSet descriptorSet;
@@ -582,8 +954,8 @@ int main() {
 
     VkDescriptorImageInfo imageDescInfo{};
     imageDescInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageDescInfo.imageView = videoImageView;
-    imageDescInfo.sampler = sampler;
+    imageDescInfo.imageView = drawYcbcr ? ycbcrImage.view() : videoImageView;
+    imageDescInfo.sampler = sampler;  // ignored for the immutable YCbCr sampler
 
     VkWriteDescriptorSet descriptorWrite{};
     descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -594,145 +966,564 @@ int main() {
     descriptorWrite.pImageInfo = &imageDescInfo;
     vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
 
-    // V4L2 setup
-    int fd = open(DEVICE, O_RDWR);
-    if (fd == -1) {
-        std::cerr << "Failed to open video device" << std::endl;
-        return 1;
+    std::vector<VkDescriptorSet> uploadSets(uploader.count());
+    for (size_t i = 0; i < uploadSets.size(); i++) {
+        vkAllocateDescriptorSets(device, &dsAllocInfo, &uploadSets[i]);
+        VkDescriptorImageInfo uploadImageInfo{};
+        uploadImageInfo.imageLayout = uploader.layout();
+        uploadImageInfo.imageView = uploader.view(i);
+        uploadImageInfo.sampler = sampler;
+        descriptorWrite.dstSet = uploadSets[i];
+        descriptorWrite.pImageInfo = &uploadImageInfo;
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
     }
 
-    struct v4l2_capability cap{};
-    ioctl(fd, VIDIOC_QUERYCAP, &cap);
-    if (!(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE)) {
-        std::cerr << "Device does not support capture" << std::endl;
-        close(fd);
-        return 1;
+    // Compute passes between the upload and the draw. They start from
+    // whichever image this frame was uploaded into, and the draw samples
+    // their output.
+    PostProcessChain postChain;
+    VkDescriptorSet postSet = VK_NULL_HANDLE;
+    if (postProcess) {
+        std::vector<PostInput> postInputs;
+        if (hostUpload) {
+            for (size_t i = 0; i < uploader.count(); i++) postInputs.push_back({uploader.view(i), uploader.layout()});
+        } else {
+            postInputs.push_back({ycbcrSampling ? ycbcrImage.view() : videoImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+        }
+        postChain.create(device, physicalDevice, commandPool, graphicsQueue, options.post, postInputs,
+                         ycbcrSampling ? ycbcrImage.sampler() : nullptr,
+                         ycbcrSampling ? ycbcrImage.descriptorCount() : 1, videoWidth, videoHeight,
+                         MAX_FRAMES_IN_FLIGHT,
+                         frames.timestampPeriod(),
+                         [device](const std::string& file) { return createShaderModule(device, readFile(file)); });
+        vkAllocateDescriptorSets(device, &dsAllocInfo, &postSet);
+        VkDescriptorImageInfo postImageInfo{};
+        postImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        postImageInfo.imageView = postChain.outputView();
+        postImageInfo.sampler = sampler;
+        descriptorWrite.dstSet = postSet;
+        descriptorWrite.pImageInfo = &postImageInfo;
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+        std::cout << "Post-processing: " << videoWidth << "x" << videoHeight << " -> " << postChain.outputWidth()
+                  << "x" << postChain.outputHeight() << std::endl;
     }
 
-    struct v4l2_format fmt{};
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    fmt.fmt.pix.width = WIDTH;
-    fmt.fmt.pix.height = HEIGHT;
-    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_RGB24;
-    fmt.fmt.pix.field = V4L2_FIELD_ANY;
-    ioctl(fd, VIDIOC_S_FMT, &fmt);
-
-    struct v4l2_requestbuffers req{};
-    req.count = 2;
-    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    req.memory = V4L2_MEMORY_MMAP;
-    ioctl(fd, VIDIOC_REQBUFS, &req);
-
     struct Buffer {
         void* start;
         size_t length;
     };
-    std::vector<Buffer> buffers(req.count);
-    for (size_t i = 0; i < req.count; i++) {
-        struct v4l2_buffer buf{};
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        buf.index = i;
-        ioctl(fd, VIDIOC_QUERYBUF, &buf);
-        buffers[i].length = buf.length;
-        buffers[i].start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+    std::vector<Buffer> buffers;
+    // Memory planes after the first of each multi-planar buffer (NV12M, YUV420M)
+    std::vector<std::vector<Buffer>> extraPlanes;
+    std::vector<ImportedBuffer> importedBuffers;
+    uint32_t memoryType = V4L2_MEMORY_MMAP;
+
+    // USERPTR: allocate aligned host slots, import them into Vulkan and let the
+    // driver DMA straight into them. Any failure drops back to MMAP.
+    if (hostImportAlignment != 0) {
+        size_t slotSize = (frame.sizeimage[0] + hostImportAlignment - 1) / hostImportAlignment * hostImportAlignment;
+        for (uint32_t i = 0; i < bufferCount; i++) {
+            void* slot = aligned_alloc(hostImportAlignment, slotSize);
+            ImportedBuffer imported;
+            if (!slot || !importHostPointerBuffer(device, slot, slotSize, imported)) {
+                free(slot);
+                break;
+            }
+            buffers.push_back({slot, slotSize});
+            importedBuffers.push_back(imported);
+        }
+
+        struct v4l2_requestbuffers req{};
+        req.count = bufferCount;
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        req.memory = V4L2_MEMORY_USERPTR;
+        if (importedBuffers.size() == bufferCount && ioctl(fd, VIDIOC_REQBUFS, &req) == 0 && req.count == bufferCount) {
+            memoryType = V4L2_MEMORY_USERPTR;
+        } else {
+            std::cerr << "USERPTR capture into imported host memory failed, falling back to copy" << std::endl;
+            for (auto& b : importedBuffers) destroyImportedBuffer(device, b);
+            for (auto& b : buffers) free(b.start);
+            importedBuffers.clear();
+            buffers.clear();
+        }
+    }
+
+    if (replay) {
+        // The replay slots stand in for the mapped capture buffers
+        for (uint32_t i = 0; i < replaySource->bufferCount(); i++) {
+            buffers.push_back({replaySource->buffer(i), replaySource->bufferLength()});
+        }
+    } else if (memoryType == V4L2_MEMORY_MMAP) {
+        struct v4l2_requestbuffers req{};
+        req.count = bufferCount;
+        req.type = frame.bufferType;
+        req.memory = V4L2_MEMORY_MMAP;
+        if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
+            throw std::runtime_error(std::string("VIDIOC_REQBUFS failed: ") + strerror(errno));
+        }
+        // The capture ring needs a buffer beyond those the GPU may be reading
+        if (req.count < static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) + 2) {
+            throw std::runtime_error("Driver granted only " + std::to_string(req.count) + " capture buffers, need " +
+                                     std::to_string(MAX_FRAMES_IN_FLIGHT + 2));
+        }
+
+        buffers.resize(req.count);
+        extraPlanes.resize(req.count);
+        for (size_t i = 0; i < req.count; i++) {
+            struct v4l2_buffer buf{};
+            struct v4l2_plane planes[VIDEO_MAX_PLANES]{};
+            buf.type = frame.bufferType;
+            buf.memory = V4L2_MEMORY_MMAP;
+            buf.index = i;
+            if (frame.multiplanar()) {
+                buf.m.planes = planes;
+                buf.length = VIDEO_MAX_PLANES;
+            }
+            if (ioctl(fd, VIDIOC_QUERYBUF, &buf) < 0) {
+                throw std::runtime_error(std::string("VIDIOC_QUERYBUF failed: ") + strerror(errno));
+            }
+            if (!frame.multiplanar()) {
+                buffers[i].length = buf.length;
+                buffers[i].start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+                if (buffers[i].start == MAP_FAILED) throw std::runtime_error("Failed to map capture buffer");
+                continue;
+            }
+            // Each memory plane is mapped on its own
+            for (uint32_t p = 0; p < buf.length; p++) {
+                Buffer plane{nullptr, planes[p].length};
+                plane.start = mmap(nullptr, plane.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, planes[p].m.mem_offset);
+                if (plane.start == MAP_FAILED) throw std::runtime_error("Failed to map capture buffer");
+                if (p == 0) buffers[i] = plane;
+                else extraPlanes[i].push_back(plane);
+            }
+        }
+    }
+
+    // Zero-copy: export every buffer as a dma-buf and import it into Vulkan.
+    // Any failure drops back to copying through the staging buffer.
+    if (dmabufImport) {
+        for (size_t i = 0; i < buffers.size(); i++) {
+            struct v4l2_exportbuffer expbuf{};
+            expbuf.type = frame.bufferType;
+            expbuf.index = i;
+            expbuf.plane = 0;  // the zero-copy formats keep every plane in one buffer
+            expbuf.flags = O_RDONLY | O_CLOEXEC;
+            ImportedBuffer imported;
+            if (ioctl(fd, VIDIOC_EXPBUF, &expbuf) < 0 ||
+                !importDmabufBuffer(device, expbuf.fd, buffers[i].length, imported)) {
+                std::cerr << "dma-buf import of buffer " << i << " failed, falling back to copy" << std::endl;
+                for (auto& b : importedBuffers) destroyImportedBuffer(device, b);
+                importedBuffers.clear();
+                break;
+            }
+            importedBuffers.push_back(imported);
+        }
+    }
+    const bool zeroCopy = !importedBuffers.empty();
+
+    // Change detection on CPU-converted frames (raw YUYV/RGB24, or decoded
+    // MJPEG): only dirty tiles are converted and copied into the video
+    // image, and a frame without any is neither uploaded nor drawn
+    std::unique_ptr<motion::TileDetector> motionDetector;
+    if (options.motion) {
+        if (options.gpuDecode || ycbcrSampling || hostUpload) {
+            std::cout << "Motion detection needs CPU conversion and the staging upload; ignoring --motion" << std::endl;
+        } else {
+            const uint32_t bytesPerPixel = options.pixelFormat == V4L2_PIX_FMT_MJPEG  ? 4
+                                         : options.pixelFormat == V4L2_PIX_FMT_YUYV ? 2
+                                                                                    : 3;
+            motionDetector.reset(
+                new motion::TileDetector(videoWidth, videoHeight, bytesPerPixel, 64, options.motionThreshold));
+            std::cout << "Motion detection: " << motionDetector->tileSize() << "x" << motionDetector->tileSize()
+                      << " tiles, " << motionDetector->kernelName() << " SAD" << std::endl;
+        }
+    }
+    bool videoImageFilled = false;  // partial uploads keep the rest of the image
+    std::vector<VkBufferImageCopy> copyRegions;
+
+    GpuDecoder gpuDecoder;
+    if (options.gpuDecode) {
+        const char* shaderFile = "rgb24.spv";
+        uint32_t pixelsPerInvocation = 1;
+        if (options.pixelFormat == V4L2_PIX_FMT_YUYV) {
+            shaderFile = "yuyv.spv";
+            pixelsPerInvocation = 2;
+        } else if (options.pixelFormat == V4L2_PIX_FMT_NV12) {
+            shaderFile = "nv12.spv";
+        }
+        GpuDecodeParams params{};
+        params.width = videoWidth;
+        params.height = videoHeight;
+        params.stride = frame.bytesperline[0];
+        params.chromaOffset = frame.bytesperline[0] * videoHeight;
+
+        // Decode either straight from the capture buffers or from the staging slots
+        std::vector<VkDescriptorBufferInfo> sources;
+        if (zeroCopy) {
+            for (size_t i = 0; i < importedBuffers.size(); i++) {
+                sources.push_back({importedBuffers[i].buffer, 0, buffers[i].length});
+            }
+        } else {
+            for (uint32_t i = 0; i < staging.slotCount(); i++) {
+                sources.push_back({staging.buffer(), staging.offset(i), frameSize});
+            }
+        }
+        VkShaderModule decodeModule = createShaderModule(device, readFile(shaderFile));
+        gpuDecoder = createGpuDecoder(device, decodeModule, pixelsPerInvocation, params, sources, videoImageView);
+        vkDestroyShaderModule(device, decodeModule, nullptr);
+    }
+    if (replay) {
+        std::cout << "Capture: replay + staging copy" << std::endl;
+    } else if (memoryType == V4L2_MEMORY_USERPTR) {
+        std::cout << "Capture: USERPTR into imported host memory" << std::endl;
+    } else {
+        std::cout << "Capture: " << (zeroCopy ? "dma-buf zero-copy" : "mmap + staging copy") << std::endl;
     }
 
-    for (size_t i = 0; i < req.count; i++) {
-        struct v4l2_buffer buf{};
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        buf.index = i;
-        ioctl(fd, VIDIOC_QBUF, &buf);
+    enum v4l2_buf_type type = static_cast<enum v4l2_buf_type>(frame.bufferType);
+    std::unique_ptr<CaptureSource> source;
+    if (replay) {
+        source = std::move(replaySource);
+    } else {
+        for (size_t i = 0; i < buffers.size(); i++) {
+            struct v4l2_buffer buf{};
+            struct v4l2_plane planes[VIDEO_MAX_PLANES]{};
+            buf.type = frame.bufferType;
+            buf.memory = memoryType;
+            buf.index = i;
+            if (frame.multiplanar()) {
+                buf.m.planes = planes;
+                buf.length = frame.memoryPlanes;
+            }
+            if (memoryType == V4L2_MEMORY_USERPTR) {
+                buf.m.userptr = reinterpret_cast<unsigned long>(buffers[i].start);
+                buf.length = buffers[i].length;
+            }
+            if (ioctl(fd, VIDIOC_QBUF, &buf) < 0) {
+                throw std::runtime_error(std::string("VIDIOC_QBUF failed: ") + strerror(errno));
+            }
+        }
+        if (ioctl(fd, VIDIOC_STREAMON, &type) < 0) {
+            throw std::runtime_error(std::string("VIDIOC_STREAMON failed: ") + strerror(errno));
+        }
+        source.reset(new V4l2Source(fd, memoryType, buffers.size(), "v4l2", frame.bufferType));
     }
 
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    ioctl(fd, VIDIOC_STREAMON, &type);
+    // Capture runs on its own thread so a slow present never stalls DQBUF.
+    // The ring leaves room for the buffers the GPU may still be reading.
+    CaptureThread capture(std::move(source), options.dropPolicy, buffers.size() - MAX_FRAMES_IN_FLIGHT - 1);
+    auto startTime = FrameStats::Clock::now();
+
+    // Capture buffer each frame slot is reading (zero-copy only), released
+    // once the slot's fence shows the GPU is done with it
+    std::vector<CapturedFrame> slotCaptures(MAX_FRAMES_IN_FLIGHT);
+    std::vector<bool> slotHoldsCapture(MAX_FRAMES_IN_FLIGHT, false);
+    FrameStats frameStats;
+
+    // Latency of each stage since the V4L2 capture timestamp. Without
+    // present_wait the last stage is when vkQueuePresentKHR returned.
+    enum LatencyStage { STAGE_ACQUIRE, STAGE_CONVERT, STAGE_SUBMIT, STAGE_PRESENT };
+    PresentTimer presentTimer;
+    if (presentWait) presentWait = presentTimer.init(device, target.swapchain());
+    std::cout << "Present timing: " << (presentWait ? "VK_KHR_present_wait" : "vkQueuePresentKHR return") << std::endl;
+    LatencyTracker latency(replay ? options.replayPath : DEVICE,
+                           {"acquire", "convert", "submit", presentWait ? "present" : "present-call"});
+    std::unique_ptr<LatencyCsv> latencyCsv;
+    if (!options.latencyCsvPath.empty()) latencyCsv.reset(new LatencyCsv(options.latencyCsvPath));
+    double nextLatencyWindow = options.latencyInterval;
+
+    // MJPEG frames decode on a worker pool and come back in sequence order
+    std::unique_ptr<ThreadPool> decodePool;
+    std::unique_ptr<MjpegDecoder> mjpegDecoder;
+    if (options.pixelFormat == V4L2_PIX_FMT_MJPEG) {
+        decodePool.reset(new ThreadPool());
+        size_t depth = options.decodeDepth ? options.decodeDepth : decodePool->size() + 1;
+        mjpegDecoder.reset(new MjpegDecoder(*decodePool, depth));
+        std::cout << "MJPEG decode: " << decodePool->size() << " workers, depth " << depth << std::endl;
+    }
 
     // Main loop
     bool running = true;
     while (running) {
-        struct v4l2_buffer buf{};
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        ioctl(fd, VIDIOC_DQBUF, &buf);
-
-        convertRGB24toRGBA32(static_cast<uint8_t*>(buffers[buf.index].start), static_cast<uint8_t*>(mappedMemory), WIDTH, HEIGHT);
-        ioctl(fd, VIDIOC_QBUF, &buf);
-
-        vkResetCommandBuffer(commandBuffer, 0);
-        VkCommandBufferBeginInfo cmdBeginInfo{};
-        cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        vkBeginCommandBuffer(commandBuffer, &cmdBeginInfo);
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = videoImage;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.levelCount = 1;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        VkBufferImageCopy region{};
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.layerCount = 1;
-        region.imageExtent = {WIDTH, HEIGHT, 1};
-        vkCmdCopyBufferToImage(commandBuffer, frameStagingBuffer, videoImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        VkRenderPassBeginInfo rpInfo{};
-        rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        rpInfo.renderPass = renderPass;
-        rpInfo.framebuffer = swapchainFramebuffers[0]; // Simplified single buffer
-        rpInfo.renderArea.extent = extent;
-        VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-        rpInfo.clearValueCount = 1;
-        rpInfo.pClearValues = &clearColor;
-        vkCmdBeginRenderPass(commandBuffer, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-        vkCmdDraw(commandBuffer, 4, 1, 0, 0);
-        vkCmdEndRenderPass(commandBuffer);
-        vkEndCommandBuffer(commandBuffer);
-
-        VkSubmitInfo submit{};
-        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit.commandBufferCount = 1;
-        submit.pCommandBuffers = &commandBuffer;
-        vkQueueSubmit(graphicsQueue, 1, &submit, VK_NULL_HANDLE);
-
-        uint32_t imageIndex = 0;
-        VkPresentInfoKHR presentInfo{};
-        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-        presentInfo.swapchainCount = 1;
-        presentInfo.pSwapchains = &swapchain;
-        presentInfo.pImageIndices = &imageIndex;
-        vkQueuePresentKHR(presentQueue, &presentInfo);
-        vkQueueWaitIdle(presentQueue);
-
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_EVENT_QUIT) running = false;
         }
+        const uint32_t currentFrame = frames.current();
+
+        CapturedFrame captured;
+        // Low-latency mode takes the newest frame and requeues the rest at once
+        bool haveFrame = options.lowLatency ? capture.acquireLatest(captured) : capture.acquire(captured);
+        DecodedFrame decoded;
+        if (mjpegDecoder) {
+            // Hand the compressed frame to the pool and render the newest
+            // frame that is ready in sequence order
+            if (haveFrame) {
+                mjpegDecoder->submit(buffers[captured.index].start, captured.bytesused, captured.sequence,
+                                     captured.timestamp);
+                capture.release(captured);
+            }
+            haveFrame = false;
+            while (mjpegDecoder->next(decoded)) haveFrame = true;
+        }
+        if (presentTimer.enabled()) {
+            presentTimer.poll([&](int64_t captureUs) { latency.record(STAGE_PRESENT, captureUs); });
+        }
+        double elapsed = std::chrono::duration<double>(FrameStats::Clock::now() - startTime).count();
+        if (latencyCsv && elapsed >= nextLatencyWindow) {
+            latency.writeWindow(*latencyCsv, elapsed);
+            nextLatencyWindow = elapsed + options.latencyInterval;
+        }
+        if (!haveFrame) {
+            // A replay ends once the whole file has been shown
+            if (capture.stats.ended && capture.pending() == 0) break;
+            SDL_Delay(1);
+            continue;
+        }
+        int64_t captureUs = LatencyTracker::toUs(mjpegDecoder ? decoded.timestamp : captured.timestamp);
+        latency.record(STAGE_ACQUIRE, captureUs);
+
+        auto frameStart = FrameStats::Clock::now();
+        double waitSeconds = 0.0;
+
+        // A frame without a dirty tile changes nothing on screen: no upload,
+        // no draw and no present. A decoded frame of another size cannot be
+        // compared and is uploaded whole.
+        const bool fullSize = !mjpegDecoder || (decoded.width == static_cast<int>(videoWidth) &&
+                                                decoded.height == static_cast<int>(videoHeight));
+        if (motionDetector) {
+            size_t dirty;
+            if (!mjpegDecoder) {
+                dirty = motionDetector->detect(static_cast<uint8_t*>(buffers[captured.index].start),
+                                               frame.bytesperline[0]);
+            } else if (fullSize) {
+                dirty = motionDetector->detect(decoded.rgba.get(), static_cast<size_t>(decoded.width) * 4);
+            } else {
+                dirty = motionDetector->invalidate();
+            }
+            if (dirty == 0) {
+                if (!mjpegDecoder) capture.release(captured);
+                continue;
+            }
+        }
+
+        // Fill a free staging slot before waiting on the frame slot's fence,
+        // so the conversion overlaps the GPU work of the frames in flight
+        uint32_t stagingSlot = 0;
+        if (!zeroCopy && !hostUpload) {
+            waitSeconds += frames.acquireStaging(staging, stagingSlot);
+            uint8_t* slotData = staging.data(stagingSlot);
+            const uint8_t* pixels = static_cast<uint8_t*>(buffers[captured.index].start);
+            if (motionDetector && fullSize) {
+                // Only the dirty tiles; the rest of the slot is never copied to the image
+                const size_t srcStride = mjpegDecoder ? static_cast<size_t>(videoWidth) * 4 : frame.bytesperline[0];
+                const uint8_t* src = mjpegDecoder ? decoded.rgba.get() : pixels;
+                motionDetector->forEachDirtyRun([&](uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+                    uint8_t* dst = slotData + (static_cast<size_t>(y) * videoWidth + x) * 4;
+                    if (mjpegDecoder) {
+                        for (uint32_t row = 0; row < h; row++) {
+                            memcpy(dst + static_cast<size_t>(row) * videoWidth * 4,
+                                   src + (y + row) * srcStride + static_cast<size_t>(x) * 4, static_cast<size_t>(w) * 4);
+                        }
+                    } else {
+                        const size_t bytesPerPixel = options.pixelFormat == V4L2_PIX_FMT_YUYV ? 2 : 3;
+                        pixconv::convertFrame(rowFn, src + y * srcStride + x * bytesPerPixel, srcStride, dst,
+                                              videoWidth * 4, w, h);
+                    }
+                });
+            } else if (mjpegDecoder) {
+                uint32_t rows = std::min<uint32_t>(decoded.height, videoHeight);
+                size_t rowBytes = std::min<size_t>(decoded.width, videoWidth) * 4;
+                for (uint32_t y = 0; y < rows; y++) {
+                    memcpy(slotData + static_cast<size_t>(y) * videoWidth * 4,
+                           decoded.rgba.get() + static_cast<size_t>(y) * decoded.width * 4, rowBytes);
+                }
+            } else if (options.gpuDecode || (ycbcrSampling && frame.memoryPlanes == 1)) {
+                // Upload the raw frame untouched; the GPU converts it
+                memcpy(slotData, pixels, std::min<size_t>(captured.bytesused, frameSize));
+            } else if (ycbcrSampling) {
+                // Gather the separately mapped planes into one slot
+                memcpy(slotData, pixels, frame.sizeimage[0]);
+                const std::vector<Buffer>& planes = extraPlanes[captured.index];
+                for (uint32_t p = 1; p < frame.memoryPlanes && p <= planes.size(); p++) {
+                    memcpy(slotData + frame.packedOffset(p), planes[p - 1].start, frame.sizeimage[p]);
+                }
+            } else {
+                pixconv::convertFrame(rowFn, pixels, frame.bytesperline[0], slotData, videoWidth * 4, videoWidth,
+                                      videoHeight);
+            }
+            if (!mjpegDecoder) capture.release(captured);
+        }
+        if (!hostUpload) latency.record(STAGE_CONVERT, captureUs);
+        double convertSeconds =
+            std::chrono::duration<double>(FrameStats::Clock::now() - frameStart).count() - waitSeconds;
+
+        // Wait until the GPU is done with this frame slot, then recycle what it used
+        waitSeconds += frames.wait(staging);
+        double gpuSeconds = frames.gpuSeconds();
+        if (postChain) postChain.collect(currentFrame);
+        if (slotHoldsCapture[currentFrame]) {
+            capture.release(slotCaptures[currentFrame]);
+            slotHoldsCapture[currentFrame] = false;
+        }
+        if (zeroCopy) {
+            // The GPU reads the capture buffer directly; it is requeued once the slot's fence signals
+            slotCaptures[currentFrame] = captured;
+            slotHoldsCapture[currentFrame] = true;
+        }
+        if (hostUpload) {
+            // The frame that last sampled this slot's image has finished
+            auto uploadStart = FrameStats::Clock::now();
+            const uint8_t* pixels = static_cast<uint8_t*>(buffers[captured.index].start);
+            if (options.upload == UploadPath::Linear) {
+                uint8_t* mapped = uploader.pixels(currentFrame);
+                size_t rowPitch = uploader.rowPitch(currentFrame);
+                if (mjpegDecoder) {
+                    uint32_t rows = std::min<uint32_t>(decoded.height, videoHeight);
+                    size_t rowBytes = std::min<size_t>(decoded.width, videoWidth) * 4;
+                    for (uint32_t y = 0; y < rows; y++) {
+                        memcpy(mapped + y * rowPitch, decoded.rgba.get() + static_cast<size_t>(y) * decoded.width * 4,
+                               rowBytes);
+                    }
+                } else {
+                    pixconv::convertFrame(rowFn, pixels, frame.bytesperline[0], mapped, rowPitch, videoWidth,
+                                          videoHeight);
+                }
+            } else if (mjpegDecoder) {
+                // A decoded frame of another size is copied where it overlaps, as on the other paths
+                uploader.copy(currentFrame, decoded.rgba.get(), static_cast<uint32_t>(decoded.width),
+                              static_cast<uint32_t>(decoded.height));
+            } else {
+                pixconv::convertFrame(rowFn, pixels, frame.bytesperline[0], hostFrame.data(), videoWidth * 4,
+                                      videoWidth, videoHeight);
+                uploader.copy(currentFrame, hostFrame.data(), videoWidth, videoHeight);
+            }
+            if (!mjpegDecoder) capture.release(captured);
+            latency.record(STAGE_CONVERT, captureUs);
+            convertSeconds += std::chrono::duration<double>(FrameStats::Clock::now() - uploadStart).count();
+        }
+
+        uint32_t imageIndex;
+        if (!frames.acquireImage(target, imageIndex, &presentTimer)) {
+            // Nothing is drawn; a zero-copy capture buffer stays with the
+            // frame slot until its next use. The skipped tiles were never
+            // uploaded, so the next frame must upload everything.
+            if (motionDetector) motionDetector->invalidate();
+            continue;
+        }
+        auto recordStart = FrameStats::Clock::now();
+
+        VkCommandBuffer cmd = frames.begin();
+
+        if (options.gpuDecode) {
+            recordGpuDecode(cmd, gpuDecoder, zeroCopy ? captured.index : stagingSlot, videoImage);
+        } else if (ycbcrSampling) {
+            ycbcrImage.recordUpload(cmd, staging.buffer(), staging.offset(stagingSlot));
+        } else if (hostUpload) {
+            uploader.recordFirstUse(cmd, currentFrame);
+        } else {
+            // The previous frame may still be sampling the video image. With
+            // partial uploads the untouched tiles must survive the transition.
+            const bool partial = motionDetector && videoImageFilled;
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = partial ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = videoImage;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = 1;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = staging.offset(stagingSlot);
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = {videoWidth, videoHeight, 1};
+            copyRegions.assign(1, region);
+            if (partial) {
+                // One region per run of dirty tiles, read in place from the full-frame slot layout
+                copyRegions.clear();
+                motionDetector->forEachDirtyRun([&](uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+                    region.bufferOffset = staging.offset(stagingSlot) + (static_cast<VkDeviceSize>(y) * videoWidth + x) * 4;
+                    region.bufferRowLength = videoWidth;
+                    region.imageOffset = {static_cast<int32_t>(x), static_cast<int32_t>(y), 0};
+                    region.imageExtent = {w, h, 1};
+                    copyRegions.push_back(region);
+                });
+            }
+            vkCmdCopyBufferToImage(cmd, staging.buffer(), videoImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+            videoImageFilled = true;
+
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+        if (postChain) postChain.record(cmd, hostUpload ? currentFrame : 0, currentFrame);
+
+        target.beginRenderPass(cmd, imageIndex);
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer, offsets);
+        VkDescriptorSet drawSet = postChain ? postSet : hostUpload ? uploadSets[currentFrame] : descriptorSet;
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &drawSet, 0, nullptr);
+        vkCmdDraw(cmd, 4, 1, 0, 0);
+        vkCmdEndRenderPass(cmd);
+        uint64_t serial = frames.submit(graphicsQueue, target, imageIndex);
+        if (!zeroCopy) staging.submit(stagingSlot, serial);
+        latency.record(STAGE_SUBMIT, captureUs);
+
+        frames.present(display.presentQueue, target, imageIndex, &presentTimer, captureUs);
+        if (!presentTimer.enabled()) latency.record(STAGE_PRESENT, captureUs);
+
+        auto cpuEnd = FrameStats::Clock::now();
+        frameStats.addFrame(convertSeconds + std::chrono::duration<double>(cpuEnd - recordStart).count(), waitSeconds,
+                            gpuSeconds);
+        frameStats.reportIfDue(capture.stats.skipped);
+        if (postChain) postChain.reportIfDue();
+
+        frames.advance();
+    }
+    vkDeviceWaitIdle(device);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (slotHoldsCapture[i]) capture.release(slotCaptures[i]);
+    }
+    capture.stop();
+    capture.stats.print("Capture");
+    if (replay) {
+        double elapsed = std::chrono::duration<double>(FrameStats::Clock::now() - startTime).count();
+        std::cout << "Replay: " << capture.stats.rendered / elapsed << " frames/s rendered over " << elapsed << " s"
+                  << std::endl;
+    }
+    if (mjpegDecoder) mjpegDecoder->stats.print("MJPEG");
+    if (motionDetector) motionDetector->stats.print("Motion");
+    if (!zeroCopy && !hostUpload) staging.stats.print("Staging", staging.slotCount());
+    frameStats.printTotals((std::string("Upload, ") + uploadPathName(options.upload)).c_str());
+    if (postChain) postChain.printTotals("Post-processing");
+    if (presentTimer.enabled()) {
+        presentTimer.poll([&](int64_t captureUs) { latency.record(STAGE_PRESENT, captureUs); });
+    }
+    latency.print();
+    if (latencyCsv) {
+        double elapsed = std::chrono::duration<double>(FrameStats::Clock::now() - startTime).count();
+        latency.writeWindow(*latencyCsv, elapsed);
+        latency.writeTotals(*latencyCsv, elapsed);
     }
 
     // Cleanup
-    vkUnmapMemory(device, frameStagingMemory);
-    vkDestroyBuffer(device, frameStagingBuffer, nullptr);
-    vkFreeMemory(device, frameStagingMemory, nullptr);
+    if (options.gpuDecode) destroyGpuDecoder(device, gpuDecoder);
+    postChain.destroy();
+    for (auto& b : importedBuffers) destroyImportedBuffer(device, b);
+    staging.destroy();
+    uploader.destroy();
+    ycbcrImage.destroy();
     vkDestroyImageView(device, videoImageView, nullptr);
     vkDestroyImage(device, videoImage, nullptr);
     vkFreeMemory(device, videoImageMemory, nullptr);
@@ -741,20 +1532,25 @@ int main() {
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
     vkDestroyPipeline(device, graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-    for (auto fb : swapchainFramebuffers) vkDestroyFramebuffer(device, fb, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
-    for (auto iv : swapchainImageViews) vkDestroyImageView(device, iv, nullptr);
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
-    vkDestroyCommandPool(device, commandPool, nullptr);
+    target.destroy();
+    frames.destroy();
     vkDestroyBuffer(device, vertexBuffer, nullptr);
     vkFreeMemory(device, vertexBufferMemory, nullptr);
-    vkDestroyDevice(device, nullptr);
+    display.destroy();
     vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyInstance(instance, nullptr);
 
-    ioctl(fd, VIDIOC_STREAMOFF, &type);
-    for (auto& buf : buffers) munmap(buf.start, buf.length);
-    close(fd);
+    if (!replay) {
+        ioctl(fd, VIDIOC_STREAMOFF, &type);
+        close(fd);
+        for (auto& buf : buffers) {
+            if (memoryType == V4L2_MEMORY_USERPTR) free(buf.start);
+            else munmap(buf.start, buf.length);
+        }
+        for (auto& planes : extraPlanes) {
+            for (auto& plane : planes) munmap(plane.start, plane.length);
+        }
+    }
 
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -0,0 +1,786 @@
+#ifndef VIDEO_WALL_H
+#define VIDEO_WALL_H
+
+// Video wall: many streams composited into one swapchain image.
+//
+// Every stream (a V4L2 device or a replayed recording) is a source of one
+// CaptureLoop, so a single epoll thread serves them all. Each render frame
+// acquire() takes the newest frame of every stream that has one, and
+// convert() turns them into RGBA with the SIMD converters, streams in
+// parallel on a thread pool, each into its own slice of one staging slot.
+// recordUpload() copies them into their layers of a single RGBA texture
+// array with one vkCmdCopyBufferToImage (a region per updated stream), and
+// recordDraw() puts every tile on screen with one instanced draw: the
+// instance index picks the tile's cell in the grid and its entry in a small
+// tile table, which holds the array layer to sample, the part of the layer
+// the stream fills (streams may differ in size) and a shade that dims a
+// stream that stopped delivering.
+//
+// However many streams there are, a frame is one submission with one copy
+// and one draw. What grows with the stream count is the conversion and the
+// bytes copied, and both are reported per stream.
+
+#include "capture_loop.h"
+#include "format_negotiation.h"
+#include "pixel_convert.h"
+#include "replay_source.h"
+#include "staging_ring.h"
+#include "thread_pool.h"
+#include "latency_stats.h"
+
+#include <vulkan/vulkan.h>
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct WallSource {
+    std::string path;
+    bool replay = false;  // a raw recording rather than a capture device
+};
+
+struct WallSettings {
+    std::vector<WallSource> sources;  // --wall-device DEV, --wall-replay FILE, in tile order
+    uint32_t width = 1280;            // --wall-size WxH: window size
+    uint32_t height = 720;
+};
+
+// Push constants of wall.vert
+struct WallGrid {
+    uint32_t columns;
+    uint32_t rows;
+    float gap[2];  // space between tiles, in normalized device coordinates
+};
+
+// Tile table entry, std430 layout as in wall.vert
+struct WallTile {
+    float uvScale[2];  // stream size / layer size
+    uint32_t layer;    // texture array layer holding the stream
+    float shade;       // 1 while the stream delivers, dimmed once it stalls
+};
+
+class VideoWall {
+public:
+    static constexpr size_t MAX_STREAMS = 64;
+    static constexpr uint32_t BUFFERS_PER_STREAM = 4;
+    static constexpr double STALL_SECONDS = 1.0;  // without a frame before the tile dims
+
+    ~VideoWall() { stop(); }
+
+    // Opens every source in `settings`. Devices negotiate `request` against
+    // `paths`, which must all be CPU-converted formats (YUYV, RGB24);
+    // recordings are read as --format (YUYV by default) at --size and paced
+    // at `replayFps`. Throws naming the stream that failed.
+    void open(const WallSettings& settings, const negotiation::Request& request,
+              const std::vector<negotiation::RenderPath>& paths, double replayFps, bool replayLoop,
+              DropPolicy policy) {
+        const pixconv::PixelConverter& converter = pixconv::bestPixelConverter();
+        for (const WallSource& source : settings.sources) {
+            Stream s;
+            s.name = source.path;
+            std::unique_ptr<CaptureSource> captureSource;
+            try {
+                if (source.replay) {
+                    s.fourcc = request.fourcc ? request.fourcc : V4L2_PIX_FMT_YUYV;
+                    s.width = request.width;
+                    s.height = request.height;
+                    std::unique_ptr<ReplaySource> replay(
+                        new ReplaySource(source.path, ReplaySource::frameBytes(s.fourcc, s.width, s.height),
+                                         replayFps, replayLoop, BUFFERS_PER_STREAM));
+                    for (uint32_t i = 0; i < replay->bufferCount(); i++) s.buffers.push_back(replay->buffer(i));
+                    captureSource = std::move(replay);
+                } else {
+                    captureSource = openDevice(s, request, paths);
+                }
+                s.bytesperline = s.fourcc == V4L2_PIX_FMT_YUYV ? s.width * 2 : s.width * 3;
+                if (s.fourcc == V4L2_PIX_FMT_YUYV) s.rowFn = converter.yuyvToRgba;
+                else if (s.fourcc == V4L2_PIX_FMT_RGB24) s.rowFn = converter.rgb24ToRgba;
+                else throw std::runtime_error(s.name + ": the wall takes YUYV or RGB24 only");
+            } catch (...) {
+                // Not in `streams` yet, so stop() would never see it
+                closeDevice(s);
+                throw;
+            }
+            if (s.fd >= 0) s.bytesperline = std::max(s.bytesperline, s.deviceStride);
+            streams.push_back(std::move(s));
+            capture.addSource(std::move(captureSource), policy);
+        }
+        if (streams.empty()) throw std::runtime_error("The wall needs at least one stream");
+
+        // Every layer is as big as the largest stream
+        for (const Stream& s : streams) {
+            layerWidth = std::max(layerWidth, s.width);
+            layerHeight = std::max(layerHeight, s.height);
+        }
+        sliceBytes = (static_cast<VkDeviceSize>(layerWidth) * layerHeight * 4 + 255) & ~VkDeviceSize(255);
+        printf("Wall: %zu streams in %ux%u layers, converter %s\n", streams.size(), layerWidth, layerHeight,
+               converter.name);
+    }
+
+    // Creates the texture array, the tile table, the pipeline for
+    // `renderPass` at `extent` and a staging ring of `stagingSlots` slots,
+    // each holding a slice per stream. `loadShader` returns a module for a
+    // .spv file name; the wall destroys it.
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue queue,
+                VkRenderPass renderPass, VkExtent2D extent, uint32_t stagingSlots,
+                const std::function<VkShaderModule(const std::string&)>& loadShader) {
+        this->device = device;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physicalDevice, &props);
+        if (streams.size() > props.limits.maxImageArrayLayers) {
+            throw std::runtime_error("The GPU takes at most " + std::to_string(props.limits.maxImageArrayLayers) +
+                                     " wall streams");
+        }
+
+        staging.create(device, physicalDevice, sliceBytes * streams.size(), stagingSlots,
+                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {layerWidth, layerHeight, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = static_cast<uint32_t>(streams.size());
+        imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create wall texture array");
+        }
+        VkMemoryRequirements memReqs;
+        vkGetImageMemoryRequirements(device, image, &memReqs);
+        imageMemory = allocate(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        vkBindImageMemory(device, image, imageMemory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = static_cast<uint32_t>(streams.size());
+        if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create wall texture array view");
+        }
+
+        // Tile i shows stream i from layer i
+        tiles.resize(streams.size());
+        for (size_t i = 0; i < streams.size(); i++) {
+            tiles[i].uvScale[0] = static_cast<float>(streams[i].width) / layerWidth;
+            tiles[i].uvScale[1] = static_cast<float>(streams[i].height) / layerHeight;
+            tiles[i].layer = static_cast<uint32_t>(i);
+            tiles[i].shade = 1.0f;
+        }
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = tiles.size() * sizeof(WallTile);
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkCreateBuffer(device, &bufferInfo, nullptr, &tileBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create wall tile table");
+        }
+        vkGetBufferMemoryRequirements(device, tileBuffer, &memReqs);
+        tileMemory = allocate(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        vkBindBufferMemory(device, tileBuffer, tileMemory, 0);
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create wall sampler");
+        }
+
+        createPipeline(renderPass, extent, loadShader);
+        createDescriptors();
+        clear(commandPool, queue);
+
+        // As square a grid as the stream count allows, with a 2 pixel gap
+        grid.columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(streams.size()))));
+        grid.rows = static_cast<uint32_t>((streams.size() + grid.columns - 1) / grid.columns);
+        grid.gap[0] = 4.0f / extent.width;
+        grid.gap[1] = 4.0f / extent.height;
+        printf("Wall: %ux%u tiles of %ux%u pixels, %.1f MB per staging slot\n", grid.columns, grid.rows,
+               extent.width / grid.columns, extent.height / grid.rows, sliceBytes * streams.size() / 1e6);
+    }
+
+    void start() {
+        auto now = Clock::now();
+        for (Stream& s : streams) s.lastFrame = now;
+        periodStart = runStart = now;
+        capture.start();
+    }
+
+    // Stops capturing and closes the devices; call once the GPU is idle
+    void stop() {
+        capture.stop();
+        for (Stream& s : streams) {
+            if (s.held) {
+                capture.release(&s - &streams[0], s.frame);
+                s.held = false;
+            }
+            closeDevice(s);
+        }
+    }
+
+    void destroy() {
+        staging.destroy();
+        if (pipeline) vkDestroyPipeline(device, pipeline, nullptr);
+        if (pipelineLayout) vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        if (descriptorPool) vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        if (setLayout) vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+        if (sampler) vkDestroySampler(device, sampler, nullptr);
+        if (tileBuffer) vkDestroyBuffer(device, tileBuffer, nullptr);
+        if (tileMemory) vkFreeMemory(device, tileMemory, nullptr);
+        if (imageView) vkDestroyImageView(device, imageView, nullptr);
+        if (image) vkDestroyImage(device, image, nullptr);
+        if (imageMemory) vkFreeMemory(device, imageMemory, nullptr);
+        pipeline = VK_NULL_HANDLE;
+        pipelineLayout = VK_NULL_HANDLE;
+        descriptorPool = VK_NULL_HANDLE;
+        setLayout = VK_NULL_HANDLE;
+        sampler = VK_NULL_HANDLE;
+        tileBuffer = VK_NULL_HANDLE;
+        tileMemory = VK_NULL_HANDLE;
+        imageView = VK_NULL_HANDLE;
+        image = VK_NULL_HANDLE;
+        imageMemory = VK_NULL_HANDLE;
+    }
+
+    size_t streamCount() const { return streams.size(); }
+
+    // Render thread: takes the newest frame of every stream that has one and
+    // dims or restores tiles. False if nothing on screen would change.
+    bool acquire() {
+        updated.clear();
+        auto now = Clock::now();
+        for (size_t i = 0; i < streams.size(); i++) {
+            Stream& s = streams[i];
+            if (capture.acquireLatest(i, s.frame)) {
+                s.held = true;
+                s.lastFrame = now;
+                updated.push_back(i);
+            }
+            const bool stalled = std::chrono::duration<double>(now - s.lastFrame).count() > STALL_SECONDS;
+            const float shade = stalled ? 0.35f : 1.0f;
+            if (tiles[i].shade != shade) {
+                tiles[i].shade = shade;
+                tilesChanged = true;
+            }
+        }
+        return !updated.empty() || tilesChanged;
+    }
+
+    // Converts the acquired frames into staging slot `slot`, one stream per
+    // pool task, and hands their capture buffers back
+    void convert(uint32_t slot) {
+        uint8_t* base = staging.data(slot);
+        pool.parallelFor(updated.size(), [&](size_t n) {
+            const size_t i = updated[n];
+            const Stream& s = streams[i];
+            pixconv::convertFrame(s.rowFn, static_cast<const uint8_t*>(s.buffers[s.frame.index]), s.bytesperline,
+                                  base + i * sliceBytes, static_cast<size_t>(s.width) * 4, s.width, s.height);
+        });
+        for (size_t i : updated) {
+            Stream& s = streams[i];
+            capture.release(i, s.frame);
+            s.held = false;
+            const uint64_t bytes = static_cast<uint64_t>(s.width) * s.height * 4;
+            s.frames++;
+            s.bytes += bytes;
+            s.periodFrames++;
+            s.periodBytes += bytes;
+        }
+    }
+
+    // Every stream ran out (non-looping replays) and nothing is left to show
+    bool ended() {
+        for (size_t i = 0; i < streams.size(); i++) {
+            if (!capture.stats(i).ended || capture.pending(i) > 0) return false;
+        }
+        return true;
+    }
+
+    // Copies the streams converted into `slot` into their layers, and the
+    // tile table if it changed. Outside the render pass.
+    void recordUpload(VkCommandBuffer cmd, uint32_t slot) {
+        if (tilesChanged) {
+            // The previous frame's vertex shader may still be reading the table
+            VkBufferMemoryBarrier tableBarrier{};
+            tableBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            tableBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            tableBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            tableBarrier.buffer = tileBuffer;
+            tableBarrier.size = VK_WHOLE_SIZE;
+            tableBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                 nullptr, 1, &tableBarrier, 0, nullptr);
+            vkCmdUpdateBuffer(cmd, tileBuffer, 0, tiles.size() * sizeof(WallTile), tiles.data());
+            tableBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            tableBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0,
+                                 nullptr, 1, &tableBarrier, 0, nullptr);
+            tilesChanged = false;
+        }
+        if (updated.empty()) return;
+
+        // Only the updated layers change layout; a stream smaller than the
+        // layer leaves the rest of it as it was
+        layerBarriers.clear();
+        copyRegions.clear();
+        for (size_t i : updated) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.baseArrayLayer = static_cast<uint32_t>(i);
+            barrier.subresourceRange.layerCount = 1;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            layerBarriers.push_back(barrier);
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = staging.offset(slot) + i * sliceBytes;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.baseArrayLayer = static_cast<uint32_t>(i);
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = {streams[i].width, streams[i].height, 1};
+            copyRegions.push_back(region);
+        }
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr, 0, nullptr, static_cast<uint32_t>(layerBarriers.size()), layerBarriers.data());
+        vkCmdCopyBufferToImage(cmd, staging.buffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+        for (VkImageMemoryBarrier& barrier : layerBarriers) {
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                             nullptr, 0, nullptr, static_cast<uint32_t>(layerBarriers.size()), layerBarriers.data());
+    }
+
+    // Every tile in one draw: six vertices per tile, one instance per tile
+    void recordDraw(VkCommandBuffer cmd) {
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0,
+                                nullptr);
+        vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(WallGrid), &grid);
+        vkCmdDraw(cmd, 6, static_cast<uint32_t>(tiles.size()), 0, 0);
+    }
+
+    // Time since the previous presented frame
+    void addFrame(int64_t intervalUs) {
+        periodIntervals.add(intervalUs);
+        runIntervals.add(intervalUs);
+    }
+
+    // Frames the streams delivered but the wall passed over for newer ones
+    uint64_t skipped() {
+        uint64_t total = 0;
+        for (size_t i = 0; i < streams.size(); i++) total += capture.stats(i).skipped;
+        return total;
+    }
+
+    // Once a second: the frame interval, then each stream's rate and upload bandwidth
+    void reportIfDue() {
+        auto now = Clock::now();
+        double seconds = std::chrono::duration<double>(now - periodStart).count();
+        if (seconds < 1.0) return;
+        uint64_t bytes = 0;
+        for (const Stream& s : streams) bytes += s.periodBytes;
+        printf("wall: %zu streams | frame p50 %.2f ms p99 %.2f ms max %.2f ms | upload %.1f MB/s\n", streams.size(),
+               periodIntervals.percentile(50) / 1e3, periodIntervals.percentile(99) / 1e3,
+               periodIntervals.max() / 1e3, bytes / seconds / 1e6);
+        for (Stream& s : streams) {
+            printf("  %-24s %5.1f fps %7.1f MB/s%s\n", s.name.c_str(), s.periodFrames / seconds,
+                   s.periodBytes / seconds / 1e6, tiles[&s - &streams[0]].shade < 1.0f ? "  (stalled)" : "");
+            s.periodFrames = 0;
+            s.periodBytes = 0;
+        }
+        periodIntervals.reset();
+        periodStart = now;
+    }
+
+    void printTotals() {
+        double seconds = std::chrono::duration<double>(Clock::now() - runStart).count();
+        if (seconds <= 0) return;
+        uint64_t bytes = 0;
+        for (const Stream& s : streams) bytes += s.bytes;
+        printf("Wall: %zu streams over %.1f s, frame p50 %.2f ms p99 %.2f ms max %.2f ms, %.1f MB/s uploaded\n",
+               streams.size(), seconds, runIntervals.percentile(50) / 1e3, runIntervals.percentile(99) / 1e3,
+               runIntervals.max() / 1e3, bytes / seconds / 1e6);
+        for (size_t i = 0; i < streams.size(); i++) {
+            const Stream& s = streams[i];
+            printf("  %-24s %5.1f fps %7.1f MB/s, ", s.name.c_str(), s.frames / seconds, s.bytes / seconds / 1e6);
+            capture.stats(i).print("capture");
+        }
+    }
+
+    StagingRing staging;  // a slice per stream in every slot
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Stream {
+        std::string name;
+        int fd = -1;                  // devices only
+        std::vector<void*> buffers;   // capture buffers, or the replay slots
+        std::vector<size_t> lengths;  // of the mapped device buffers
+        uint32_t fourcc = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t bytesperline = 0;
+        uint32_t deviceStride = 0;    // as the driver reported it
+        pixconv::RowFn rowFn = nullptr;
+        CapturedFrame frame;          // acquired, not yet converted
+        bool held = false;
+        Clock::time_point lastFrame;
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        uint64_t periodFrames = 0;
+        uint64_t periodBytes = 0;
+    };
+
+    // Stops a capture device and unmaps whatever openDevice() got as far as mapping
+    static void closeDevice(Stream& s) {
+        if (s.fd < 0) return;
+        int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        ioctl(s.fd, VIDIOC_STREAMOFF, &type);
+        for (size_t i = 0; i < s.lengths.size(); i++) munmap(s.buffers[i], s.lengths[i]);
+        s.buffers.clear();
+        s.lengths.clear();
+        close(s.fd);
+        s.fd = -1;
+    }
+
+    // Negotiates, maps and queues the buffers of a capture device and starts it
+    std::unique_ptr<CaptureSource> openDevice(Stream& s, const negotiation::Request& request,
+                                              const std::vector<negotiation::RenderPath>& paths) {
+        s.fd = ::open(s.name.c_str(), O_RDWR);
+        if (s.fd < 0) throw std::runtime_error("Opening video device " + s.name + ": " + strerror(errno));
+        struct v4l2_capability cap{};
+        if (ioctl(s.fd, VIDIOC_QUERYCAP, &cap) < 0 || !(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE)) {
+            throw std::runtime_error(s.name + " is not a capture device");
+        }
+        negotiation::Choice choice;
+        const struct v4l2_format fmt = negotiation::negotiate(s.fd, paths, request, s.name, choice);
+        s.fourcc = fmt.fmt.pix.pixelformat;
+        s.width = fmt.fmt.pix.width;
+        s.height = fmt.fmt.pix.height;
+        s.deviceStride = fmt.fmt.pix.bytesperline;
+
+        struct v4l2_requestbuffers req{};
+        req.count = BUFFERS_PER_STREAM;
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        req.memory = V4L2_MEMORY_MMAP;
+        if (ioctl(s.fd, VIDIOC_REQBUFS, &req) < 0 || req.count == 0) {
+            throw std::runtime_error("VIDIOC_REQBUFS failed on " + s.name);
+        }
+        for (uint32_t i = 0; i < req.count; i++) {
+            struct v4l2_buffer buf{};
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = V4L2_MEMORY_MMAP;
+            buf.index = i;
+            if (ioctl(s.fd, VIDIOC_QUERYBUF, &buf) < 0) {
+                throw std::runtime_error("VIDIOC_QUERYBUF failed on " + s.name);
+            }
+            void* start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, s.fd, buf.m.offset);
+            if (start == MAP_FAILED) throw std::runtime_error("mmap failed on " + s.name);
+            s.buffers.push_back(start);
+            s.lengths.push_back(buf.length);
+            if (ioctl(s.fd, VIDIOC_QBUF, &buf) < 0) throw std::runtime_error("VIDIOC_QBUF failed on " + s.name);
+        }
+        int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if (ioctl(s.fd, VIDIOC_STREAMON, &type) < 0) {
+            throw std::runtime_error("VIDIOC_STREAMON failed on " + s.name);
+        }
+        return std::unique_ptr<CaptureSource>(new V4l2Source(s.fd, V4L2_MEMORY_MMAP, req.count, s.name));
+    }
+
+    VkDeviceMemory allocate(const VkMemoryRequirements& memReqs, VkMemoryPropertyFlags wanted) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memReqs.size;
+        allocInfo.memoryTypeIndex = UINT32_MAX;
+        for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+            if ((memReqs.memoryTypeBits & (1 << i)) && (memProps.memoryTypes[i].propertyFlags & wanted) == wanted) {
+                allocInfo.memoryTypeIndex = i;
+                break;
+            }
+        }
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+            vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate wall memory");
+        }
+        return memory;
+    }
+
+    // No vertex buffer: wall.vert builds each tile's quad from the vertex
+    // and instance indices
+    void createPipeline(VkRenderPass renderPass, VkExtent2D extent,
+                        const std::function<VkShaderModule(const std::string&)>& loadShader) {
+        VkDescriptorSetLayoutBinding bindings[2]{};
+        bindings[0].binding = 0;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[0].descriptorCount = 1;
+        bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        bindings[1].binding = 1;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[1].descriptorCount = 1;
+        bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 2;
+        layoutInfo.pBindings = bindings;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create wall descriptor set layout");
+        }
+
+        VkPushConstantRange pushRange{};
+        pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushRange.size = sizeof(WallGrid);
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create wall pipeline layout");
+        }
+
+        VkShaderModule vertModule = loadShader("wall_vert.spv");
+        VkShaderModule fragModule = loadShader("wall_frag.spv");
+        VkPipelineShaderStageCreateInfo shaderStages[2]{};
+        shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        shaderStages[0].module = vertModule;
+        shaderStages[0].pName = "main";
+        shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        shaderStages[1].module = fragModule;
+        shaderStages[1].pName = "main";
+
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        VkViewport viewport{};
+        viewport.width = static_cast<float>(extent.width);
+        viewport.height = static_cast<float>(extent.height);
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor{};
+        scissor.extent = extent;
+        VkPipelineViewportStateCreateInfo viewportState{};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.pViewports = &viewport;
+        viewportState.scissorCount = 1;
+        viewportState.pScissors = &scissor;
+
+        VkPipelineRasterizationStateCreateInfo rasterizer{};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.cullMode = VK_CULL_MODE_NONE;
+        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        rasterizer.lineWidth = 1.0f;
+
+        VkPipelineMultisampleStateCreateInfo multisampling{};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                              VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        VkPipelineColorBlendStateCreateInfo colorBlending{};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &colorBlendAttachment;
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.renderPass = renderPass;
+        pipelineInfo.subpass = 0;
+        VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+        vkDestroyShaderModule(device, vertModule, nullptr);
+        vkDestroyShaderModule(device, fragModule, nullptr);
+        if (result != VK_SUCCESS) throw std::runtime_error("Failed to create wall pipeline");
+    }
+
+    void createDescriptors() {
+        VkDescriptorPoolSize poolSizes[2]{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[0].descriptorCount = 1;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[1].descriptorCount = 1;
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = poolSizes;
+        poolInfo.maxSets = 1;
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create wall descriptor pool");
+        }
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &setLayout;
+        if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate wall descriptor set");
+        }
+
+        VkDescriptorImageInfo imageDescInfo{};
+        imageDescInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageDescInfo.imageView = imageView;
+        imageDescInfo.sampler = sampler;
+        VkDescriptorBufferInfo tableInfo{};
+        tableInfo.buffer = tileBuffer;
+        tableInfo.range = VK_WHOLE_SIZE;
+        VkWriteDescriptorSet writes[2]{};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = descriptorSet;
+        writes[0].dstBinding = 0;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].descriptorCount = 1;
+        writes[0].pImageInfo = &imageDescInfo;
+        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstSet = descriptorSet;
+        writes[1].dstBinding = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[1].descriptorCount = 1;
+        writes[1].pBufferInfo = &tableInfo;
+        vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    }
+
+    // Black layers until each stream's first frame, and the initial tile
+    // table, with a one-shot command buffer. Every layer is left in
+    // SHADER_READ_ONLY_OPTIMAL, which recordUpload() relies on.
+    void clear(VkCommandPool commandPool, VkQueue queue) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer cmd;
+        vkAllocateCommandBuffers(device, &allocInfo, &cmd);
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(cmd, &beginInfo);
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = static_cast<uint32_t>(streams.size());
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                             nullptr, 1, &barrier);
+        VkClearColorValue black{};
+        black.float32[3] = 1.0f;
+        vkCmdClearColorImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &barrier.subresourceRange);
+        vkCmdUpdateBuffer(cmd, tileBuffer, 0, tiles.size() * sizeof(WallTile), tiles.data());
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        VkMemoryBarrier tableWritten{};
+        tableWritten.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        tableWritten.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        tableWritten.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1,
+                             &tableWritten, 0, nullptr, 1, &barrier);
+        vkEndCommandBuffer(cmd);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd;
+        vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueWaitIdle(queue);
+        vkFreeCommandBuffers(device, commandPool, 1, &cmd);
+    }
+
+    std::vector<Stream> streams;
+    CaptureLoop capture;
+    ThreadPool pool;
+    uint32_t layerWidth = 0;
+    uint32_t layerHeight = 0;
+    VkDeviceSize sliceBytes = 0;  // per stream in a staging slot, 256-byte aligned
+
+    std::vector<size_t> updated;  // streams acquired for this frame
+    std::vector<WallTile> tiles;
+    bool tilesChanged = false;
+    WallGrid grid{};
+    std::vector<VkImageMemoryBarrier> layerBarriers;
+    std::vector<VkBufferImageCopy> copyRegions;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memProps{};
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkBuffer tileBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory tileMemory = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    LatencyHistogram periodIntervals;
+    LatencyHistogram runIntervals;
+    Clock::time_point periodStart;
+    Clock::time_point runStart;
+};
+
+#endif // VIDEO_WALL_H
@@ -0,0 +1,298 @@
+#ifndef YCBCR_IMAGE_H
+#define YCBCR_IMAGE_H
+
+// Multi-planar video image sampled through a VkSamplerYcbcrConversion.
+//
+// NV12 and YUV420 frames (single- or multi-planar V4L2 buffers alike) are
+// copied plane by plane from a staging slot into a G8_B8R8_2PLANE_420 or
+// G8_B8_R8_3PLANE_420 image. The conversion attached to the sampler turns
+// Y'CbCr into RGB while the fragment shader samples, with the chroma
+// upsampling done by the texture unit, so the frame is never converted on
+// the CPU or in a compute pass. A sampler with a conversion must be
+// immutable in the descriptor set layout, so the image is created before
+// the graphics pipeline.
+//
+// samplerYcbcrConversion is core in Vulkan 1.1 but optional.
+
+#include <vulkan/vulkan.h>
+#include <linux/videodev2.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "format_negotiation.h"
+
+// Feature struct to chain into VkDeviceCreateInfo::pNext. Must not be moved
+// once chained.
+struct YcbcrFeatures {
+    VkPhysicalDeviceSamplerYcbcrConversionFeatures ycbcr{};
+
+    // True if the device supports the feature; the struct is then ready to
+    // enable it
+    bool query(VkPhysicalDevice physicalDevice) {
+        ycbcr.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &ycbcr;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+        return ycbcr.samplerYcbcrConversion;
+    }
+};
+
+class YcbcrImage {
+public:
+    // Image format for a planar V4L2 pixel format; VK_FORMAT_UNDEFINED if none
+    static VkFormat formatFor(uint32_t fourcc) {
+        switch (fourcc) {
+        case V4L2_PIX_FMT_NV12:
+        case V4L2_PIX_FMT_NV12M: return VK_FORMAT_G8_B8R8_2PLANE_420_UNORM;
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_YUV420M: return VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM;
+        default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    // True if frames of `fourcc` can be uploaded and sampled with a
+    // conversion. The feature itself must be checked with YcbcrFeatures.
+    static bool supported(VkPhysicalDevice physicalDevice, uint32_t fourcc) {
+        VkFormat format = formatFor(fourcc);
+        if (format == VK_FORMAT_UNDEFINED) return false;
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+        const VkFormatFeatureFlags features = props.optimalTilingFeatures;
+        const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+        return (features & needed) == needed &&
+               (features & (VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT | VK_FORMAT_FEATURE_COSITED_CHROMA_SAMPLES_BIT));
+    }
+
+    // Creates the conversion, its sampler, the image and the view for frames
+    // of `frame`. Throws if the device cannot do it.
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, const negotiation::FrameFormat& frame) {
+        this->device = device;
+        this->frame = frame;
+        planes = negotiation::colorPlanes(frame);
+        format = formatFor(frame.fourcc);
+        width = frame.width;
+        height = frame.height;
+        if (planes.empty() || format == VK_FORMAT_UNDEFINED) {
+            throw std::runtime_error("No YCbCr image format for " + negotiation::fourccName(frame.fourcc));
+        }
+
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+        const VkFormatFeatureFlags features = props.optimalTilingFeatures;
+
+        VkSamplerYcbcrConversionCreateInfo conversionInfo{};
+        conversionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO;
+        conversionInfo.format = format;
+        conversionInfo.ycbcrModel = model(frame);
+        conversionInfo.ycbcrRange = fullRange(frame) ? VK_SAMPLER_YCBCR_RANGE_ITU_FULL : VK_SAMPLER_YCBCR_RANGE_ITU_NARROW;
+        conversionInfo.components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+                                     VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY};
+        // Cameras mostly site 4:2:0 chroma like MPEG-2: co-sited
+        // horizontally, between the lines vertically
+        const bool cosited = features & VK_FORMAT_FEATURE_COSITED_CHROMA_SAMPLES_BIT;
+        const bool midpoint = features & VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT;
+        conversionInfo.xChromaOffset = cosited ? VK_CHROMA_LOCATION_COSITED_EVEN : VK_CHROMA_LOCATION_MIDPOINT;
+        conversionInfo.yChromaOffset = midpoint ? VK_CHROMA_LOCATION_MIDPOINT : VK_CHROMA_LOCATION_COSITED_EVEN;
+        // Without a separate reconstruction filter the sampler filter must match
+        const VkFilter filter = (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_YCBCR_CONVERSION_LINEAR_FILTER_BIT)
+                                    ? VK_FILTER_LINEAR
+                                    : VK_FILTER_NEAREST;
+        conversionInfo.chromaFilter = filter;
+        if (vkCreateSamplerYcbcrConversion(device, &conversionInfo, nullptr, &conversion) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create YCbCr conversion");
+        }
+
+        VkSamplerYcbcrConversionInfo conversionLink{};
+        conversionLink.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO;
+        conversionLink.conversion = conversion;
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.pNext = &conversionLink;
+        samplerInfo.magFilter = filter;
+        samplerInfo.minFilter = filter;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        if (vkCreateSampler(device, &samplerInfo, nullptr, &ycbcrSampler) != VK_SUCCESS) {
+            destroy();
+            throw std::runtime_error("Failed to create YCbCr sampler");
+        }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {width, height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        // A conversion may take more than one descriptor per combined image sampler
+        VkSamplerYcbcrConversionImageFormatProperties ycbcrProps{};
+        ycbcrProps.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_IMAGE_FORMAT_PROPERTIES;
+        VkImageFormatProperties2 formatProps{};
+        formatProps.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2;
+        formatProps.pNext = &ycbcrProps;
+        VkPhysicalDeviceImageFormatInfo2 formatInfo{};
+        formatInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2;
+        formatInfo.format = format;
+        formatInfo.type = VK_IMAGE_TYPE_2D;
+        formatInfo.tiling = imageInfo.tiling;
+        formatInfo.usage = imageInfo.usage;
+        if (vkGetPhysicalDeviceImageFormatProperties2(physicalDevice, &formatInfo, &formatProps) != VK_SUCCESS ||
+            formatProps.imageFormatProperties.maxExtent.width < width ||
+            formatProps.imageFormatProperties.maxExtent.height < height) {
+            destroy();
+            throw std::runtime_error("YCbCr image of " + std::to_string(width) + "x" + std::to_string(height) +
+                                     " not supported");
+        }
+        descriptors = std::max<uint32_t>(1, ycbcrProps.combinedImageSamplerDescriptorCount);
+
+        if (vkCreateImage(device, &imageInfo, nullptr, &img) != VK_SUCCESS) {
+            destroy();
+            throw std::runtime_error("Failed to create YCbCr image");
+        }
+        VkMemoryRequirements memReqs;
+        vkGetImageMemoryRequirements(device, img, &memReqs);
+        VkPhysicalDeviceMemoryProperties memProps;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memReqs.size;
+        allocInfo.memoryTypeIndex = UINT32_MAX;
+        for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+            if ((memReqs.memoryTypeBits & (1 << i)) &&
+                (memProps.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+                allocInfo.memoryTypeIndex = i;
+                break;
+            }
+        }
+        if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+            vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            destroy();
+            throw std::runtime_error("Failed to allocate YCbCr image memory");
+        }
+        vkBindImageMemory(device, img, memory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.pNext = &conversionLink;
+        viewInfo.image = img;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+            destroy();
+            throw std::runtime_error("Failed to create YCbCr image view");
+        }
+    }
+
+    void destroy() {
+        if (imageView) vkDestroyImageView(device, imageView, nullptr);
+        if (img) vkDestroyImage(device, img, nullptr);
+        if (memory) vkFreeMemory(device, memory, nullptr);
+        if (ycbcrSampler) vkDestroySampler(device, ycbcrSampler, nullptr);
+        if (conversion) vkDestroySamplerYcbcrConversion(device, conversion, nullptr);
+        imageView = VK_NULL_HANDLE;
+        img = VK_NULL_HANDLE;
+        memory = VK_NULL_HANDLE;
+        ycbcrSampler = VK_NULL_HANDLE;
+        conversion = VK_NULL_HANDLE;
+    }
+
+    // For pImmutableSamplers; must outlive the descriptor set layout
+    const VkSampler* sampler() const { return &ycbcrSampler; }
+    VkImageView view() const { return imageView; }
+    // Combined image sampler descriptors one binding of this image takes
+    uint32_t descriptorCount() const { return descriptors; }
+
+    // Records the copy of a frame whose memory planes sit back to back at
+    // `offset` in `buffer` (see FrameFormat::packedOffset), with the layout
+    // transitions around it. The previous frame may still be sampling.
+    void recordUpload(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset) const {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = img;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                             0, nullptr, 1, &barrier);
+
+        static const VkImageAspectFlagBits aspects[] = {VK_IMAGE_ASPECT_PLANE_0_BIT, VK_IMAGE_ASPECT_PLANE_1_BIT,
+                                                        VK_IMAGE_ASPECT_PLANE_2_BIT};
+        VkBufferImageCopy regions[3]{};
+        for (size_t p = 0; p < planes.size(); p++) {
+            const negotiation::ColorPlane& plane = planes[p];
+            // The CbCr plane of NV12 has two-byte texels
+            const uint32_t texelBytes = planes.size() == 2 && p == 1 ? 2 : 1;
+            regions[p].bufferOffset = offset + frame.packedOffset(plane.memoryPlane) + plane.offset;
+            regions[p].bufferRowLength = plane.bytesperline / texelBytes;
+            regions[p].imageSubresource.aspectMask = aspects[p];
+            regions[p].imageSubresource.layerCount = 1;
+            regions[p].imageExtent = {plane.width, plane.height, 1};
+        }
+        vkCmdCopyBufferToImage(cmd, buffer, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(planes.size()), regions);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                             0, nullptr, 1, &barrier);
+    }
+
+private:
+    // Matrix from the V4L2 Y'CbCr encoding, falling back to the colorspace's default
+    static VkSamplerYcbcrModelConversion model(const negotiation::FrameFormat& frame) {
+        uint32_t enc = frame.ycbcrEnc;
+        if (enc == V4L2_YCBCR_ENC_DEFAULT) {
+            if (frame.colorspace == V4L2_COLORSPACE_REC709) enc = V4L2_YCBCR_ENC_709;
+            else if (frame.colorspace == V4L2_COLORSPACE_BT2020) enc = V4L2_YCBCR_ENC_BT2020;
+        }
+        switch (enc) {
+        case V4L2_YCBCR_ENC_709: return VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709;
+        case V4L2_YCBCR_ENC_BT2020: return VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_2020;
+        default: return VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_601;
+        }
+    }
+
+    // Y'CbCr is limited range unless the driver says otherwise (or it is JPEG)
+    static bool fullRange(const negotiation::FrameFormat& frame) {
+        if (frame.quantization == V4L2_QUANTIZATION_DEFAULT) return frame.colorspace == V4L2_COLORSPACE_JPEG;
+        return frame.quantization == V4L2_QUANTIZATION_FULL_RANGE;
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    negotiation::FrameFormat frame;
+    std::vector<negotiation::ColorPlane> planes;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t descriptors = 1;
+    VkSamplerYcbcrConversion conversion = VK_NULL_HANDLE;
+    VkSampler ycbcrSampler = VK_NULL_HANDLE;
+    VkImage img = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+};
+
+#endif // YCBCR_IMAGE_H